@@ -0,0 +1,476 @@
+/**
+ * @file basic_blinkdb.h
+ * @brief Header-only BlinkDB variant specialized at compile time for its key and value types
+ * @author Madhumita
+ * @date 2025-03-31
+ *
+ * BlinkDB stores std::string keys and values in node-based maps, which costs
+ * several heap allocations and pointer hops per key. Tables whose keys and
+ * values have a fixed size (16-byte IDs, counters, small structs) can do much
+ * better: BasicBlinkDB keeps them inline in an open-addressing slot array and
+ * picks the hash and compare functions for the key type at compile time.
+ *
+ * BasicBlinkDB is an in-memory LRU table only. Entries pushed out by the
+ * capacity limit are dropped rather than written to disk.
+ */
+
+#ifndef BASIC_BLINKDB_H
+#define BASIC_BLINKDB_H
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <mutex>
+#include <functional>
+#include <type_traits>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#define BASIC_BLINKDB_CAPACITY 10000
+#define BASIC_BLINKDB_LOAD_FACTOR 2
+
+/**
+ * @struct FixedBytes
+ * @brief A fixed-size byte string, stored inline
+ * @tparam N Number of bytes
+ *
+ * Shorter inputs are zero-padded and longer inputs are truncated.
+ */
+template <size_t N>
+struct FixedBytes {
+    /**
+     * @brief The bytes
+     */
+    unsigned char data[N] = {};
+
+    /**
+     * @brief Builds a value from a string
+     * @param s Source bytes
+     * @return The fixed-size copy
+     */
+    static FixedBytes from(std::string_view s) {
+        FixedBytes bytes;
+        std::memcpy(bytes.data, s.data(), std::min(N, s.size()));
+        return bytes;
+    }
+
+    /**
+     * @brief Views the bytes as a string
+     * @return View of all N bytes, including padding
+     */
+    std::string_view view() const {
+        return std::string_view(reinterpret_cast<const char*>(data), N);
+    }
+
+    /**
+     * @brief Compares two values byte by byte
+     * @param other The value to compare with
+     * @return true if all bytes are equal
+     */
+    bool operator==(const FixedBytes& other) const {
+        return std::memcmp(data, other.data, N) == 0;
+    }
+};
+
+/**
+ * @brief Finalizer that spreads every input bit over the whole hash
+ * @param x Value to mix
+ * @return Mixed value
+ */
+inline uint64_t blinkMix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb93fe53b8e53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/**
+ * @brief Hashes a key with the cheapest function its type allows
+ * @tparam T Key type
+ * @param key The key
+ * @return 64-bit hash
+ *
+ * Integers are mixed directly. Types whose bytes fully determine their value
+ * are hashed a word at a time; the loop bounds are constants, so for small
+ * keys it unrolls to a few multiplies. Everything else goes through
+ * std::hash.
+ */
+template <typename T>
+inline uint64_t blinkHash(const T& key) {
+    if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+        return blinkMix64(static_cast<uint64_t>(key));
+    } else if constexpr (std::has_unique_object_representations_v<T>) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&key);
+        constexpr size_t words = sizeof(T) / 8;
+        constexpr size_t tail = sizeof(T) % 8;
+        uint64_t h = sizeof(T) * 0x9e3779b97f4a7c15ULL;
+        for (size_t i = 0; i < words; i++) {
+            uint64_t word;
+            std::memcpy(&word, bytes + i * 8, 8);
+            h = blinkMix64(h ^ word);
+        }
+        if constexpr (tail != 0) {
+            uint64_t word = 0;
+            std::memcpy(&word, bytes + words * 8, tail);
+            h = blinkMix64(h ^ word);
+        }
+        return h;
+    } else {
+        return blinkMix64(std::hash<T>{}(key));
+    }
+}
+
+/**
+ * @brief Compares two keys with the cheapest function their type allows
+ * @tparam T Key type
+ * @param a First key
+ * @param b Second key
+ * @return true if the keys are equal
+ */
+template <typename T>
+inline bool blinkEqual(const T& a, const T& b) {
+    if constexpr (std::has_unique_object_representations_v<T>) {
+        return std::memcmp(&a, &b, sizeof(T)) == 0;
+    } else {
+        return a == b;
+    }
+}
+
+/**
+ * @struct BlinkNullMutex
+ * @brief Mutex that does nothing, for tables used from a single thread
+ */
+struct BlinkNullMutex {
+    void lock() {}
+    void unlock() {}
+};
+
+/**
+ * @struct BlinkDefaultPolicy
+ * @brief Default capacity, locking, hashing and comparison for BasicBlinkDB
+ * @tparam Key Key type
+ * @tparam Value Value type
+ *
+ * A custom policy can derive from this one and override any member.
+ */
+template <typename Key, typename Value>
+struct BlinkDefaultPolicy {
+    /**
+     * @brief Maximum number of entries kept before the least recently used is dropped
+     */
+    static constexpr size_t capacity = BASIC_BLINKDB_CAPACITY;
+
+    /**
+     * @brief Lock taken around every operation
+     */
+    using Mutex = std::mutex;
+
+    /**
+     * @brief Hashes a key
+     * @param key The key
+     * @return 64-bit hash
+     */
+    static uint64_t hash(const Key& key) { return blinkHash(key); }
+
+    /**
+     * @brief Compares two keys
+     * @param a First key
+     * @param b Second key
+     * @return true if the keys are equal
+     */
+    static bool equal(const Key& a, const Key& b) { return blinkEqual(a, b); }
+};
+
+/**
+ * @struct BlinkSingleThreadPolicy
+ * @brief Default policy without locking
+ * @tparam Key Key type
+ * @tparam Value Value type
+ */
+template <typename Key, typename Value>
+struct BlinkSingleThreadPolicy : BlinkDefaultPolicy<Key, Value> {
+    using Mutex = BlinkNullMutex;
+};
+
+/**
+ * @class BasicBlinkDB
+ * @brief An in-memory LRU key-value table specialized for its key and value types
+ * @tparam Key Key type, default constructible and copyable
+ * @tparam Value Value type, default constructible and copyable
+ * @tparam Policy Capacity, mutex, hash and compare, see BlinkDefaultPolicy
+ *
+ * Entries live inline in one open-addressing slot array with linear probing.
+ * A parallel array holds one tag byte per slot (7 hash bits plus an occupied
+ * bit), so a probe only compares keys whose tag matches. The LRU order is an
+ * intrusive doubly linked list of slot indices, so the table needs no
+ * allocation after construction.
+ */
+template <typename Key, typename Value, typename Policy = BlinkDefaultPolicy<Key, Value>>
+class BasicBlinkDB {
+private:
+    static_assert(Policy::capacity > 0 && Policy::capacity < UINT32_MAX / (2 * BASIC_BLINKDB_LOAD_FACTOR),
+                  "capacity must be positive and fit 32-bit slot indices");
+
+    /**
+     * @brief Slot index meaning "no slot"
+     */
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    /**
+     * @struct Slot
+     * @brief One table entry
+     */
+    struct Slot {
+        Key key{};
+        Value value{};
+        uint32_t prev = NIL;    // Towards the most recently used entry
+        uint32_t next = NIL;    // Towards the least recently used entry
+    };
+
+    /**
+     * @brief Tag byte per slot, 0 when the slot is empty
+     */
+    std::vector<uint8_t> tags;
+
+    /**
+     * @brief The slots
+     */
+    std::vector<Slot> slots;
+
+    /**
+     * @brief Number of slots minus one, the slot count being a power of two
+     */
+    size_t mask;
+
+    /**
+     * @brief Number of entries
+     */
+    size_t count = 0;
+
+    /**
+     * @brief Most recently used slot
+     */
+    uint32_t head = NIL;
+
+    /**
+     * @brief Least recently used slot
+     */
+    uint32_t tail = NIL;
+
+    /**
+     * @brief Number of entries dropped by the capacity limit
+     */
+    size_t evicted = 0;
+
+    /**
+     * @brief Lock taken around every operation
+     */
+    mutable typename Policy::Mutex mutex;
+
+    /**
+     * @brief Computes the tag byte of a hash
+     * @param h The hash
+     * @return Tag with the occupied bit set
+     *
+     * Uses the top bits, which are independent of the low bits that pick
+     * the home slot.
+     */
+    static uint8_t tagOf(uint64_t h) {
+        return static_cast<uint8_t>(0x80 | (h >> 57));
+    }
+
+    /**
+     * @brief Finds a key's slot
+     * @param key The key
+     * @param h Hash of the key
+     * @return Slot index, or NIL if the key is not present
+     */
+    uint32_t find(const Key& key, uint64_t h) const {
+        uint8_t tag = tagOf(h);
+        for (size_t i = h & mask; tags[i] != 0; i = (i + 1) & mask) {
+            if (tags[i] == tag && Policy::equal(slots[i].key, key)) {
+                return static_cast<uint32_t>(i);
+            }
+        }
+        return NIL;
+    }
+
+    /**
+     * @brief Removes a slot from the LRU list
+     * @param i Slot index
+     */
+    void unlink(uint32_t i) {
+        Slot& slot = slots[i];
+        if (slot.prev != NIL) slots[slot.prev].next = slot.next; else head = slot.next;
+        if (slot.next != NIL) slots[slot.next].prev = slot.prev; else tail = slot.prev;
+    }
+
+    /**
+     * @brief Inserts a slot at the most recently used end of the LRU list
+     * @param i Slot index
+     */
+    void linkFront(uint32_t i) {
+        slots[i].prev = NIL;
+        slots[i].next = head;
+        if (head != NIL) slots[head].prev = i; else tail = i;
+        head = i;
+    }
+
+    /**
+     * @brief Marks a slot as most recently used
+     * @param i Slot index
+     */
+    void touch(uint32_t i) {
+        if (head != i) {
+            unlink(i);
+            linkFront(i);
+        }
+    }
+
+    /**
+     * @brief Removes the entry in a slot
+     * @param i Slot index
+     *
+     * Uses backward-shift deletion: later entries of the same probe run are
+     * moved up so no tombstones are left behind, and their LRU neighbours
+     * are repointed at the new positions.
+     */
+    void erase(uint32_t i) {
+        unlink(i);
+        count--;
+
+        size_t hole = i;
+        for (size_t j = (hole + 1) & mask; tags[j] != 0; j = (j + 1) & mask) {
+            size_t home = Policy::hash(slots[j].key) & mask;
+            // Entry j may only move back if the hole lies between its home and j
+            if (((j - home) & mask) < ((j - hole) & mask)) {
+                continue;
+            }
+            slots[hole] = std::move(slots[j]);
+            tags[hole] = tags[j];
+            Slot& moved = slots[hole];
+            if (moved.prev != NIL) slots[moved.prev].next = hole; else head = hole;
+            if (moved.next != NIL) slots[moved.next].prev = hole; else tail = hole;
+            hole = j;
+        }
+        tags[hole] = 0;
+        slots[hole] = Slot();
+    }
+
+public:
+    /**
+     * @brief Constructor
+     *
+     * Allocates all slots up front, at BASIC_BLINKDB_LOAD_FACTOR slots per entry.
+     */
+    BasicBlinkDB() {
+        size_t size = 1;
+        while (size < Policy::capacity * BASIC_BLINKDB_LOAD_FACTOR) {
+            size <<= 1;
+        }
+        tags.assign(size, 0);
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    /**
+     * @brief Sets a key-value pair, dropping the least recently used entry if full
+     * @param key The key to set
+     * @param value The value to associate with the key
+     */
+    void set(const Key& key, const Value& value) {
+        std::lock_guard<typename Policy::Mutex> lock(mutex);
+        uint64_t h = Policy::hash(key);
+        uint32_t i = find(key, h);
+        if (i != NIL) {
+            slots[i].value = value;
+            touch(i);
+            return;
+        }
+
+        if (count == Policy::capacity) {
+            erase(tail);
+            evicted++;
+        }
+
+        size_t pos = h & mask;
+        while (tags[pos] != 0) {
+            pos = (pos + 1) & mask;
+        }
+        tags[pos] = tagOf(h);
+        slots[pos].key = key;
+        slots[pos].value = value;
+        linkFront(static_cast<uint32_t>(pos));
+        count++;
+    }
+
+    /**
+     * @brief Retrieves a value by key
+     * @param key The key to look up
+     * @return The value, or nothing if the key is not present
+     */
+    std::optional<Value> get(const Key& key) {
+        std::lock_guard<typename Policy::Mutex> lock(mutex);
+        uint32_t i = find(key, Policy::hash(key));
+        if (i == NIL) {
+            return std::nullopt;
+        }
+        touch(i);
+        return slots[i].value;
+    }
+
+    /**
+     * @brief Deletes a key-value pair
+     * @param key The key to delete
+     * @return true if the key was found and deleted, false otherwise
+     */
+    bool del(const Key& key) {
+        std::lock_guard<typename Policy::Mutex> lock(mutex);
+        uint32_t i = find(key, Policy::hash(key));
+        if (i == NIL) {
+            return false;
+        }
+        erase(i);
+        return true;
+    }
+
+    /**
+     * @brief Number of entries
+     * @return Entry count
+     */
+    size_t size() const {
+        std::lock_guard<typename Policy::Mutex> lock(mutex);
+        return count;
+    }
+
+    /**
+     * @brief Maximum number of entries
+     * @return The policy's capacity
+     */
+    static constexpr size_t capacity() {
+        return Policy::capacity;
+    }
+
+    /**
+     * @brief Number of entries dropped by the capacity limit
+     * @return Eviction count
+     */
+    size_t evictions() const {
+        std::lock_guard<typename Policy::Mutex> lock(mutex);
+        return evicted;
+    }
+
+    /**
+     * @brief Bytes allocated by the table
+     * @return Size of the slot and tag arrays, excluding memory owned by keys and values
+     */
+    size_t memoryUsage() const {
+        return sizeof(*this) + slots.capacity() * sizeof(Slot) + tags.capacity();
+    }
+};
+
+#endif // BASIC_BLINKDB_H
@@ -0,0 +1,23 @@
+/**
+ * @file bench_util.cpp
+ * @brief Implementation of helpers shared by the benchmark tools
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#include "bench_util.h"
+#include <algorithm>
+
+/**
+ * @brief Value at a percentile of a sample
+ * @param values The sample, sorted in place
+ * @param p Percentile between 0 and 1
+ * @return The value, 0 for an empty sample
+ */
+double benchPercentile(std::vector<double>& values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))];
+}
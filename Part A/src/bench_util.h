@@ -0,0 +1,21 @@
+/**
+ * @file bench_util.h
+ * @brief Header file for helpers shared by the benchmark tools
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <vector>
+
+/**
+ * @brief Value at a percentile of a sample
+ * @param values The sample, sorted in place
+ * @param p Percentile between 0 and 1
+ * @return The value, 0 for an empty sample
+ */
+double benchPercentile(std::vector<double>& values, double p);
+
+#endif // BENCH_UTIL_H
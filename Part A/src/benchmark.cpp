@@ -6,10 +6,35 @@
  */
 
 #include "blinkdb.h"
+#include "basic_blinkdb.h"
+#include "perf_counters.h"
 #include <chrono>
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <random>
+#include <memory>
+#include <algorithm>
+#include <malloc.h>
+
+/**
+ * @brief Hardware counters read around every timed phase
+ */
+static PerfCounters perf;
+
+/**
+ * @brief Prints a phase's counters per operation
+ * @param counters Counts over the phase
+ * @param ops Operations performed in the phase
+ */
+static void printPerOp(const PerfSample& counters, size_t ops) {
+    if (perf.available()) {
+        std::cout << "Per op: " << counters.perOp(static_cast<double>(ops)) << "\n";
+    }
+}
 
 /**
  * @brief Benchmarks read-heavy operations
@@ -26,6 +51,7 @@ void benchmarkReadHeavy(BlinkDB& db) {
         db.set(key, "value" + std::to_string(i));
     }
     
+    perf.start();
     auto start = std::chrono::high_resolution_clock::now();
     
     for (int i = 0; i < 1000000; ++i) {
@@ -34,7 +60,9 @@ void benchmarkReadHeavy(BlinkDB& db) {
     }
     
     auto end = std::chrono::high_resolution_clock::now();
+    PerfSample counters = perf.stop();
     std::cout << "Time taken: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms\n";
+    printPerOp(counters, 1000000);
 }
 
 /**
@@ -46,6 +74,7 @@ void benchmarkReadHeavy(BlinkDB& db) {
 void benchmarkWriteHeavy(BlinkDB& db) {
     std::cout << "Write Heavy Benchmark\n";
     
+    perf.start();
     auto start = std::chrono::high_resolution_clock::now();
     
     for (int i = 0; i < 1000000; ++i) {
@@ -54,7 +83,9 @@ void benchmarkWriteHeavy(BlinkDB& db) {
     }
     
     auto end = std::chrono::high_resolution_clock::now();
+    PerfSample counters = perf.stop();
     std::cout << "Time taken: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms\n";
+    printPerOp(counters, 1000000);
 }
 
 /**
@@ -72,6 +103,7 @@ void benchmarkMixed(BlinkDB& db) {
         db.set(key, "value" + std::to_string(i));
     }
     
+    perf.start();
     auto start = std::chrono::high_resolution_clock::now();
     
     for (int i = 0; i < 500000; ++i) {
@@ -85,17 +117,295 @@ void benchmarkMixed(BlinkDB& db) {
     }
     
     auto end = std::chrono::high_resolution_clock::now();
+    PerfSample counters = perf.stop();
     std::cout << "Time taken: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms\n";
+    printPerOp(counters, 1000000);
+}
+
+/**
+ * @brief Benchmarks concurrent misses on evicted keys
+ * @param db Reference to the BlinkDB instance
+ * 
+ * Persists 100 keys, pushes them out of memory with filler writes, and then
+ * has 16 threads GET each evicted key at the same moment. With single-flight
+ * loading every key should be read from disk once.
+ */
+void benchmarkThunderingHerd(BlinkDB& db) {
+    std::cout << "Thundering Herd Benchmark\n";
+    
+    const int num_keys = 100;
+    const int num_threads = 16;
+    
+    for (int i = 0; i < num_keys; ++i) {
+        db.set("herd" + std::to_string(i), "value" + std::to_string(i));
+    }
+    db.persistToFile();
+    
+    for (int i = 0; i < MAX_CAPACITY; ++i) {
+        db.set("filler" + std::to_string(i), "value" + std::to_string(i));
+    }
+    
+    size_t reads_before = db.diskReads();
+    perf.start();
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    for (int i = 0; i < num_keys; ++i) {
+        std::string key = "herd" + std::to_string(i);
+        std::atomic<bool> go{false};
+        std::vector<std::thread> threads;
+        
+        for (int t = 0; t < num_threads; ++t) {
+            threads.emplace_back([&db, &key, &go]() {
+                while (!go.load()) {
+                    std::this_thread::yield();
+                }
+                db.get(key);
+            });
+        }
+        go.store(true);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    PerfSample counters = perf.stop();
+    size_t reads = db.diskReads() - reads_before;
+    std::cout << "Time taken: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms\n";
+    printPerOp(counters, num_keys * num_threads);
+    std::cout << "Disk reads per key: " << static_cast<double>(reads) / num_keys
+              << " (" << num_threads << " concurrent GETs per key)\n";
+}
+
+/**
+ * @brief Heap bytes currently in use
+ * @return Allocated bytes according to malloc
+ */
+static size_t heapInUse() {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd; // Large blocks are mmapped and counted separately
+}
+
+/**
+ * @brief Benchmarks a table of fixed-size keys and values
+ * @param db Reference to the BlinkDB instance
+ * 
+ * Loads MAX_CAPACITY random 16-byte keys with 16-byte values into BlinkDB,
+ * into a BasicBlinkDB holding std::string, and into a BasicBlinkDB holding
+ * FixedBytes<16>, then times 1 million random lookups on each and reports
+ * heap bytes per key for the two BasicBlinkDB tables.
+ */
+void benchmarkFixedSize(BlinkDB& db) {
+    std::cout << "Fixed Size Benchmark\n";
+    
+    const int num_keys = MAX_CAPACITY;
+    const int num_lookups = 1000000;
+    
+    // Printable keys, so BlinkDB's tab-separated persistence file stays valid
+    std::mt19937_64 rng(42);
+    std::vector<std::string> keys(num_keys);
+    for (auto& key : keys) {
+        key.resize(16);
+        for (char& c : key) {
+            c = 'a' + rng() % 26;
+        }
+    }
+    std::vector<int> order(num_lookups);
+    for (int& i : order) {
+        i = rng() % num_keys;
+    }
+    
+    using StringTable = BasicBlinkDB<std::string, std::string>;
+    using FixedTable = BasicBlinkDB<FixedBytes<16>, FixedBytes<16>>;
+    
+    size_t heap_before = heapInUse();
+    auto string_table = std::make_unique<StringTable>();
+    for (const auto& key : keys) {
+        string_table->set(key, key);
+    }
+    size_t string_bytes = heapInUse() - heap_before;
+    
+    heap_before = heapInUse();
+    auto fixed_table = std::make_unique<FixedTable>();
+    for (const auto& key : keys) {
+        fixed_table->set(FixedBytes<16>::from(key), FixedBytes<16>::from(key));
+    }
+    size_t fixed_bytes = heapInUse() - heap_before;
+    
+    for (const auto& key : keys) {
+        db.set(key, key);
+    }
+    
+    size_t found = 0;
+    perf.start();
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i : order) {
+        found += db.get(keys[i]).size();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    PerfSample counters = perf.stop();
+    std::cout << "BlinkDB lookups: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms\n";
+    printPerOp(counters, num_lookups);
+    
+    perf.start();
+    start = std::chrono::high_resolution_clock::now();
+    for (int i : order) {
+        found += string_table->get(keys[i])->size();
+    }
+    end = std::chrono::high_resolution_clock::now();
+    counters = perf.stop();
+    std::cout << "BasicBlinkDB<string> lookups: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms\n";
+    printPerOp(counters, num_lookups);
+    
+    // Keys are converted outside the timed loop, as a caller with binary IDs would hold them
+    std::vector<FixedBytes<16>> fixed_keys(num_keys);
+    for (int i = 0; i < num_keys; ++i) {
+        fixed_keys[i] = FixedBytes<16>::from(keys[i]);
+    }
+    perf.start();
+    start = std::chrono::high_resolution_clock::now();
+    for (int i : order) {
+        found += fixed_table->get(fixed_keys[i])->data[0] != 0;
+    }
+    end = std::chrono::high_resolution_clock::now();
+    counters = perf.stop();
+    std::cout << "BasicBlinkDB<FixedBytes<16>> lookups: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms\n";
+    printPerOp(counters, num_lookups);
+    
+    std::cout << "Heap bytes per key: " << string_bytes / num_keys << " (string), "
+              << fixed_bytes / num_keys << " (fixed)\n";
+    if (found == 0) {
+        std::cout << "No keys found\n";
+    }
+}
+
+/**
+ * @brief Benchmarks batched against one-at-a-time key lookups
+ * 
+ * Fills a KeyTable with 10 million keys, far more than the CPU caches hold,
+ * then looks up 10 million random keys once with find() and once with
+ * findBatch() in batches of 64, as an MGET or a pipelined read would.
+ */
+void benchmarkBatchedLookup() {
+    std::cout << "Batched Lookup Benchmark\n";
+    
+    const size_t num_keys = 10000000;
+    const size_t num_lookups = 10000000;
+    const size_t batch_size = 64;
+    
+    KeyTable table;
+    table.reserve(num_keys);
+    std::vector<std::string> keys(num_keys);
+    for (size_t i = 0; i < num_keys; ++i) {
+        keys[i] = "key" + std::to_string(i);
+        table.insert(keys[i], "v");
+    }
+    
+    std::mt19937_64 rng(7);
+    std::vector<std::string_view> lookups(num_lookups);
+    for (auto& lookup : lookups) {
+        lookup = keys[rng() % num_keys];
+    }
+    std::vector<uint32_t> entries(num_lookups);
+    
+    perf.start();
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < num_lookups; ++i) {
+        entries[i] = table.find(lookups[i]);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    PerfSample counters = perf.stop();
+    auto single_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    std::cout << "One at a time: " << single_ms << " ms\n";
+    printPerOp(counters, num_lookups);
+    
+    perf.start();
+    start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < num_lookups; i += batch_size) {
+        table.findBatch(&lookups[i], std::min(batch_size, num_lookups - i), &entries[i]);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    counters = perf.stop();
+    auto batched_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    std::cout << "Batched: " << batched_ms << " ms ("
+              << static_cast<double>(single_ms) / std::max<long long>(batched_ms, 1) << "x)\n";
+    printPerOp(counters, num_lookups);
+    
+    for (size_t i = 0; i < num_lookups; ++i) {
+        if (entries[i] == KeyTable::NIL || table.key(entries[i]) != lookups[i]) {
+            std::cout << "Lookup mismatch\n";
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Benchmarks lookups on a table backed by regular and by huge pages
+ * 
+ * Builds a 10 million key KeyTable with huge pages off, times 10 million
+ * random lookups, and repeats with the table advised for transparent huge
+ * pages. With 4 KB pages most lookups also miss the TLB.
+ */
+void benchmarkHugePages() {
+    std::cout << "Huge Pages Benchmark\n";
+    
+    const size_t num_keys = 10000000;
+    const size_t num_lookups = 10000000;
+    
+    std::vector<std::string> keys(num_keys);
+    for (size_t i = 0; i < num_keys; ++i) {
+        keys[i] = "key" + std::to_string(i);
+    }
+    std::mt19937_64 rng(11);
+    std::vector<size_t> order(num_lookups);
+    for (auto& i : order) {
+        i = rng() % num_keys;
+    }
+    
+    for (HugePageMode mode : {HugePageMode::OFF, HugePageMode::ADVISE}) {
+        HugePages::setMode(mode);
+        KeyTable table;
+        table.reserve(num_keys);
+        for (const auto& key : keys) {
+            table.insert(key, "v");
+        }
+        
+        size_t found = 0;
+        perf.start();
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i : order) {
+            // Rebuilt rather than read from keys, whose own page misses would blur the comparison
+            std::string key = "key" + std::to_string(i);
+            found += table.find(key) != KeyTable::NIL;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        PerfSample counters = perf.stop();
+        
+        HugePageStats stats = HugePages::stats();
+        std::cout << "Mode " << HugePages::modeName(mode) << ": "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms, "
+                  << stats.thp_bytes / HUGE_PAGE_SIZE << " huge pages in use";
+        if (found != num_lookups) {
+            std::cout << " (lookup mismatch)";
+        }
+        std::cout << "\n";
+        printPerOp(counters, num_lookups);
+    }
+    HugePages::setMode(HugePageMode::OFF);
 }
 
 /**
  * @brief Main function for running benchmarks
  * @return Exit code
  * 
- * Creates a BlinkDB instance and runs all three benchmarks in sequence,
- * clearing the persistence file between each benchmark.
+ * Creates a BlinkDB instance and runs all benchmarks in sequence,
+ * clearing the persistence file between each benchmark. Every timed phase
+ * also reports hardware counters per operation where the CPU exposes them.
  */
 int main() {
+    if (!perf.unavailableReason().empty()) {
+        std::cout << "Performance counters: " << perf.unavailableReason() << "\n";
+    }
     BlinkDB db;
     db.clearPersistenceFile();
     benchmarkReadHeavy(db);
@@ -103,7 +413,13 @@ int main() {
     benchmarkWriteHeavy(db);
     db.clearPersistenceFile(); // Clear data for next benchmark
     benchmarkMixed(db);
+    db.clearPersistenceFile(); // Clear data for next benchmark
+    benchmarkThunderingHerd(db);
+    db.clearPersistenceFile(); // Clear data for next benchmark
+    benchmarkFixedSize(db);
     db.clearPersistenceFile();
+    benchmarkBatchedLookup();
+    benchmarkHugePages();
     return 0;
 }
 
@@ -0,0 +1,646 @@
+/**
+ * @file blink_import.cpp
+ * @brief Offline bulk loader that builds a BlinkDB snapshot from TSV, CSV or RESP dumps
+ * @author Madhumita
+ * @date 2025-03-31
+ *
+ * Compilation: g++ -std=c++17 -O2 blink_import.cpp -o blink_import -lpthread
+ * Execution: ./blink_import [-f tsv|csv|resp] [-t threads] [-o output] <input>...
+ *
+ * The input files are memory-mapped and split into one chunk per thread.
+ * Each thread parses its chunk into records that point into the mapping,
+ * the records are sorted by key and deduplicated (later records win, a DEL
+ * removes the key), and the result is written in the persistence file
+ * format that BlinkDB loads at startup. No BlinkDB instance is created, so
+ * there is no LRU bookkeeping or locking on the way.
+ */
+
+#include "blinkdb.h"
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @brief Size of the output buffer used when writing the snapshot
+ */
+#define IMPORT_WRITE_BUFFER (1 << 20)
+
+/**
+ * @brief Largest accepted -t value
+ */
+#define IMPORT_MAX_THREADS 1024
+
+/**
+ * @enum InputFormat
+ * @brief Supported input file formats
+ */
+enum class InputFormat {
+    TSV,
+    CSV,
+    RESP
+};
+
+/**
+ * @struct ImportRecord
+ * @brief One key update read from the input
+ */
+struct ImportRecord {
+    /**
+     * @brief Key, pointing into the input mapping or chunk storage
+     */
+    std::string_view key;
+
+    /**
+     * @brief Value, pointing into the input mapping or chunk storage
+     */
+    std::string_view value;
+
+    /**
+     * @brief Position in the input; of several records for a key the highest wins
+     */
+    uint64_t seq;
+
+    /**
+     * @brief Whether the record deletes the key
+     */
+    bool deleted;
+};
+
+/**
+ * @struct ChunkResult
+ * @brief Output of parsing one chunk of an input file
+ */
+struct ChunkResult {
+    /**
+     * @brief Records parsed from the chunk
+     */
+    std::vector<ImportRecord> records;
+
+    /**
+     * @brief Owned copies of fields that had to be unescaped
+     */
+    std::deque<std::string> storage;
+
+    /**
+     * @brief Number of lines or commands that were ignored
+     */
+    size_t skipped = 0;
+};
+
+/**
+ * @class MappedFile
+ * @brief Read-only memory mapping of an input file
+ */
+class MappedFile {
+private:
+    /**
+     * @brief Start of the mapping, or nullptr for an empty file
+     */
+    const char* data_ptr = nullptr;
+
+    /**
+     * @brief Size of the file in bytes
+     */
+    size_t length = 0;
+
+public:
+    /**
+     * @brief Maps a file into memory
+     * @param path Path of the file
+     */
+    explicit MappedFile(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            close(fd);
+            throw std::runtime_error("Cannot stat " + path);
+        }
+
+        length = st.st_size;
+        if (length > 0) {
+            void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Cannot map " + path);
+            }
+            madvise(mapping, length, MADV_SEQUENTIAL);
+            data_ptr = static_cast<const char*>(mapping);
+        }
+        close(fd);
+    }
+
+    /**
+     * @brief Destructor
+     *
+     * Unmaps the file.
+     */
+    ~MappedFile() {
+        if (data_ptr) {
+            munmap(const_cast<char*>(data_ptr), length);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Start of the file contents
+     * @return Pointer to the mapping
+     */
+    const char* data() const { return data_ptr; }
+
+    /**
+     * @brief Size of the file
+     * @return Size in bytes
+     */
+    size_t size() const { return length; }
+};
+
+/**
+ * @brief Checks that a record can be represented in the persistence file
+ * @param key The key
+ * @param value The value
+ * @return true if the record can be written
+ *
+ * The persistence file separates key and value with a tab and records with
+ * a newline, so keys may contain neither and values may not contain newlines.
+ */
+static bool storable(std::string_view key, std::string_view value) {
+    return !key.empty() &&
+           key.find_first_of("\t\n") == std::string_view::npos &&
+           value.find('\n') == std::string_view::npos;
+}
+
+/**
+ * @brief Splits a buffer into chunks that start at the beginning of a line
+ * @param data The buffer
+ * @param size Size of the buffer
+ * @param parts Desired number of chunks
+ * @return Chunk start offsets followed by the end offset
+ */
+static std::vector<size_t> splitAtLines(const char* data, size_t size, size_t parts) {
+    std::vector<size_t> bounds{0};
+    for (size_t i = 1; i < parts; i++) {
+        size_t pos = std::max(bounds.back(), size * i / parts);
+        const void* newline = (pos < size) ? memchr(data + pos, '\n', size - pos) : nullptr;
+        if (!newline) break;
+        bounds.push_back(static_cast<const char*>(newline) - data + 1);
+    }
+    bounds.push_back(size);
+    return bounds;
+}
+
+/**
+ * @brief Reads a RESP length header such as "*3\r\n" or "$5\r\n"
+ * @param data The buffer
+ * @param size Size of the buffer
+ * @param pos Offset of the header, advanced past its line
+ * @param type Expected type byte, '*' or '$'
+ * @param value Output length
+ * @return false if the header is malformed or its line isn't complete
+ *
+ * The mapped file need not end in a line break, so the digits are read
+ * only up to the end of the buffer, unlike with strtol. A length larger
+ * than the buffer can't be valid and is rejected as well.
+ */
+static bool readRespLength(const char* data, size_t size, size_t& pos, char type, size_t& value) {
+    if (pos >= size || data[pos] != type) return false;
+    const void* newline = memchr(data + pos, '\n', size - pos);
+    if (!newline) return false;
+    size_t end = static_cast<const char*>(newline) - data;
+    if (end > pos + 1 && data[end - 1] == '\r') end--;
+    if (end == pos + 1) return false;
+
+    value = 0;
+    for (size_t i = pos + 1; i < end; i++) {
+        if (data[i] < '0' || data[i] > '9') return false;
+        value = value * 10 + (data[i] - '0');
+        if (value > size) return false;
+    }
+    pos = static_cast<const char*>(newline) - data + 1;
+    return true;
+}
+
+/**
+ * @brief Skips over one RESP command without decoding it
+ * @param data The buffer
+ * @param size Size of the buffer
+ * @param pos Offset of the command, advanced past it
+ * @return false if the input is not a well-formed RESP array of bulk strings
+ */
+static bool skipRespCommand(const char* data, size_t size, size_t& pos) {
+    size_t count;
+    if (!readRespLength(data, size, pos, '*', count)) return false;
+
+    for (size_t i = 0; i < count; i++) {
+        size_t len;
+        if (!readRespLength(data, size, pos, '$', len)) return false;
+        pos += len + 2;
+        if (pos > size) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Splits a RESP command file into chunks that start at a command
+ * @param data The buffer
+ * @param size Size of the buffer
+ * @param parts Desired number of chunks
+ * @return Chunk start offsets followed by the end offset
+ *
+ * RESP values may contain anything, so boundaries are found by hopping
+ * from command to command using the length headers, without copying.
+ */
+static std::vector<size_t> splitAtCommands(const char* data, size_t size, size_t parts) {
+    std::vector<size_t> bounds{0};
+    size_t pos = 0;
+    size_t target = size / parts;
+    while (pos < size && bounds.size() < parts) {
+        if (!skipRespCommand(data, size, pos)) break;
+        if (pos >= target) {
+            bounds.push_back(pos);
+            target = size * bounds.size() / parts;
+        }
+    }
+    if (bounds.back() != size) {
+        bounds.push_back(size);
+    }
+    return bounds;
+}
+
+/**
+ * @brief Parses TSV lines of the form key<TAB>value
+ * @param data Start of the chunk
+ * @param size Size of the chunk
+ * @param seq_base Sequence number of the first byte of the chunk
+ * @param result Output for the parsed records
+ */
+static void parseTsv(const char* data, size_t size, uint64_t seq_base, ChunkResult& result) {
+    size_t pos = 0;
+    while (pos < size) {
+        const void* newline = memchr(data + pos, '\n', size - pos);
+        size_t end = newline ? static_cast<const char*>(newline) - data : size;
+        std::string_view line(data + pos, end - pos);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+        size_t tab = line.find('\t');
+        if (tab != std::string_view::npos && storable(line.substr(0, tab), line.substr(tab + 1))) {
+            result.records.push_back({line.substr(0, tab), line.substr(tab + 1), seq_base + pos, false});
+        } else if (!line.empty()) {
+            result.skipped++;
+        }
+        pos = end + 1;
+    }
+}
+
+/**
+ * @brief Reads one CSV field, unescaping it if it is quoted
+ * @param line The line being parsed
+ * @param pos Offset of the field, advanced past the following comma
+ * @param result Chunk result that owns unescaped copies
+ * @return The field contents
+ */
+static std::string_view readCsvField(std::string_view line, size_t& pos, ChunkResult& result) {
+    if (pos < line.size() && line[pos] == '"') {
+        std::string field;
+        size_t i = pos + 1;
+        while (i < line.size()) {
+            if (line[i] == '"') {
+                if (i + 1 < line.size() && line[i + 1] == '"') {
+                    field += '"';
+                    i += 2;
+                    continue;
+                }
+                i++;
+                break;
+            }
+            field += line[i++];
+        }
+        pos = (i < line.size() && line[i] == ',') ? i + 1 : line.size();
+        result.storage.push_back(std::move(field));
+        return result.storage.back();
+    }
+
+    size_t comma = line.find(',', pos);
+    size_t end = (comma == std::string_view::npos) ? line.size() : comma;
+    std::string_view field = line.substr(pos, end - pos);
+    pos = (comma == std::string_view::npos) ? line.size() : comma + 1;
+    return field;
+}
+
+/**
+ * @brief Parses CSV lines of the form key,value
+ * @param data Start of the chunk
+ * @param size Size of the chunk
+ * @param seq_base Sequence number of the first byte of the chunk
+ * @param result Output for the parsed records
+ *
+ * Quoted fields with doubled quotes are supported; fields spanning lines
+ * are not, since such values can't be stored anyway.
+ */
+static void parseCsv(const char* data, size_t size, uint64_t seq_base, ChunkResult& result) {
+    size_t pos = 0;
+    while (pos < size) {
+        const void* newline = memchr(data + pos, '\n', size - pos);
+        size_t end = newline ? static_cast<const char*>(newline) - data : size;
+        std::string_view line(data + pos, end - pos);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+        if (!line.empty()) {
+            size_t field_pos = 0;
+            std::string_view key = readCsvField(line, field_pos, result);
+            std::string_view value = readCsvField(line, field_pos, result);
+            if (storable(key, value)) {
+                result.records.push_back({key, value, seq_base + pos, false});
+            } else {
+                result.skipped++;
+            }
+        }
+        pos = end + 1;
+    }
+}
+
+/**
+ * @brief Parses RESP-encoded SET and DEL commands
+ * @param data Start of the chunk
+ * @param size Size of the chunk
+ * @param seq_base Sequence number of the first byte of the chunk
+ * @param result Output for the parsed records
+ *
+ * Other commands are counted as skipped. Parsing stops at the first
+ * malformed command.
+ */
+static void parseResp(const char* data, size_t size, uint64_t seq_base, ChunkResult& result) {
+    size_t pos = 0;
+    std::vector<std::string_view> args;
+
+    while (pos < size) {
+        size_t start = pos;
+        size_t count;
+        if (!readRespLength(data, size, pos, '*', count)) {
+            result.skipped++;
+            return;
+        }
+
+        args.clear();
+        for (size_t i = 0; i < count; i++) {
+            size_t len;
+            if (!readRespLength(data, size, pos, '$', len) || pos + len > size) {
+                result.skipped++;
+                return;
+            }
+            args.emplace_back(data + pos, len);
+            pos += len + 2;
+        }
+
+        if (args.empty()) {
+            result.skipped++;
+            continue;
+        }
+
+        std::string cmd(args[0]);
+        std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::toupper);
+        if (cmd == "SET" && args.size() == 3 && storable(args[1], args[2])) {
+            result.records.push_back({args[1], args[2], seq_base + start, false});
+        } else if (cmd == "DEL" && args.size() >= 2) {
+            for (size_t i = 1; i < args.size(); i++) {
+                result.records.push_back({args[i], std::string_view(), seq_base + start, true});
+            }
+        } else {
+            result.skipped++;
+        }
+    }
+}
+
+/**
+ * @brief Orders records by key, then by input position
+ * @param a First record
+ * @param b Second record
+ * @return true if a sorts before b
+ */
+static bool recordLess(const ImportRecord& a, const ImportRecord& b) {
+    int cmp = a.key.compare(b.key);
+    return cmp < 0 || (cmp == 0 && a.seq < b.seq);
+}
+
+/**
+ * @brief Sorts records using several threads
+ * @param records The records to sort
+ * @param num_threads Number of threads to use
+ *
+ * Each thread sorts one slice, then neighbouring slices are merged in
+ * parallel rounds until one sorted range remains.
+ */
+static void parallelSort(std::vector<ImportRecord>& records, size_t num_threads) {
+    std::vector<size_t> bounds;
+    for (size_t i = 0; i <= num_threads; i++) {
+        bounds.push_back(records.size() * i / num_threads);
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < num_threads; i++) {
+        threads.emplace_back([&records, &bounds, i]() {
+            std::sort(records.begin() + bounds[i], records.begin() + bounds[i + 1], recordLess);
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    while (bounds.size() > 2) {
+        std::vector<size_t> merged{0};
+        threads.clear();
+        for (size_t i = 0; i + 2 < bounds.size(); i += 2) {
+            size_t first = bounds[i], middle = bounds[i + 1], last = bounds[i + 2];
+            threads.emplace_back([&records, first, middle, last]() {
+                std::inplace_merge(records.begin() + first, records.begin() + middle,
+                                   records.begin() + last, recordLess);
+            });
+            merged.push_back(last);
+        }
+        if (merged.back() != bounds.back()) {
+            merged.push_back(bounds.back());
+        }
+        for (auto& thread : threads) thread.join();
+        bounds.swap(merged);
+    }
+}
+
+/**
+ * @brief Writes the newest version of every key to a snapshot file
+ * @param records Records sorted by key and input position
+ * @param output Path of the snapshot file
+ * @return Number of keys written
+ *
+ * The snapshot is written to a temporary file and renamed into place, so a
+ * failed import never leaves a truncated snapshot behind.
+ */
+static size_t writeSnapshot(const std::vector<ImportRecord>& records, const std::string& output) {
+    std::string temp = output + ".tmp";
+    FILE* out = fopen(temp.c_str(), "w");
+    if (!out) {
+        throw std::runtime_error("Cannot create " + temp);
+    }
+
+    std::string buffer;
+    buffer.reserve(IMPORT_WRITE_BUFFER + 4096);
+    size_t written = 0;
+
+    for (size_t i = 0; i < records.size(); i++) {
+        // Only the last record of each run of equal keys counts
+        if (i + 1 < records.size() && records[i + 1].key == records[i].key) {
+            continue;
+        }
+        if (records[i].deleted) {
+            continue;
+        }
+
+        buffer.append(records[i].key).append(1, '\t').append(records[i].value).append(1, '\n');
+        written++;
+        if (buffer.size() >= IMPORT_WRITE_BUFFER) {
+            fwrite(buffer.data(), 1, buffer.size(), out);
+            buffer.clear();
+        }
+    }
+    fwrite(buffer.data(), 1, buffer.size(), out);
+
+    bool failed = ferror(out) != 0;
+    failed |= fclose(out) != 0;
+    if (failed || std::rename(temp.c_str(), output.c_str()) != 0) {
+        std::remove(temp.c_str());
+        throw std::runtime_error("Cannot write " + output);
+    }
+    return written;
+}
+
+/**
+ * @brief Main function for the bulk loader
+ * @param argc Number of command-line arguments
+ * @param argv Array of command-line arguments
+ * @return Exit code (0 for success, 1 for failure)
+ */
+int main(int argc, char* argv[]) {
+    InputFormat format = InputFormat::TSV;
+    size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string output = FLUSH_FILE;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-f" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "tsv") format = InputFormat::TSV;
+            else if (name == "csv") format = InputFormat::CSV;
+            else if (name == "resp") format = InputFormat::RESP;
+            else {
+                std::cerr << "Unknown format: " << name << std::endl;
+                return 1;
+            }
+        } else if (arg == "-t" && i + 1 < argc) {
+            char* end;
+            long threads = strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || threads > IMPORT_MAX_THREADS) {
+                inputs.clear();
+                break;
+            }
+            num_threads = std::max(1L, threads);
+        } else if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (inputs.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [-f tsv|csv|resp] [-t threads] [-o output] <input>..." << std::endl;
+        return 1;
+    }
+
+    try {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        // Mappings must outlive the records that point into them
+        std::vector<std::unique_ptr<MappedFile>> files;
+        std::deque<ChunkResult> chunks; // Growing must not move records' unescaped storage
+
+        for (size_t f = 0; f < inputs.size(); f++) {
+            files.push_back(std::make_unique<MappedFile>(inputs[f]));
+            const MappedFile& file = *files.back();
+
+            std::vector<size_t> bounds = (format == InputFormat::RESP)
+                ? splitAtCommands(file.data(), file.size(), num_threads)
+                : splitAtLines(file.data(), file.size(), num_threads);
+
+            size_t first_chunk = chunks.size();
+            chunks.resize(first_chunk + bounds.size() - 1);
+
+            // Later files win over earlier ones, so the file index leads the sequence
+            uint64_t file_seq = static_cast<uint64_t>(f) << 48;
+
+            std::vector<std::thread> threads;
+            for (size_t c = 0; c + 1 < bounds.size(); c++) {
+                threads.emplace_back([&, c]() {
+                    const char* data = file.data() + bounds[c];
+                    size_t size = bounds[c + 1] - bounds[c];
+                    ChunkResult& result = chunks[first_chunk + c];
+                    if (format == InputFormat::TSV) parseTsv(data, size, file_seq + bounds[c], result);
+                    else if (format == InputFormat::CSV) parseCsv(data, size, file_seq + bounds[c], result);
+                    else parseResp(data, size, file_seq + bounds[c], result);
+                });
+            }
+            for (auto& thread : threads) thread.join();
+        }
+
+        size_t total = 0, skipped = 0;
+        for (const auto& chunk : chunks) {
+            total += chunk.records.size();
+            skipped += chunk.skipped;
+        }
+
+        std::vector<ImportRecord> records;
+        records.reserve(total);
+        for (auto& chunk : chunks) {
+            records.insert(records.end(), chunk.records.begin(), chunk.records.end());
+            std::vector<ImportRecord>().swap(chunk.records);
+        }
+        auto parsed = std::chrono::high_resolution_clock::now();
+
+        parallelSort(records, num_threads);
+        auto sorted = std::chrono::high_resolution_clock::now();
+
+        size_t written = writeSnapshot(records, output);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        auto ms = [](auto a, auto b) {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(b - a).count();
+        };
+        double seconds = std::max<double>(ms(start, end), 1) / 1000.0;
+
+        std::cout << "Records read: " << total << " (" << skipped << " skipped)\n";
+        std::cout << "Keys written: " << written << " to " << output << "\n";
+        std::cout << "Parse: " << ms(start, parsed) << " ms, sort: " << ms(parsed, sorted)
+                  << " ms, write: " << ms(sorted, end) << " ms\n";
+        std::cout << "Throughput: " << static_cast<size_t>(total / seconds) << " records/sec\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -6,6 +6,9 @@
  */
 
 #include "blinkdb.h"
+#include "trace.h"
+#include <random>
+#include <cstdio>
 
 /**
  * @brief Removes the persistence file from disk
@@ -16,24 +19,33 @@ void BlinkDB::clearPersistenceFile() {
 
 /**
  * @brief Constructor implementation
+ * @param capacity Maximum number of keys kept in memory
+ * @param file Path to the persistence file
  * 
  * Loads existing data from disk and starts the background flush thread
  */
-BlinkDB::BlinkDB() {
+BlinkDB::BlinkDB(size_t capacity, const std::string& file) : max_cache_size(capacity), persistence_file(file) {
     //clearPersistenceFile(); // Commenting to keep all the data stored even when the server is closed.
     loadFromFile();
     
     // Start periodic flushing thread
-    std::thread flush_thread(&BlinkDB::flushToDiskPeriodically, this);
-    flush_thread.detach();
+    flush_thread = std::thread(&BlinkDB::flushToDiskPeriodically, this);
 }
 
 /**
  * @brief Destructor implementation
  * 
- * Ensures any unsaved changes are written to disk
+ * Stops the flush thread, which would otherwise outlive the object, and
+ * ensures any unsaved changes are written to disk
  */
 BlinkDB::~BlinkDB() {
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex);
+        stopping = true;
+    }
+    flush_cv.notify_one();
+    flush_thread.join();
+    
     if (dirty) {
         persistToFile();
     }
@@ -45,65 +57,312 @@ BlinkDB::~BlinkDB() {
  * @param value The value to associate with the key
  */
 void BlinkDB::set(const std::string& key, const std::string& value) {
+    TraceSpan span("db set");
+    TraceSpan wait("lock wait");
     std::unique_lock lock(db_mutex);
-    
-    // Update LRU
-    updateLRU(key);
-    
-    // Store value
-    store[key] = value;
+    wait.end();
+    setLocked(key, value);
+}
+
+/**
+ * @brief Sets a key-value pair, with the database lock already held
+ * @param key The key to set
+ * @param value The value to associate with the key
+ */
+void BlinkDB::setLocked(const std::string& key, const std::string& value) {
+    uint32_t entry = table.find(key);
+    if (entry != KeyTable::NIL) {
+        table.value(entry) = value;
+        table.touch(entry);
+    } else {
+        table.insert(key, value);
+        evictIfNeeded();
+    }
     dirty = true;
+    notifyKeyEvent(KeyEvent::SET, key, value);
+}
+
+/**
+ * @brief Sets several key-value pairs under a single lock acquisition
+ * @param pairs The key-value pairs, applied in order
+ */
+void BlinkDB::mset(const std::vector<std::pair<std::string, std::string>>& pairs) {
+    std::unique_lock lock(db_mutex);
+    for (const auto& [key, value] : pairs) {
+        setLocked(key, value);
+    }
+}
+
+/**
+ * @brief Retrieves several values
+ * @param keys The keys to look up
+ * @return The values in key order, "NULL" for keys that are not found
+ * 
+ * Resident keys are served under a single lock acquisition, through the
+ * table's batched lookup so their cache misses overlap. Evicted keys are
+ * restored afterwards through get(), which coalesces the disk loads.
+ */
+std::vector<std::string> BlinkDB::mget(const std::vector<std::string>& keys) {
+    std::vector<std::string> values;
+    for (size_t i : mgetResident(keys, values)) {
+        values[i] = get(keys[i]);
+    }
+    return values;
+}
+
+/**
+ * @brief Retrieves the resident ones of several values
+ * @param keys The keys to look up
+ * @param values Output, resized to the key count: values in key order, "NULL" for keys that are not found
+ * @return Indices of the evicted keys, whose values are left empty
+ */
+std::vector<size_t> BlinkDB::mgetResident(const std::vector<std::string>& keys, std::vector<std::string>& values) {
+    TraceSpan span("db mget");
+    values.assign(keys.size(), std::string());
+    std::vector<size_t> evicted;
+    std::vector<std::string_view> views(keys.begin(), keys.end());
+    std::vector<uint32_t> entries(keys.size());
+    
+    TraceSpan wait("lock wait");
+    std::unique_lock lock(db_mutex);
+    wait.end();
+    table.findBatch(views.data(), views.size(), entries.data());
+    for (size_t i = 0; i < keys.size(); i++) {
+        uint32_t entry = entries[i];
+        if (entry != KeyTable::NIL) {
+            table.touch(entry);
+            values[i] = table.value(entry);
+        } else if (evicted_keys.find(keys[i]) != evicted_keys.end()) {
+            evicted.push_back(i);
+        } else {
+            values[i] = "NULL";
+        }
+    }
+    return evicted;
+}
+
+/**
+ * @brief Deletes several keys under a single lock acquisition
+ * @param keys The keys to delete
+ * @return Per key, whether it was found and deleted
+ */
+std::vector<bool> BlinkDB::mdel(const std::vector<std::string>& keys) {
+    std::unique_lock lock(db_mutex);
+    std::vector<bool> deleted(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        deleted[i] = delLocked(keys[i]);
+    }
+    return deleted;
 }
 
 /**
  * @brief Retrieves a value by key
  * @param key The key to look up
  * @return The value associated with the key, or "NULL" if not found
+ * 
+ * A miss on an evicted key restores it from disk. The first miss runs the
+ * load without holding the database lock; concurrent misses on the same
+ * key wait for that load and share its result.
  */
 std::string BlinkDB::get(const std::string& key) {
-    std::shared_lock read_lock(db_mutex);
+    std::string resident;
+    if (getIfResident(key, resident)) {
+        return resident;
+    }
     
-    auto it = store.find(key);
-    if (it == store.end()) {
-        // Check if key is evicted
-        if (evicted_keys.find(key) != evicted_keys.end()) {
-            // Restore from disk
-            restoreFromDisk(key);
-            it = store.find(key);
+    TraceSpan upgrade_wait("lock wait");
+    std::unique_lock write_lock(db_mutex);
+    upgrade_wait.end();
+    uint32_t entry = table.find(key);
+    if (entry == KeyTable::NIL) {
+        if (evicted_keys.find(key) == evicted_keys.end()) {
+            return "NULL"; // Deleted since the lookup
+        }
+        std::shared_future<std::optional<std::string>> load;
+        auto flight = inflight_loads.find(key);
+        
+        if (flight != inflight_loads.end()) {
+            // Someone is already loading this key, wait for their result
+            load = flight->second;
+            write_lock.unlock();
+            TraceSpan load_wait("restore wait");
+            std::optional<std::string> value = load.get();
+            return value ? *value : "NULL";
+        }
+        
+        std::promise<std::optional<std::string>> promise;
+        load = promise.get_future().share();
+        inflight_loads[key] = load;
+        write_lock.unlock();
+        
+        // Restore from disk
+        std::optional<std::string> value;
+        TraceSpan restore("disk restore");
+        try {
+            value = restoreFromDisk(key);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
         }
+        restore.end();
         
-        if (it == store.end()) {
+        TraceSpan relock_wait("lock wait");
+        write_lock.lock();
+        relock_wait.end();
+        inflight_loads.erase(key);
+        
+        // Don't overwrite a value written while the load was running
+        if (value && table.find(key) == KeyTable::NIL && evicted_keys.find(key) != evicted_keys.end()) {
+            table.insert(key, *value);
+            evicted_keys.erase(key); // Remove from evicted keys
+            evictIfNeeded();
+        }
+        promise.set_value(value);
+        
+        entry = table.find(key);
+        if (entry == KeyTable::NIL) {
             return "NULL";
         }
     }
     
+    table.touch(entry);
+    return table.value(entry);
+}
+
+/**
+ * @brief Retrieves a value unless that means restoring it from disk
+ * @param key The key to look up
+ * @param value Output: the value, or "NULL" if not found
+ * @return false if the key is evicted, leaving value untouched
+ * 
+ * Lets a caller that must not block on the disk find out from the same
+ * lookup that serves resident keys.
+ */
+bool BlinkDB::getIfResident(const std::string& key, std::string& value) {
+    TraceSpan span("db get");
+    TraceSpan wait("lock wait");
+    std::shared_lock read_lock(db_mutex);
+    wait.end();
+    
+    uint32_t entry = table.find(key);
+    if (entry == KeyTable::NIL) {
+        if (evicted_keys.find(key) != evicted_keys.end()) {
+            return false;
+        }
+        value = "NULL";
+        return true;
+    }
+    
     // Convert to unique lock to update LRU
     read_lock.unlock();
+    TraceSpan upgrade_wait("lock wait");
     std::unique_lock write_lock(db_mutex);
+    upgrade_wait.end();
+    
+    // The key may have been deleted or evicted while the lock was released
+    entry = table.find(key);
+    if (entry == KeyTable::NIL) {
+        if (evicted_keys.find(key) != evicted_keys.end()) {
+            return false;
+        }
+        value = "NULL";
+        return true;
+    }
     
     // Update LRU cache
-    updateLRU(key);
-    return it->second;
+    table.touch(entry);
+    value = table.value(entry);
+    return true;
 }
 
 /**
- * @brief Restores an evicted key from disk
+ * @brief Reads the value of an evicted key from disk
  * @param key The key to restore
+ * @return The value, or nothing if the key is not in the persistence file
+ * 
+ * Only reads the persistence file; installing the value in memory is left
+ * to the caller, so this runs without the database lock.
  */
-void BlinkDB::restoreFromDisk(const std::string& key) {
+std::optional<std::string> BlinkDB::restoreFromDisk(const std::string& key) {
+    disk_reads++;
+    
     std::ifstream in(persistence_file);
     if (in) {
         std::string line_key, value;
         while (std::getline(in, line_key, '\t') && std::getline(in, value)) {
             if (line_key == key) {
-                store[key] = value;
-                lru_keys.push_front(key);
-                lru_map[key] = lru_keys.begin();
-                evicted_keys.erase(key); // Remove from evicted keys
-                break;
+                return value;
             }
         }
     }
+    return std::nullopt;
+}
+
+/**
+ * @brief Number of times an evicted key was read back from disk
+ * @return Count of persistence file scans
+ */
+size_t BlinkDB::diskReads() const {
+    return disk_reads.load();
+}
+
+/**
+ * @brief Bytes attributable to a resident key
+ * @param key The key
+ * @return Its entry, index share and heap allocations, or nothing if the key is not resident
+ */
+std::optional<size_t> BlinkDB::memoryUsage(const std::string& key) const {
+    std::shared_lock lock(db_mutex);
+    uint32_t entry = table.find(key);
+    if (entry == KeyTable::NIL) {
+        return std::nullopt;
+    }
+    return table.entryMemory(entry);
+}
+
+/**
+ * @brief Memory used by the database, split by structure
+ * @return Current breakdown
+ * 
+ * Walks every resident and evicted key, so it costs time linear in the
+ * keyspace. The evicted key set is estimated from libstdc++'s node layout:
+ * a next pointer, the key-value pair and the cached hash per node.
+ */
+MemoryStats BlinkDB::memoryStats() const {
+    std::shared_lock lock(db_mutex);
+    MemoryStats stats;
+    stats.keys = table.size();
+    stats.table = table.memory();
+    stats.evicted_keys = evicted_keys.size();
+    stats.inflight_loads = inflight_loads.size();
+    
+    const size_t node_bytes = sizeof(void*) + sizeof(std::pair<const std::string, bool>) + sizeof(size_t);
+    stats.evicted_bytes = evicted_keys.bucket_count() * sizeof(void*) + evicted_keys.size() * node_bytes;
+    for (const auto& [key, flag] : evicted_keys) {
+        (void)flag;
+        if (key.capacity() > std::string().capacity()) {
+            stats.evicted_bytes += key.capacity() + 1;
+        }
+    }
+    return stats;
+}
+
+/**
+ * @brief Samples resident keys with their memory use
+ * @param samples Number of keys to sample, with replacement
+ * @param out Output vector the key and byte count pairs are appended to
+ * @return Number of resident keys the sample was drawn from
+ */
+size_t BlinkDB::sampleMemory(size_t samples, std::vector<std::pair<std::string, size_t>>& out) const {
+    static thread_local std::mt19937_64 rng(std::random_device{}());
+    std::shared_lock lock(db_mutex);
+    for (size_t i = 0; i < samples; i++) {
+        uint32_t entry = table.randomEntry(rng());
+        if (entry == KeyTable::NIL) {
+            break;
+        }
+        out.emplace_back(std::string(table.key(entry)), table.entryMemory(entry));
+    }
+    return table.size();
 }
 
 /**
@@ -112,55 +371,82 @@ void BlinkDB::restoreFromDisk(const std::string& key) {
  * @return true if the key was found and deleted, false otherwise
  */
 bool BlinkDB::del(const std::string& key) {
+    TraceSpan span("db del");
+    TraceSpan wait("lock wait");
     std::unique_lock lock(db_mutex);
-    
-    auto it = store.find(key);
-    if (it == store.end()) {
+    wait.end();
+    return delLocked(key);
+}
+
+/**
+ * @brief Deletes a key, with the database lock already held
+ * @param key The key to delete
+ * @return true if the key was found and deleted, false otherwise
+ */
+bool BlinkDB::delLocked(const std::string& key) {
+    uint32_t entry = table.find(key);
+    if (entry == KeyTable::NIL) {
         return false;
     }
     
-    // Remove from LRU cache
-    if (lru_map.find(key) != lru_map.end()) {
-        lru_keys.erase(lru_map[key]);
-        lru_map.erase(key);
-    }
-    
-    // Remove from store
-    store.erase(it);
+    table.erase(entry);
     dirty = true;
+    notifyKeyEvent(KeyEvent::DEL, key);
     return true;
 }
 
 /**
- * @brief Updates the LRU status of a key
- * @param key The key to update in the LRU cache
+ * @brief Registers the listener notified of keyspace changes
+ * @param listener Callback to invoke, or an empty function to remove it
+ */
+void BlinkDB::setKeyEventListener(KeyEventListener listener) {
+    std::unique_lock lock(db_mutex);
+    key_event_listener = std::move(listener);
+}
+
+/**
+ * @brief Notifies the key event listener, if one is set
+ * @param event The kind of change
+ * @param key The affected key
+ * @param value The new value for SET events
+ */
+void BlinkDB::notifyKeyEvent(KeyEvent event, const std::string& key, const std::string& value) {
+    if (key_event_listener) {
+        key_event_listener(event, key, value);
+    }
+}
+
+/**
+ * @brief Incrementally iterates over the keys held in memory
+ * @param cursor Position returned by the previous call, 0 to start
+ * @param count Approximate number of keys to return
+ * @param keys Output vector the keys are appended to
+ * @return Cursor for the next call, 0 once the iteration is complete
  * 
- * Moves the key to the front of the LRU list and handles eviction if needed
+ * The cursor is a bucket index of the underlying hash table, so each call
+ * only touches a bounded slice of the table.
+ */
+size_t BlinkDB::scan(size_t cursor, size_t count, std::vector<std::string>& keys) const {
+    std::shared_lock lock(db_mutex);
+    return table.scan(cursor, count, keys);
+}
+
+/**
+ * @brief Evicts least recently used keys until the cache is within its capacity
  */
-void BlinkDB::updateLRU(const std::string& key) {
-    // If key exists in LRU, remove it
-    if (lru_map.find(key) != lru_map.end()) {
-        lru_keys.erase(lru_map[key]);
-        lru_map.erase(key);
+void BlinkDB::evictIfNeeded() {
+    if (table.size() <= max_cache_size) {
+        return;
     }
-    
-    // Add key to front of LRU list
-    lru_keys.push_front(key);
-    lru_map[key] = lru_keys.begin();
-    
-    // Evict if needed
-    if (lru_keys.size() > max_cache_size) {
-        std::string evict_key = lru_keys.back();
+    TraceSpan span("evict");
+    while (table.size() > max_cache_size) {
+        uint32_t entry = table.leastRecent();
+        std::string evict_key(table.key(entry));
         
-        // Before evicting, save the key to a map if it exists in store
-        if (store.find(evict_key) != store.end()) {
-            evicted_keys[evict_key] = true; // Mark as evicted
-        }
-        
-        store.erase(evict_key);
-        lru_map.erase(evict_key);
-        lru_keys.pop_back();
+        evicted_keys[evict_key] = true; // Mark as evicted
+        table.erase(entry);
         dirty = true;
+        notifyKeyEvent(KeyEvent::EVICT, evict_key);
     }
 }
 
@@ -168,13 +454,34 @@ void BlinkDB::updateLRU(const std::string& key) {
  * @brief Writes all in-memory data to disk
  */
 void BlinkDB::persistToFile() {
-    std::ofstream out(persistence_file);
-    if (out) {
-        for (const auto& [key, value] : store) {
-            out << key << "\t" << value << "\n";
-        }
+    TraceSpan span("persist", true);
+    std::lock_guard<std::mutex> persist_lock(persist_mutex);
+    std::vector<std::pair<std::string, std::string>> snapshot;
+    {
+        TraceSpan wait("lock wait", true);
+        std::shared_lock lock(db_mutex);
+        wait.end();
+        TraceSpan copy("snapshot copy", true);
+        snapshot.reserve(table.size());
+        table.forEach([&snapshot](std::string_view key, const std::string& value) {
+            snapshot.emplace_back(key, value);
+        });
+        // Writes from here on mark the data dirty again for the next flush
+        dirty = false;
+    }
+
+    // Written beside the file and renamed over it, so restoreFromDisk never
+    // reads a half-written snapshot
+    std::string temp = persistence_file + ".tmp";
+    std::ofstream out(temp);
+    for (const auto& [key, value] : snapshot) {
+        out << key << "\t" << value << "\n";
+    }
+    out.close();
+    if (!out || std::rename(temp.c_str(), persistence_file.c_str()) != 0) {
+        std::remove(temp.c_str());
+        std::cerr << "Error: cannot write " << persistence_file << std::endl;
     }
-    dirty = false;
 }
 
 /**
@@ -185,9 +492,13 @@ void BlinkDB::loadFromFile() {
     if (in) {
         std::string key, value;
         while (std::getline(in, key, '\t') && std::getline(in, value)) {
-            store[key] = value;
-            lru_keys.push_front(key);
-            lru_map[key] = lru_keys.begin();
+            uint32_t entry = table.find(key);
+            if (entry != KeyTable::NIL) {
+                table.value(entry) = value;
+                table.touch(entry);
+            } else {
+                table.insert(key, value);
+            }
         }
     } else {
         // File does not exist or is empty, do nothing
@@ -198,11 +509,15 @@ void BlinkDB::loadFromFile() {
  * @brief Background thread function that periodically flushes data to disk
  */
 void BlinkDB::flushToDiskPeriodically() {
-    while (true) {
-        std::this_thread::sleep_for(std::chrono::seconds(10)); // Flush every 10 seconds
+    Tracer::setThreadName("flush");
+    std::unique_lock<std::mutex> lock(flush_mutex);
+    // Flush every 10 seconds until the destructor sets stopping
+    while (!flush_cv.wait_for(lock, std::chrono::seconds(10), [this] { return stopping; })) {
+        lock.unlock();
         if (dirty) {
             persistToFile();
         }
+        lock.lock();
     }
 }
 
@@ -0,0 +1,190 @@
+/**
+ * @file huge_pages.cpp
+ * @brief Implementation of huge-page-backed allocation
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#include "huge_pages.h"
+#include <new>
+#include <fstream>
+#include <cstdint>
+#include <sys/mman.h>
+
+std::atomic<HugePageMode> HugePages::current_mode{HugePageMode::OFF};
+std::atomic<size_t> HugePages::mapped_bytes{0};
+std::atomic<size_t> HugePages::explicit_pages{0};
+std::atomic<size_t> HugePages::advised_pages{0};
+std::atomic<size_t> HugePages::explicit_fallbacks{0};
+std::mutex HugePages::mappings_mutex;
+std::unordered_map<void*, HugePageMode> HugePages::mappings;
+
+/**
+ * @brief Selects how future large allocations are backed
+ * @param mode The mode
+ */
+void HugePages::setMode(HugePageMode mode) {
+    current_mode.store(mode);
+}
+
+/**
+ * @brief Current mode
+ * @return The mode
+ */
+HugePageMode HugePages::mode() {
+    return current_mode.load();
+}
+
+/**
+ * @brief Parses a mode name
+ * @param name "off", "advise" or "explicit"
+ * @param mode Set to the parsed mode
+ * @return true if the name is valid
+ */
+bool HugePages::parseMode(const std::string& name, HugePageMode& mode) {
+    if (name == "off") {
+        mode = HugePageMode::OFF;
+    } else if (name == "advise") {
+        mode = HugePageMode::ADVISE;
+    } else if (name == "explicit") {
+        mode = HugePageMode::EXPLICIT;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Name of a mode
+ * @param mode The mode
+ * @return "off", "advise" or "explicit"
+ */
+const char* HugePages::modeName(HugePageMode mode) {
+    switch (mode) {
+        case HugePageMode::ADVISE: return "advise";
+        case HugePageMode::EXPLICIT: return "explicit";
+        default: return "off";
+    }
+}
+
+/**
+ * @brief Maps a 2 MB aligned region of regular pages
+ * @param bytes Size, a multiple of HUGE_PAGE_SIZE
+ * @return Start of the region
+ * 
+ * Transparent huge pages can only back 2 MB aligned ranges, so one extra
+ * huge page is mapped and the unaligned head and tail are unmapped again.
+ */
+void* HugePages::mapAligned(size_t bytes) {
+    size_t padded = bytes + HUGE_PAGE_SIZE;
+    void* raw = mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+
+    uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) & ~static_cast<uintptr_t>(HUGE_PAGE_SIZE - 1);
+    if (aligned > start) {
+        munmap(raw, aligned - start);
+    }
+    size_t tail = (start + padded) - (aligned + bytes);
+    if (tail > 0) {
+        munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+    }
+    return reinterpret_cast<void*>(aligned);
+}
+
+/**
+ * @brief Allocates memory
+ * @param bytes Number of bytes
+ * @return The memory
+ */
+void* HugePages::allocate(size_t bytes) {
+    if (bytes < HUGE_PAGE_SIZE) {
+        return ::operator new(bytes);
+    }
+
+    size_t rounded = (bytes + HUGE_PAGE_SIZE - 1) & ~static_cast<size_t>(HUGE_PAGE_SIZE - 1);
+    HugePageMode mode = current_mode.load();
+    void* ptr = nullptr;
+
+    if (mode == HugePageMode::EXPLICIT) {
+        ptr = mmap(nullptr, rounded, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED) {
+            explicit_pages += rounded / HUGE_PAGE_SIZE;
+            mapped_bytes += rounded;
+            std::lock_guard<std::mutex> lock(mappings_mutex);
+            mappings[ptr] = HugePageMode::EXPLICIT;
+            return ptr;
+        }
+        // No reserved pages left, transparent huge pages are the next best thing
+        explicit_fallbacks++;
+        mode = HugePageMode::ADVISE;
+    }
+
+    ptr = mapAligned(rounded);
+    if (mode == HugePageMode::ADVISE && madvise(ptr, rounded, MADV_HUGEPAGE) == 0) {
+        advised_pages += rounded / HUGE_PAGE_SIZE;
+    } else {
+        mode = HugePageMode::OFF;
+    }
+    mapped_bytes += rounded;
+    std::lock_guard<std::mutex> lock(mappings_mutex);
+    mappings[ptr] = mode;
+    return ptr;
+}
+
+/**
+ * @brief Frees memory returned by allocate()
+ * @param ptr The memory
+ * @param bytes Number of bytes passed to allocate()
+ */
+void HugePages::deallocate(void* ptr, size_t bytes) {
+    if (bytes < HUGE_PAGE_SIZE) {
+        ::operator delete(ptr);
+        return;
+    }
+    size_t rounded = (bytes + HUGE_PAGE_SIZE - 1) & ~static_cast<size_t>(HUGE_PAGE_SIZE - 1);
+    HugePageMode mode = HugePageMode::OFF;
+    {
+        std::lock_guard<std::mutex> lock(mappings_mutex);
+        auto it = mappings.find(ptr);
+        if (it != mappings.end()) {
+            mode = it->second;
+            mappings.erase(it);
+        }
+    }
+    if (mode == HugePageMode::EXPLICIT) {
+        explicit_pages -= rounded / HUGE_PAGE_SIZE;
+    } else if (mode == HugePageMode::ADVISE) {
+        advised_pages -= rounded / HUGE_PAGE_SIZE;
+    }
+    munmap(ptr, rounded);
+    mapped_bytes -= rounded;
+}
+
+/**
+ * @brief Reads the allocation counters
+ * @return Current statistics
+ */
+HugePageStats HugePages::stats() {
+    HugePageStats stats;
+    stats.mode = current_mode.load();
+    stats.mapped_bytes = mapped_bytes.load();
+    stats.explicit_pages = explicit_pages.load();
+    stats.advised_pages = advised_pages.load();
+    stats.explicit_fallbacks = explicit_fallbacks.load();
+    stats.thp_bytes = 0;
+
+    std::ifstream smaps("/proc/self/smaps_rollup");
+    std::string field;
+    size_t kb;
+    while (smaps >> field) {
+        if (field == "AnonHugePages:" && smaps >> kb) {
+            stats.thp_bytes = kb * 1024;
+            break;
+        }
+    }
+    return stats;
+}
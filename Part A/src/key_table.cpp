@@ -0,0 +1,388 @@
+/**
+ * @file key_table.cpp
+ * @brief Implementation of the BlinkDB key table with inline short keys
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#include "key_table.h"
+#include <cstring>
+#include <functional>
+#include <algorithm>
+
+/**
+ * @brief Creates an entry holding a key
+ * @param key The key
+ * @param key_hash Hash of the key
+ * @param val The value
+ */
+KeyEntry::KeyEntry(std::string_view key, uint64_t key_hash, std::string val)
+    : hash(key_hash), length(static_cast<uint32_t>(key.size())), value(std::move(val)) {
+    if (spilled()) {
+        heap_key = new char[length];
+        std::memcpy(heap_key, key.data(), length);
+    } else {
+        std::memcpy(inline_key, key.data(), length);
+    }
+}
+
+/**
+ * @brief Move constructor, takes over a spilled key
+ * @param other Entry to move from
+ */
+KeyEntry::KeyEntry(KeyEntry&& other) noexcept
+    : hash(other.hash), length(other.length), prev(other.prev), next(other.next),
+      value(std::move(other.value)) {
+    std::memcpy(inline_key, other.inline_key, INLINE_KEY_SIZE);
+    other.length = 0;
+}
+
+/**
+ * @brief Move assignment, takes over a spilled key
+ * @param other Entry to move from
+ * @return This entry
+ */
+KeyEntry& KeyEntry::operator=(KeyEntry&& other) noexcept {
+    if (this != &other) {
+        if (spilled()) {
+            delete[] heap_key;
+        }
+        hash = other.hash;
+        length = other.length;
+        prev = other.prev;
+        next = other.next;
+        value = std::move(other.value);
+        std::memcpy(inline_key, other.inline_key, INLINE_KEY_SIZE);
+        other.length = 0;
+    }
+    return *this;
+}
+
+/**
+ * @brief Destructor, frees a spilled key
+ */
+KeyEntry::~KeyEntry() {
+    if (spilled()) {
+        delete[] heap_key;
+    }
+}
+
+/**
+ * @brief Constructor
+ */
+KeyTable::KeyTable() : tags(KEY_TABLE_MIN_SLOTS, 0), slots(KEY_TABLE_MIN_SLOTS, NIL) {
+}
+
+/**
+ * @brief Hashes a key
+ * @param key The key
+ * @return 64-bit hash
+ */
+uint64_t KeyTable::hashOf(std::string_view key) {
+    return std::hash<std::string_view>{}(key);
+}
+
+/**
+ * @brief Finds the slot holding a key
+ * @param key The key
+ * @param hash Hash of the key
+ * @return Slot index, or slots.size() if the key is not present
+ *
+ * The tag filters out almost all other keys; the stored hash and length
+ * filter out the rest before any key bytes are compared.
+ */
+size_t KeyTable::findSlot(std::string_view key, uint64_t hash) const {
+    return findSlotFrom(key, hash, hash & (slots.size() - 1));
+}
+
+/**
+ * @brief Finds the slot holding a key, resuming a probe part way
+ * @param key The key
+ * @param hash Hash of the key
+ * @param start Slot to continue probing from, within the key's probe run
+ * @return Slot index, or slots.size() if the key is not present
+ */
+size_t KeyTable::findSlotFrom(std::string_view key, uint64_t hash, size_t start) const {
+    size_t mask = slots.size() - 1;
+    uint8_t tag = tagOf(hash);
+    for (size_t i = start; tags[i] != 0; i = (i + 1) & mask) {
+        if (tags[i] != tag) continue;
+        const KeyEntry& entry = entries[slots[i]];
+        if (entry.hash == hash && entry.length == key.size() && entry.key() == key) {
+            return i;
+        }
+    }
+    return slots.size();
+}
+
+/**
+ * @brief Looks up a key
+ * @param key The key
+ * @return Entry index, or NIL if the key is not present
+ */
+uint32_t KeyTable::find(std::string_view key) const {
+    size_t slot = findSlot(key, hashOf(key));
+    return slot == slots.size() ? NIL : slots[slot];
+}
+
+/**
+ * @brief Looks up many keys, overlapping their cache misses
+ * @param keys The keys
+ * @param n Number of keys
+ * @param out Entry index per key, NIL for keys that are not present
+ */
+void KeyTable::findBatch(const std::string_view* keys, size_t n, uint32_t* out) const {
+    size_t mask = slots.size() - 1;
+    uint64_t hashes[KEY_TABLE_BATCH_GROUP];
+    size_t starts[KEY_TABLE_BATCH_GROUP];
+
+    for (size_t base = 0; base < n; base += KEY_TABLE_BATCH_GROUP) {
+        size_t group = std::min<size_t>(KEY_TABLE_BATCH_GROUP, n - base);
+
+        // Stage 1: hash every key and prefetch its home slot
+        for (size_t g = 0; g < group; g++) {
+            hashes[g] = hashOf(keys[base + g]);
+            size_t home = hashes[g] & mask;
+            __builtin_prefetch(&tags[home]);
+            __builtin_prefetch(&slots[home]);
+        }
+
+        // Stage 2: skip slots with other tags and prefetch the first candidate entry
+        for (size_t g = 0; g < group; g++) {
+            uint8_t tag = tagOf(hashes[g]);
+            size_t i = hashes[g] & mask;
+            while (tags[i] != 0 && tags[i] != tag) {
+                i = (i + 1) & mask;
+            }
+            starts[g] = i;
+            if (tags[i] != 0) {
+                const char* entry = reinterpret_cast<const char*>(&entries[slots[i]]);
+                __builtin_prefetch(entry);
+                __builtin_prefetch(entry + sizeof(KeyEntry) - 1);
+            }
+        }
+
+        // Stage 3: compare keys, by now mostly against cached lines
+        for (size_t g = 0; g < group; g++) {
+            size_t slot = findSlotFrom(keys[base + g], hashes[g], starts[g]);
+            out[base + g] = (slot == slots.size()) ? NIL : slots[slot];
+        }
+    }
+}
+
+/**
+ * @brief Prepares the table for a number of entries
+ * @param n Expected number of entries
+ */
+void KeyTable::reserve(size_t n) {
+    entries.reserve(n);
+    size_t size = slots.size();
+    while (n * 4 > size * 3) {
+        size *= 2;
+    }
+    if (size != slots.size()) {
+        rehash(size);
+    }
+}
+
+/**
+ * @brief Places an entry index in the first free slot of its probe run
+ * @param entry Entry index
+ */
+void KeyTable::placeEntry(uint32_t entry) {
+    size_t mask = slots.size() - 1;
+    uint64_t hash = entries[entry].hash;
+    size_t i = hash & mask;
+    while (tags[i] != 0) {
+        i = (i + 1) & mask;
+    }
+    tags[i] = tagOf(hash);
+    slots[i] = entry;
+}
+
+/**
+ * @brief Rebuilds the hash index with a new number of slots
+ * @param size Slot count, a power of two
+ *
+ * Entries stay where they are; only their slot indices are redistributed,
+ * using the stored hashes.
+ */
+void KeyTable::rehash(size_t size) {
+    tags.assign(size, 0);
+    slots.assign(size, NIL);
+    for (uint32_t e = head; e != NIL; e = entries[e].next) {
+        placeEntry(e);
+    }
+}
+
+/**
+ * @brief Adds a key that is not yet present as the most recently used entry
+ * @param key The key
+ * @param value The value
+ * @return Entry index
+ */
+uint32_t KeyTable::insert(std::string_view key, std::string value) {
+    // Keep the load factor at or below 3/4
+    if ((count + 1) * 4 > slots.size() * 3) {
+        rehash(slots.size() * 2);
+    }
+
+    uint64_t hash = hashOf(key);
+    uint32_t entry;
+    if (!free_entries.empty()) {
+        entry = free_entries.back();
+        free_entries.pop_back();
+        entries[entry] = KeyEntry(key, hash, std::move(value));
+    } else {
+        entry = static_cast<uint32_t>(entries.size());
+        entries.emplace_back(key, hash, std::move(value));
+    }
+
+    placeEntry(entry);
+    linkFront(entry);
+    count++;
+    return entry;
+}
+
+/**
+ * @brief Removes an entry
+ * @param entry Entry index
+ *
+ * Uses backward-shift deletion: later slots of the same probe run are moved
+ * up so no tombstones are left behind.
+ */
+void KeyTable::erase(uint32_t entry) {
+    size_t mask = slots.size() - 1;
+    size_t hole = findSlot(entries[entry].key(), entries[entry].hash);
+
+    for (size_t j = (hole + 1) & mask; tags[j] != 0; j = (j + 1) & mask) {
+        size_t home = entries[slots[j]].hash & mask;
+        // Slot j may only move back if the hole lies between its home and j
+        if (((j - home) & mask) < ((j - hole) & mask)) {
+            continue;
+        }
+        tags[hole] = tags[j];
+        slots[hole] = slots[j];
+        hole = j;
+    }
+    tags[hole] = 0;
+    slots[hole] = NIL;
+
+    unlink(entry);
+    entries[entry] = KeyEntry(std::string_view(), 0, std::string());
+    free_entries.push_back(entry);
+    count--;
+}
+
+/**
+ * @brief Removes an entry from the LRU list
+ * @param entry Entry index
+ */
+void KeyTable::unlink(uint32_t entry) {
+    KeyEntry& e = entries[entry];
+    if (e.prev != NIL) entries[e.prev].next = e.next; else head = e.next;
+    if (e.next != NIL) entries[e.next].prev = e.prev; else tail = e.prev;
+}
+
+/**
+ * @brief Inserts an entry at the most recently used end of the LRU list
+ * @param entry Entry index
+ */
+void KeyTable::linkFront(uint32_t entry) {
+    entries[entry].prev = NIL;
+    entries[entry].next = head;
+    if (head != NIL) entries[head].prev = entry; else tail = entry;
+    head = entry;
+}
+
+/**
+ * @brief Marks an entry as most recently used
+ * @param entry Entry index
+ */
+void KeyTable::touch(uint32_t entry) {
+    if (head != entry) {
+        unlink(entry);
+        linkFront(entry);
+    }
+}
+
+/**
+ * @brief Heap bytes owned by a string beyond the string object itself
+ * @param s The string
+ * @return Allocated capacity, or 0 while the string fits its inline buffer
+ */
+static size_t stringHeapBytes(const std::string& s) {
+    return (s.capacity() > std::string().capacity()) ? s.capacity() + 1 : 0;
+}
+
+/**
+ * @brief Bytes attributable to one entry
+ * @param entry Entry index
+ * @return The entry, its share of the hash index, and its key and value heap allocations
+ */
+size_t KeyTable::entryMemory(uint32_t entry) const {
+    const KeyEntry& e = entries[entry];
+    size_t index_share = count ? (slots.size() * (sizeof(uint32_t) + sizeof(uint8_t))) / count : 0;
+    return sizeof(KeyEntry) + index_share + (e.spilled() ? e.length : 0) + stringHeapBytes(e.value);
+}
+
+/**
+ * @brief Bytes used by the table, split by structure
+ * @return Memory breakdown, computed by walking every entry
+ */
+KeyTableMemory KeyTable::memory() const {
+    KeyTableMemory memory;
+    memory.entry_bytes = entries.capacity() * sizeof(KeyEntry) + free_entries.capacity() * sizeof(uint32_t);
+    memory.index_bytes = slots.capacity() * sizeof(uint32_t) + tags.capacity();
+    memory.free_entries = free_entries.size();
+    for (uint32_t e = head; e != NIL; e = entries[e].next) {
+        if (entries[e].spilled()) {
+            memory.spilled_key_bytes += entries[e].length;
+        }
+        memory.value_heap_bytes += stringHeapBytes(entries[e].value);
+    }
+    return memory;
+}
+
+/**
+ * @brief Picks a pseudo-random entry
+ * @param random A random number
+ * @return Entry index, or NIL if the table is empty
+ */
+uint32_t KeyTable::randomEntry(uint64_t random) const {
+    if (count == 0) {
+        return NIL;
+    }
+    size_t mask = slots.size() - 1;
+    size_t i = random & mask;
+    while (tags[i] == 0) {
+        i = (i + 1) & mask;
+    }
+    return slots[i];
+}
+
+/**
+ * @brief Collects the keys whose home slot is in a range
+ * @param cursor First home slot to visit
+ * @param count Approximate number of keys to return
+ * @param keys Output vector the keys are appended to
+ * @return Next home slot to visit, 0 once every slot was visited
+ */
+size_t KeyTable::scan(size_t cursor, size_t count, std::vector<std::string>& keys) const {
+    size_t size = slots.size();
+    size_t mask = size - 1;
+    size_t found = 0;
+
+    while (cursor < size && found < count) {
+        // Keys with this home slot sit in the probe run that starts there
+        for (size_t i = cursor; tags[i] != 0; i = (i + 1) & mask) {
+            const KeyEntry& entry = entries[slots[i]];
+            if ((entry.hash & mask) == cursor) {
+                keys.emplace_back(entry.key());
+                found++;
+            }
+        }
+        cursor++;
+    }
+    return (cursor >= size) ? 0 : cursor;
+}
@@ -11,10 +11,236 @@
 #include "blinkdb.h"
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <sstream>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @brief Size of the blocks read from the input in batch mode
+ */
+#define BATCH_READ_SIZE (4 * 1024 * 1024)
+
+/**
+ * @brief Maximum number of commands applied in one batched call
+ */
+#define BATCH_MAX_OPS 1024
+
+/**
+ * @class BatchRunner
+ * @brief Applies commands from a file or stdin through the batched BlinkDB APIs
+ *
+ * Consecutive commands of the same kind are grouped and applied with one
+ * mset, mget or mdel call, so the database lock is taken once per group
+ * instead of once per command. Output matches the interactive REPL.
+ */
+class BatchRunner {
+private:
+    /**
+     * @brief Database the commands are applied to
+     */
+    BlinkDB& db;
+    
+    /**
+     * @brief Pending SET commands
+     */
+    std::vector<std::pair<std::string, std::string>> sets;
+    
+    /**
+     * @brief Pending GET or DEL keys
+     */
+    std::vector<std::string> keys;
+    
+    /**
+     * @brief Kind of the pending group: 'S', 'G', 'D' or 0 for none
+     */
+    char pending = 0;
+    
+    /**
+     * @brief Buffered output, written in large blocks
+     */
+    std::string output;
+    
+    /**
+     * @brief Number of commands applied
+     */
+    size_t commands = 0;
+    
+    /**
+     * @brief Number of lines rejected as invalid
+     */
+    size_t errors = 0;
+    
+    /**
+     * @brief Applies the pending group of commands
+     */
+    void flush() {
+        if (pending == 'S') {
+            db.mset(sets);
+            sets.clear();
+        } else if (pending == 'G') {
+            for (const auto& value : db.mget(keys)) {
+                output.append(value.empty() ? "NULL" : value).append(1, '\n');
+            }
+            keys.clear();
+        } else if (pending == 'D') {
+            for (bool deleted : db.mdel(keys)) {
+                output.append(deleted ? "OK\n" : "Does not exist.\n");
+            }
+            keys.clear();
+        }
+        pending = 0;
+        
+        if (output.size() >= BATCH_READ_SIZE) {
+            writeOutput();
+        }
+    }
+    
+    /**
+     * @brief Writes the buffered output to stdout
+     */
+    void writeOutput() {
+        std::cout.write(output.data(), output.size());
+        output.clear();
+    }
+    
+    /**
+     * @brief Splits the next whitespace-delimited token off a line
+     * @param line Remaining line, advanced past the token
+     * @return The token, empty if the line is exhausted
+     */
+    static std::string_view nextToken(std::string_view& line) {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string_view::npos) {
+            line = std::string_view();
+            return line;
+        }
+        size_t end = line.find_first_of(" \t", start);
+        if (end == std::string_view::npos) end = line.size();
+        std::string_view token = line.substr(start, end - start);
+        line.remove_prefix(end);
+        return token;
+    }
+    
+    /**
+     * @brief Queues one command, flushing the pending group if its kind changes
+     * @param kind Kind of the command
+     */
+    void begin(char kind) {
+        if (pending != kind || sets.size() + keys.size() >= BATCH_MAX_OPS) {
+            flush();
+        }
+        pending = kind;
+        commands++;
+    }
+    
+    /**
+     * @brief Parses and queues a single line
+     * @param line The line, without its terminator
+     * @return false if the line asks to stop (EXIT/QUIT)
+     */
+    bool processLine(std::string_view line) {
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        
+        std::string_view operation = nextToken(line);
+        if (operation.empty()) return true;
+        
+        if (operation == "SET") {
+            std::string_view key = nextToken(line);
+            size_t value_start = line.find_first_not_of(" \t");
+            if (key.empty() || value_start == std::string_view::npos) {
+                flush();
+                output.append("ERROR: Invalid command. Value must be provided.\n");
+                errors++;
+                return true;
+            }
+            begin('S');
+            sets.emplace_back(key, line.substr(value_start));
+        } else if (operation == "GET" || operation == "DEL") {
+            begin(operation[0]);
+            keys.emplace_back(nextToken(line));
+        } else if (operation == "EXIT" || operation == "QUIT") {
+            return false;
+        } else {
+            flush();
+            output.append("ERROR: Invalid command\n");
+            errors++;
+        }
+        return true;
+    }
+
+public:
+    /**
+     * @brief Constructor
+     * @param database Database the commands are applied to
+     */
+    explicit BatchRunner(BlinkDB& database) : db(database) {}
+    
+    /**
+     * @brief Reads and applies every command from a file descriptor
+     * @param fd File descriptor to read from
+     * 
+     * The input is read in BATCH_READ_SIZE blocks and tokenized in place;
+     * only a line split across two blocks is copied.
+     */
+    void run(int fd) {
+        auto start = std::chrono::high_resolution_clock::now();
+        
+        std::vector<char> block(BATCH_READ_SIZE);
+        std::string carry;
+        bool running = true;
+        
+        while (running) {
+            ssize_t n = read(fd, block.data(), block.size());
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            
+            std::string_view data(block.data(), n);
+            if (!carry.empty()) {
+                // Finish the line that straddled the previous block
+                size_t newline = data.find('\n');
+                if (newline == std::string_view::npos) {
+                    carry.append(data);
+                    continue;
+                }
+                carry.append(data.substr(0, newline));
+                running = processLine(carry);
+                carry.clear();
+                data.remove_prefix(newline + 1);
+            }
+            
+            while (running) {
+                size_t newline = data.find('\n');
+                if (newline == std::string_view::npos) {
+                    carry.assign(data);
+                    break;
+                }
+                running = processLine(data.substr(0, newline));
+                data.remove_prefix(newline + 1);
+            }
+        }
+        if (running && !carry.empty()) {
+            processLine(carry);
+        }
+        flush();
+        writeOutput();
+        std::cout.flush();
+        
+        auto end = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+        std::cerr << "Executed " << commands << " commands (" << errors << " invalid) in "
+                  << static_cast<long>(ms) << " ms, "
+                  << static_cast<long>(commands / std::max(ms / 1000.0, 1e-6)) << " ops/sec\n";
+    }
+};
 
 /**
  * @brief Main function implementing a REPL for BlinkDB
+ * @param argc Number of command-line arguments
+ * @param argv Array of command-line arguments
  * @return Exit code
  * 
  * Provides a command-line interface for interacting with BlinkDB.
@@ -23,17 +249,34 @@
  * - GET <key>: Retrieves a value by key
  * - DEL <key>: Deletes a key-value pair
  * - EXIT/QUIT: Exits the program
+ * 
+ * With -b [file] the commands are read from the file (or stdin) in batch
+ * mode, without prompts, and an ops/sec summary is printed to stderr.
  */
-int main() {
+int main(int argc, char* argv[]) {
     BlinkDB db;
     std::string command;
     
+    if (argc >= 2 && std::strcmp(argv[1], "-b") == 0) {
+        int fd = STDIN_FILENO;
+        if (argc >= 3 && std::strcmp(argv[2], "-") != 0) {
+            fd = open(argv[2], O_RDONLY);
+            if (fd < 0) {
+                std::cerr << "ERROR: Cannot open " << argv[2] << "\n";
+                return 1;
+            }
+        }
+        BatchRunner(db).run(fd);
+        if (fd != STDIN_FILENO) close(fd);
+        return 0;
+    }
+    
     std::cout << "BlinkDB REPL\n";
     std::cout << "Commands: SET <key> <value>, GET <key>, DEL <key>\n";
     
     while (true) {
         std::cout << "User> ";
-        std::getline(std::cin, command);
+        if (!std::getline(std::cin, command)) break; // End of input
         
         if (command.empty()) continue;
         
@@ -0,0 +1,222 @@
+/**
+ * @file memory_bench.cpp
+ * @brief Benchmark of BlinkDB's memory overhead per key across key and value sizes
+ * @author Madhumita
+ * @date 2025-03-31
+ *
+ * Compilation: g++ -std=c++17 -O2 blinkdb.cpp key_table.cpp huge_pages.cpp trace.cpp memory_bench.cpp -o memory_bench -lpthread
+ * Execution: ./memory_bench [-n keys] [-k key_sizes] [-v value_sizes] [-j output.json]
+ */
+
+#include "blinkdb.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <malloc.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define BENCH_FILE "memory_bench.dat"
+#define DEFAULT_KEYS 1000000
+
+/**
+ * @struct MemoryResult
+ * @brief Memory used by one key and value shape
+ *
+ * Plain data, so a child process can hand it to the parent through a pipe.
+ */
+struct MemoryResult {
+    size_t keys;
+    size_t key_size;
+    size_t value_size;
+    size_t rss_bytes;          // RSS growth while loading
+    size_t allocated_bytes;    // Allocator growth while loading, huge page mappings included
+    MemoryStats stats;         // BlinkDB's own breakdown after loading
+};
+
+/**
+ * @brief Resident set size of the process
+ * @return RSS in bytes
+ */
+static size_t residentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * @brief Bytes handed out by malloc plus the key table's huge page mappings
+ * @return Allocated bytes
+ */
+static size_t allocatedBytes() {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd + HugePages::stats().mapped_bytes;
+}
+
+/**
+ * @brief Loads keys of one shape into a fresh BlinkDB and measures it
+ * @param keys Number of keys
+ * @param key_size Bytes per key
+ * @param value_size Bytes per value
+ * @return The measurements
+ */
+static MemoryResult measure(size_t keys, size_t key_size, size_t value_size) {
+    std::remove(BENCH_FILE);
+    std::string value(value_size, 'v');
+    std::vector<char> key(key_size + 32);
+
+    MemoryResult result = {keys, key_size, value_size, 0, 0, MemoryStats()};
+    size_t rss_before = residentBytes();
+    size_t allocated_before = allocatedBytes();
+
+    // Heap-allocated and never destroyed: the child exits without persisting
+    BlinkDB* db = new BlinkDB(keys, BENCH_FILE);
+    for (size_t i = 0; i < keys; i++) {
+        // Zero-padded index; keys shorter than the index keep its last digits
+        int length = std::snprintf(key.data(), key.size(), "%0*zu", static_cast<int>(key_size), i);
+        db->set(std::string(key.data() + length - key_size, key_size), value);
+    }
+
+    result.rss_bytes = residentBytes() - rss_before;
+    result.allocated_bytes = allocatedBytes() - allocated_before;
+    result.stats = db->memoryStats();
+    return result;
+}
+
+/**
+ * @brief Measures one shape in a child process
+ * @param keys Number of keys
+ * @param key_size Bytes per key
+ * @param value_size Bytes per value
+ * @param result Output measurements
+ * @return true if the child reported a result
+ *
+ * A fresh process per shape keeps memory freed by earlier shapes, which
+ * malloc holds on to, from hiding the growth of later ones.
+ */
+static bool measureInChild(size_t keys, size_t key_size, size_t value_size, MemoryResult& result) {
+    int fds[2];
+    if (pipe(fds) < 0) {
+        return false;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        MemoryResult measured = measure(keys, key_size, value_size);
+        ssize_t written = write(fds[1], &measured, sizeof(measured));
+        _exit(written == sizeof(measured) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ssize_t got = read(fds[0], &result, sizeof(result));
+    close(fds[0]);
+    waitpid(pid, nullptr, 0);
+    std::remove(BENCH_FILE);
+    return got == sizeof(result);
+}
+
+/**
+ * @brief Parses a comma-separated list of sizes
+ * @param text The list
+ * @return The sizes
+ */
+static std::vector<size_t> parseSizes(const std::string& text) {
+    std::vector<size_t> sizes;
+    std::stringstream list(text);
+    std::string size;
+    while (std::getline(list, size, ',')) {
+        sizes.push_back(std::stoull(size));
+    }
+    return sizes;
+}
+
+/**
+ * @brief Writes all results as JSON
+ * @param path Output file
+ * @param results The results
+ */
+static void writeJson(const std::string& path, const std::vector<MemoryResult>& results) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Error: cannot write " << path << std::endl;
+        return;
+    }
+    out << "{\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const MemoryResult& r = results[i];
+        double n = static_cast<double>(r.keys);
+        out << (i ? "," : "") << "\n    {\"keys\": " << r.keys << ", \"key_size\": " << r.key_size
+            << ", \"value_size\": " << r.value_size << ", \"rss_bytes\": " << r.rss_bytes
+            << ", \"allocated_bytes\": " << r.allocated_bytes
+            << ", \"rss_per_key\": " << r.rss_bytes / n << ", \"allocated_per_key\": " << r.allocated_bytes / n
+            << ", \"overhead_per_key\": " << r.allocated_bytes / n - (r.key_size + r.value_size)
+            << ", \"entry_bytes\": " << r.stats.table.entry_bytes << ", \"index_bytes\": " << r.stats.table.index_bytes
+            << ", \"spilled_key_bytes\": " << r.stats.table.spilled_key_bytes
+            << ", \"value_heap_bytes\": " << r.stats.table.value_heap_bytes << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+/**
+ * @brief Main function
+ * @param argc Number of command-line arguments
+ * @param argv Array of command-line arguments
+ * @return Exit code
+ */
+int main(int argc, char* argv[]) {
+    size_t keys = DEFAULT_KEYS;
+    std::vector<size_t> key_sizes = {16, 64};
+    std::vector<size_t> value_sizes = {8, 32, 256, 1024};
+    std::string json_path;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc) {
+            keys = std::stoull(argv[++i]);
+        } else if (arg == "-k" && i + 1 < argc) {
+            key_sizes = parseSizes(argv[++i]);
+        } else if (arg == "-v" && i + 1 < argc) {
+            value_sizes = parseSizes(argv[++i]);
+        } else if (arg == "-j" && i + 1 < argc) {
+            json_path = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [-n keys] [-k size,...] [-v size,...] [-j output.json]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<MemoryResult> results;
+    for (size_t key_size : key_sizes) {
+        for (size_t value_size : value_sizes) {
+            MemoryResult r;
+            if (!measureInChild(keys, key_size, value_size, r)) {
+                std::cerr << "Measurement failed for key size " << key_size << ", value size " << value_size << std::endl;
+                continue;
+            }
+            double n = static_cast<double>(r.keys);
+            double payload = static_cast<double>(key_size + value_size);
+            std::printf("key %5zu B  value %5zu B: RSS %7.1f B/key  allocated %7.1f B/key  "
+                        "overhead %6.1f B/key (%.2fx payload)\n",
+                        key_size, value_size, r.rss_bytes / n, r.allocated_bytes / n,
+                        r.allocated_bytes / n - payload, r.allocated_bytes / n / payload);
+            std::printf("    entries %.1f  index %.1f  spilled keys %.1f  values %.1f B/key\n",
+                        r.stats.table.entry_bytes / n, r.stats.table.index_bytes / n,
+                        r.stats.table.spilled_key_bytes / n, r.stats.table.value_heap_bytes / n);
+            results.push_back(r);
+        }
+    }
+
+    if (!json_path.empty()) {
+        writeJson(json_path, results);
+    }
+    return 0;
+}
@@ -0,0 +1,193 @@
+/**
+ * @file perf_counters.cpp
+ * @brief Implementation of hardware performance counters read around benchmark phases
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#include "perf_counters.h"
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+/**
+ * @brief Encodes a generalized cache event
+ * @param cache Cache, e.g. PERF_COUNT_HW_CACHE_L1D
+ * @return Config value for a read miss in that cache
+ */
+static constexpr uint64_t cacheReadMiss(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+/**
+ * @brief perf_event_attr type and config per PerfEvent
+ */
+static const uint64_t EVENT_CONFIG[PERF_EVENT_COUNT][2] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, cacheReadMiss(PERF_COUNT_HW_CACHE_L1D)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, cacheReadMiss(PERF_COUNT_HW_CACHE_DTLB)},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+
+/**
+ * @brief Short name of an event
+ * @param event The event
+ * @return e.g. "LLC-misses"
+ */
+const char* PerfCounters::eventName(int event) {
+    static const char* names[PERF_EVENT_COUNT] = {
+        "cycles", "instructions", "L1d-misses", "LLC-misses", "branch-misses", "dTLB-misses", "page-faults"
+    };
+    return names[event];
+}
+
+/**
+ * @brief Opens every event for the calling thread and threads it creates later
+ */
+PerfCounters::PerfCounters() {
+    for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = static_cast<uint32_t>(EVENT_CONFIG[event][0]);
+        attr.config = EVENT_CONFIG[event][1];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        fds[event] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+        if (fds[event] < 0 && error.empty()) {
+            error = std::string(eventName(event)) + ": " + std::strerror(errno);
+        }
+    }
+}
+
+/**
+ * @brief Destructor, closes the events
+ */
+PerfCounters::~PerfCounters() {
+    for (int fd : fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+/**
+ * @brief Checks whether any event can be counted
+ * @return true if at least one event is open
+ */
+bool PerfCounters::available() const {
+    for (int fd : fds) {
+        if (fd >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Describes events that could not be opened
+ * @return Empty if every event is open, otherwise a short explanation
+ */
+std::string PerfCounters::unavailableReason() const {
+    std::string missing;
+    for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+        if (fds[event] < 0) {
+            missing += (missing.empty() ? "" : ", ") + std::string(eventName(event));
+        }
+    }
+    if (missing.empty()) {
+        return "";
+    }
+    return "not counting " + missing + " (" + error + ")";
+}
+
+/**
+ * @brief Reads an event's raw value, enabled time and running time
+ * @param event The event
+ * @param out Output triple
+ * @return true on success
+ */
+bool PerfCounters::readEvent(int event, uint64_t out[3]) const {
+    return fds[event] >= 0 && read(fds[event], out, 3 * sizeof(uint64_t)) == 3 * sizeof(uint64_t);
+}
+
+/**
+ * @brief Starts a measured phase
+ */
+void PerfCounters::start() {
+    for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+        readEvent(event, started[event]);
+    }
+}
+
+/**
+ * @brief Ends a measured phase
+ * @return Counts since the last start()
+ *
+ * Counters are never reset, so phases cannot disturb each other; the
+ * difference of two reads is scaled by enabled over running time, which
+ * corrects for the kernel multiplexing more events than the PMU has
+ * counters.
+ */
+PerfSample PerfCounters::stop() const {
+    PerfSample sample;
+    for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+        uint64_t now[3];
+        if (!readEvent(event, now)) {
+            continue;
+        }
+        double value = static_cast<double>(now[0] - started[event][0]);
+        uint64_t enabled = now[1] - started[event][1];
+        uint64_t running = now[2] - started[event][2];
+        if (running == 0) {
+            // Never scheduled onto the PMU during the phase
+            continue;
+        }
+        sample.counts[event] = (running < enabled) ? value * enabled / running : value;
+        sample.valid[event] = true;
+    }
+    return sample;
+}
+
+/**
+ * @brief Adds another phase's counts to this one
+ * @param other The other sample
+ */
+void PerfSample::add(const PerfSample& other) {
+    for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+        counts[event] += other.counts[event];
+        valid[event] = valid[event] || other.valid[event];
+    }
+}
+
+/**
+ * @brief Formats the counts divided by a number of operations
+ * @param ops Operations performed in the phase
+ * @return e.g. "cycles 312.4  instructions 120.1  IPC 0.38  L1d-misses 3.2 ..."
+ */
+std::string PerfSample::perOp(double ops) const {
+    std::string text;
+    char field[64];
+    for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+        if (!valid[event]) {
+            continue;
+        }
+        std::snprintf(field, sizeof(field), "%s%s %.2f", text.empty() ? "" : "  ",
+                      PerfCounters::eventName(event), counts[event] / ops);
+        text += field;
+        if (event == PERF_INSTRUCTIONS && valid[PERF_CYCLES] && counts[PERF_CYCLES] > 0) {
+            std::snprintf(field, sizeof(field), "  IPC %.2f", counts[PERF_INSTRUCTIONS] / counts[PERF_CYCLES]);
+            text += field;
+        }
+    }
+    return text.empty() ? "no counters" : text;
+}
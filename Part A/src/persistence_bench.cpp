@@ -0,0 +1,282 @@
+/**
+ * @file persistence_bench.cpp
+ * @brief Benchmarks of BlinkDB's disk side: checkpoints, restarts and evicted-key restores
+ * @author Madhumita
+ * @date 2025-03-31
+ *
+ * Compilation: g++ -std=c++17 -O2 blinkdb.cpp key_table.cpp huge_pages.cpp trace.cpp bench_util.cpp persistence_bench.cpp -o persistence_bench -lpthread
+ * Execution: ./persistence_bench [-n sizes] [-v value_size] [-j output.json]
+ */
+
+#include "blinkdb.h"
+#include "bench_util.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define BENCH_FILE "persistence_bench.dat"
+#define DEFAULT_VALUE_SIZE 32
+#define BASELINE_OPS 100000
+#define RESTORE_SAMPLES 10
+
+/**
+ * @struct PersistenceResult
+ * @brief Measurements for one dataset size
+ */
+struct PersistenceResult {
+    size_t keys = 0;
+    double file_mb = 0;
+    double checkpoint_ms = 0;
+    double baseline_p50_us = 0;    // GET latency without a flush running
+    double baseline_p99_us = 0;
+    double flush_p50_us = 0;       // GET latency while a flush runs
+    double flush_p99_us = 0;
+    double flush_max_us = 0;
+    size_t flush_ops = 0;          // GETs completed while the flush ran
+    double restore_median_ms = 0;  // Evicted-key restores
+    double restore_max_ms = 0;
+    double restart_ms = 0;
+    size_t restart_keys = 0;
+};
+
+/**
+ * @brief Milliseconds elapsed since a point in time
+ * @param start The point in time
+ * @return Elapsed milliseconds
+ */
+static double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Key name for an index
+ * @param i The index
+ * @return Fixed-width key, so every key takes the same space in the file
+ */
+static std::string keyName(size_t i) {
+    char key[32];
+    std::snprintf(key, sizeof(key), "key:%010zu", i);
+    return key;
+}
+
+/**
+ * @brief Bytes of memory currently available, per /proc/meminfo
+ * @return MemAvailable in bytes, or 0 if unknown
+ */
+static size_t availableMemory() {
+    std::ifstream meminfo("/proc/meminfo");
+    std::string name;
+    size_t kb;
+    while (meminfo >> name >> kb) {
+        if (name == "MemAvailable:") {
+            return kb * 1024;
+        }
+        meminfo.ignore(256, '\n');
+    }
+    return 0;
+}
+
+/**
+ * @brief Times GETs of random resident keys, one at a time
+ * @param db The database
+ * @param keys Number of keys, named keyName(0) to keyName(keys - 1)
+ * @param rng Random source
+ * @param stop Ends the loop when set, or null to run BASELINE_OPS GETs
+ * @return Latency of each GET in microseconds
+ */
+static std::vector<double> timeGets(BlinkDB& db, size_t keys, std::mt19937_64& rng, const std::atomic<bool>* stop) {
+    std::vector<double> latencies;
+    while (stop ? !stop->load() : latencies.size() < BASELINE_OPS) {
+        std::string key = keyName(rng() % keys);
+        auto start = std::chrono::steady_clock::now();
+        db.get(key);
+        latencies.push_back(msSince(start) * 1000);
+    }
+    return latencies;
+}
+
+/**
+ * @brief Runs every measurement for one dataset size
+ * @param keys Number of keys
+ * @param value_size Bytes per value
+ * @return The measurements
+ */
+static PersistenceResult runSize(size_t keys, size_t value_size) {
+    PersistenceResult result;
+    result.keys = keys;
+    std::mt19937_64 rng(keys);
+    std::string value(value_size, 'v');
+    std::remove(BENCH_FILE);
+
+    auto db = std::make_unique<BlinkDB>(keys, BENCH_FILE);
+    for (size_t i = 0; i < keys; i++) {
+        db->set(keyName(i), value);
+    }
+
+    // Checkpoint: one full persistToFile
+    auto start = std::chrono::steady_clock::now();
+    db->persistToFile();
+    result.checkpoint_ms = msSince(start);
+    result.file_mb = std::filesystem::file_size(BENCH_FILE) / 1e6;
+
+    // Foreground GET latency without and then during a flush
+    std::vector<double> baseline = timeGets(*db, keys, rng, nullptr);
+    result.baseline_p50_us = benchPercentile(baseline, 0.5);
+    result.baseline_p99_us = benchPercentile(baseline, 0.99);
+
+    std::atomic<bool> flushed{false};
+    std::thread flusher([&db, &flushed]() {
+        db->persistToFile();
+        flushed = true;
+    });
+    std::vector<double> during = timeGets(*db, keys, rng, &flushed);
+    flusher.join();
+    result.flush_ops = during.size();
+    result.flush_p50_us = benchPercentile(during, 0.5);
+    result.flush_p99_us = benchPercentile(during, 0.99);
+    result.flush_max_us = benchPercentile(during, 1.0);
+
+    // Evicted-key restore: victims evenly spaced through the file, made least
+    // recently used by touching every other key, then pushed out by new keys
+    std::vector<size_t> victims;
+    for (size_t k = 0; k < RESTORE_SAMPLES; k++) {
+        victims.push_back((2 * k + 1) * keys / (2 * RESTORE_SAMPLES));
+    }
+    for (size_t i = 0, v = 0; i < keys; i++) {
+        if (v < victims.size() && victims[v] == i) {
+            v++;
+        } else {
+            db->get(keyName(i));
+        }
+    }
+    for (size_t k = 0; k < RESTORE_SAMPLES; k++) {
+        db->set("filler:" + std::to_string(k), value);
+    }
+    std::vector<double> restores;
+    for (size_t victim : victims) {
+        start = std::chrono::steady_clock::now();
+        if (db->get(keyName(victim)) != value) {
+            std::cerr << "Restore of " << keyName(victim) << " returned a wrong value" << std::endl;
+        }
+        restores.push_back(msSince(start));
+    }
+    result.restore_median_ms = benchPercentile(restores, 0.5);
+    result.restore_max_ms = benchPercentile(restores, 1.0);
+
+    // Restart: the destructor writes the final state, then a new instance loads it
+    db.reset();
+    start = std::chrono::steady_clock::now();
+    db = std::make_unique<BlinkDB>(keys, BENCH_FILE);
+    result.restart_ms = msSince(start);
+    result.restart_keys = db->memoryStats().keys;
+
+    db.reset();
+    std::remove(BENCH_FILE);
+    return result;
+}
+
+/**
+ * @brief Prints one result in readable form
+ * @param r The result
+ */
+static void printResult(const PersistenceResult& r) {
+    std::cout << "Keys: " << r.keys << " (" << r.file_mb << " MB on disk)\n"
+              << "  Checkpoint: " << r.checkpoint_ms << " ms, "
+              << r.keys / (r.checkpoint_ms / 1000) / 1e6 << " Mkeys/s, "
+              << r.file_mb / (r.checkpoint_ms / 1000) << " MB/s\n"
+              << "  GET latency idle: p50 " << r.baseline_p50_us << " us, p99 " << r.baseline_p99_us << " us\n"
+              << "  GET latency during flush: p50 " << r.flush_p50_us << " us, p99 " << r.flush_p99_us
+              << " us, max " << r.flush_max_us << " us over " << r.flush_ops << " GETs\n"
+              << "  Evicted-key restore: median " << r.restore_median_ms << " ms, max " << r.restore_max_ms << " ms\n"
+              << "  Restart to ready: " << r.restart_ms << " ms for " << r.restart_keys << " keys, "
+              << r.restart_keys / (r.restart_ms / 1000) / 1e6 << " Mkeys/s\n";
+}
+
+/**
+ * @brief Writes all results as JSON
+ * @param path Output file
+ * @param results The results
+ * @param value_size Bytes per value
+ */
+static void writeJson(const std::string& path, const std::vector<PersistenceResult>& results, size_t value_size) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Error: cannot write " << path << std::endl;
+        return;
+    }
+    out << "{\n  \"value_size\": " << value_size << ",\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const PersistenceResult& r = results[i];
+        out << (i ? "," : "") << "\n    {\"keys\": " << r.keys << ", \"file_mb\": " << r.file_mb
+            << ", \"checkpoint_ms\": " << r.checkpoint_ms
+            << ", \"baseline_p50_us\": " << r.baseline_p50_us << ", \"baseline_p99_us\": " << r.baseline_p99_us
+            << ", \"flush_p50_us\": " << r.flush_p50_us << ", \"flush_p99_us\": " << r.flush_p99_us
+            << ", \"flush_max_us\": " << r.flush_max_us << ", \"flush_ops\": " << r.flush_ops
+            << ", \"restore_median_ms\": " << r.restore_median_ms << ", \"restore_max_ms\": " << r.restore_max_ms
+            << ", \"restart_ms\": " << r.restart_ms << ", \"restart_keys\": " << r.restart_keys << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+/**
+ * @brief Main function
+ * @param argc Number of command-line arguments
+ * @param argv Array of command-line arguments
+ * @return Exit code
+ *
+ * Sizes whose estimated footprint exceeds the memory available are skipped
+ * with a note rather than pushing the machine into swap.
+ */
+int main(int argc, char* argv[]) {
+    std::vector<size_t> sizes = {100000, 1000000, 10000000, 50000000};
+    size_t value_size = DEFAULT_VALUE_SIZE;
+    std::string json_path;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc) {
+            sizes.clear();
+            std::stringstream list(argv[++i]);
+            std::string size;
+            while (std::getline(list, size, ',')) {
+                sizes.push_back(std::stoull(size));
+            }
+        } else if (arg == "-v" && i + 1 < argc) {
+            value_size = std::stoull(argv[++i]);
+        } else if (arg == "-j" && i + 1 < argc) {
+            json_path = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [-n size,size,...] [-v value_size] [-j output.json]" << std::endl;
+            return 1;
+        }
+    }
+
+    // Entry, hash index share, heap value beyond the string's inline buffer, evicted-key set slack
+    size_t per_key = sizeof(KeyEntry) + 16 + (value_size > 15 ? value_size + 17 : 0) + 16;
+    std::vector<PersistenceResult> results;
+    for (size_t keys : sizes) {
+        size_t available = availableMemory();
+        if (available && keys * per_key * 3 / 2 > available) {
+            std::cout << "Keys: " << keys << " skipped, needs about " << keys * per_key / (1 << 20)
+                      << " MB with " << available / (1 << 20) << " MB available\n";
+            continue;
+        }
+        results.push_back(runSize(keys, value_size));
+        printResult(results.back());
+    }
+
+    if (!json_path.empty()) {
+        writeJson(json_path, results, value_size);
+    }
+    return 0;
+}
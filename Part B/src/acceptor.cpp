@@ -0,0 +1,126 @@
+/**
+ * @file acceptor.cpp
+ * @brief Implementation of the thread accepting connections on behalf of the event loop
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#include "acceptor.h"
+#include "trace.h"
+#include <iostream>
+#include <stdexcept>
+#include <chrono>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+
+/**
+ * @brief Constructor
+ * @param listening_socket Non-blocking listening socket
+ */
+Acceptor::Acceptor(int listening_socket) : listen_fd(listening_socket) {
+    ready_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ready_fd < 0 || stop_fd < 0) {
+        throw std::runtime_error("Acceptor eventfd creation failed");
+    }
+    ready.reserve(ACCEPT_BATCH);
+}
+
+/**
+ * @brief Destructor, stops the thread and closes sockets never taken
+ */
+Acceptor::~Acceptor() {
+    if (thread.joinable()) {
+        uint64_t one = 1;
+        ssize_t written = write(stop_fd, &one, sizeof(one));
+        (void)written;
+        thread.join();
+    }
+    for (int fd : ready) {
+        close(fd);
+    }
+    close(ready_fd);
+    close(stop_fd);
+}
+
+/**
+ * @brief Starts the accepting thread
+ *
+ * The thread inherits the caller's CPU affinity, so starting it before the
+ * event loop pins itself keeps it off a busy-poll CPU.
+ */
+void Acceptor::start() {
+    thread = std::thread(&Acceptor::run, this);
+}
+
+/**
+ * @brief Takes every waiting socket
+ * @param sockets Output, replaced by the waiting sockets
+ */
+void Acceptor::take(std::vector<int>& sockets) {
+    // Reset the eventfd first: a batch queued after this still signals it again
+    uint64_t count;
+    ssize_t bytes = read(ready_fd, &count, sizeof(count));
+    (void)bytes;
+    sockets.clear();
+    std::lock_guard<std::mutex> guard(lock);
+    sockets.swap(ready);
+}
+
+/**
+ * @brief Thread function, accepts until asked to stop
+ *
+ * Out of descriptors, accept4 keeps failing while the connection waits in
+ * the backlog, so the thread pauses briefly instead of spinning on it.
+ */
+void Acceptor::run() {
+    Tracer::setThreadName("acceptor");
+    pollfd poll_fds[2] = {{listen_fd, POLLIN, 0}, {stop_fd, POLLIN, 0}};
+    std::vector<int> batch;
+    batch.reserve(ACCEPT_BATCH);
+
+    while (true) {
+        if (poll(poll_fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Acceptor poll failed" << std::endl;
+            return;
+        }
+        if (poll_fds[1].revents & POLLIN) {
+            return;
+        }
+
+        bool exhausted = false;
+        while (batch.size() < ACCEPT_BATCH) {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd >= 0) {
+                batch.push_back(fd);
+                continue;
+            }
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            exhausted = (errno == EMFILE || errno == ENFILE);
+            if (errno != EAGAIN && errno != EWOULDBLOCK && !exhausted) {
+                std::cerr << "Accept failed" << std::endl;
+            }
+            break;
+        }
+
+        if (!batch.empty()) {
+            accepted.fetch_add(batch.size(), std::memory_order_relaxed);
+            batches.fetch_add(1, std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                ready.insert(ready.end(), batch.begin(), batch.end());
+            }
+            batch.clear();
+            uint64_t one = 1;
+            ssize_t written = write(ready_fd, &one, sizeof(one));
+            (void)written;
+        }
+        if (exhausted) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(ACCEPT_FD_EXHAUSTED_PAUSE_MS));
+        }
+    }
+}
@@ -0,0 +1,133 @@
+/**
+ * @file acceptor.h
+ * @brief Header file for the thread accepting connections on behalf of the event loop
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#ifndef ACCEPTOR_H
+#define ACCEPTOR_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Connections accepted per wakeup before they are handed over
+ */
+#define ACCEPT_BATCH 256
+
+/**
+ * @brief Pause after running out of file descriptors, in milliseconds
+ */
+#define ACCEPT_FD_EXHAUSTED_PAUSE_MS 10
+
+/**
+ * @class Acceptor
+ * @brief Accepts connections on its own thread and hands them to the event loop in batches
+ *
+ * The thread drains the listening socket with accept4, up to ACCEPT_BATCH
+ * sockets per wakeup, already non-blocking and close-on-exec. Each batch
+ * is queued and announced with a single eventfd write, so a storm of
+ * connections costs the event loop one wakeup per batch rather than one
+ * per connection, and the accepting runs beside request processing.
+ *
+ * The listening socket must be non-blocking.
+ */
+class Acceptor {
+private:
+    /**
+     * @brief Listening socket, owned by the caller
+     */
+    int listen_fd;
+
+    /**
+     * @brief eventfd signalled when accepted sockets are waiting
+     */
+    int ready_fd = -1;
+
+    /**
+     * @brief eventfd asking the thread to exit
+     */
+    int stop_fd = -1;
+
+    /**
+     * @brief The accepting thread
+     */
+    std::thread thread;
+
+    /**
+     * @brief Guards ready
+     */
+    std::mutex lock;
+
+    /**
+     * @brief Accepted sockets not yet taken
+     */
+    std::vector<int> ready;
+
+    /**
+     * @brief Connections accepted so far
+     */
+    std::atomic<uint64_t> accepted{0};
+
+    /**
+     * @brief Batches handed over so far
+     */
+    std::atomic<uint64_t> batches{0};
+
+    /**
+     * @brief Thread function, accepts until asked to stop
+     */
+    void run();
+
+public:
+    /**
+     * @brief Constructor
+     * @param listening_socket Non-blocking listening socket
+     *
+     * Throws std::runtime_error if the eventfds cannot be created.
+     */
+    explicit Acceptor(int listening_socket);
+
+    /**
+     * @brief Destructor, stops the thread and closes sockets never taken
+     */
+    ~Acceptor();
+
+    Acceptor(const Acceptor&) = delete;
+    Acceptor& operator=(const Acceptor&) = delete;
+
+    /**
+     * @brief Starts the accepting thread
+     */
+    void start();
+
+    /**
+     * @brief Descriptor that becomes readable when sockets are waiting
+     * @return The eventfd, for the event loop's epoll set
+     */
+    int readyFd() const { return ready_fd; }
+
+    /**
+     * @brief Takes every waiting socket
+     * @param sockets Output, replaced by the waiting sockets
+     */
+    void take(std::vector<int>& sockets);
+
+    /**
+     * @brief Connections accepted so far
+     * @return Count
+     */
+    uint64_t acceptedCount() const { return accepted.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Batches handed over so far
+     * @return Count
+     */
+    uint64_t batchCount() const { return batches.load(std::memory_order_relaxed); }
+};
+
+#endif // ACCEPTOR_H
@@ -0,0 +1,192 @@
+/**
+ * @file bench_harness.cpp
+ * @brief Implementation of the microbenchmark harness
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#include "bench_harness.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+/**
+ * @brief Reads harness options from the command line
+ * @param argc Number of command-line arguments
+ * @param argv Array of command-line arguments
+ */
+BenchHarness::BenchHarness(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "--samples" && i + 1 < argc) {
+            samples = std::max(3, std::stoi(argv[++i]));
+        } else if (arg == "--json" && i + 1 < argc) {
+            json_path = argv[++i];
+        } else {
+            throw std::invalid_argument("Usage: " + std::string(argv[0]) +
+                                        " [--filter substring] [--samples n] [--json path]");
+        }
+    }
+    if (!perf.unavailableReason().empty()) {
+        std::cout << "Performance counters: " << perf.unavailableReason() << std::endl;
+    }
+}
+
+/**
+ * @brief Checks whether any case of a name would run
+ * @param name Case name
+ * @return true if the name passes the filter
+ */
+bool BenchHarness::selected(const std::string& name) const {
+    return filter.empty() || name.find(filter) != std::string::npos;
+}
+
+/**
+ * @brief Times one sample
+ * @param bench The case
+ * @param n Iterations
+ * @param counters If not null, receives the sample's counter values
+ * @return Elapsed nanoseconds
+ */
+double BenchHarness::timeSample(const BenchCase& bench, size_t n, PerfSample* counters) {
+    if (bench.setup) {
+        bench.setup();
+    }
+    if (counters) {
+        perf.start();
+    }
+    auto start = std::chrono::steady_clock::now();
+    bench.run(n);
+    auto end = std::chrono::steady_clock::now();
+    if (counters) {
+        *counters = perf.stop();
+    }
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+/**
+ * @brief Median of a list of values
+ * @param values The values, reordered in place
+ * @return The median
+ */
+static double median(std::vector<double>& values) {
+    std::sort(values.begin(), values.end());
+    size_t mid = values.size() / 2;
+    return (values.size() % 2) ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+}
+
+/**
+ * @brief Formats a case's parameters
+ * @param params The parameters
+ * @return "name=value" pairs separated by spaces
+ */
+static std::string formatParams(const std::vector<std::pair<std::string, size_t>>& params) {
+    std::string text;
+    for (const auto& [name, value] : params) {
+        text += (text.empty() ? "" : " ") + name + "=" + std::to_string(value);
+    }
+    return text;
+}
+
+/**
+ * @brief Runs cases and prints one line per case
+ * @param cases The cases
+ */
+void BenchHarness::run(const std::vector<BenchCase>& cases) {
+    for (const auto& bench : cases) {
+        if (!selected(bench.name)) {
+            continue;
+        }
+
+        // Calibrate: double the iterations until a sample is long enough
+        size_t n = 1;
+        while (true) {
+            double elapsed = timeSample(bench, n);
+            if (elapsed >= BENCH_MIN_SAMPLE_NS || (bench.max_iterations && n >= bench.max_iterations)) {
+                break;
+            }
+            n *= 2;
+            if (bench.max_iterations) {
+                n = std::min(n, bench.max_iterations);
+            }
+        }
+
+        timeSample(bench, n); // Warm-up
+        double ops = static_cast<double>(n) * bench.ops_per_iteration;
+        BenchResult result;
+        std::vector<double> per_op;
+        for (size_t s = 0; s < samples; s++) {
+            PerfSample counters;
+            per_op.push_back(timeSample(bench, n, &counters) / ops);
+            result.counters.add(counters);
+        }
+        result.ops = ops * samples;
+
+        result.name = bench.name;
+        result.params = bench.params;
+        result.samples = samples;
+        result.iterations = n;
+        result.min_ns = *std::min_element(per_op.begin(), per_op.end());
+        for (double v : per_op) result.mean_ns += v / per_op.size();
+        for (double v : per_op) result.stddev_ns += (v - result.mean_ns) * (v - result.mean_ns) / per_op.size();
+        result.stddev_ns = std::sqrt(result.stddev_ns);
+        result.median_ns = median(per_op);
+        std::vector<double> deviations;
+        for (double v : per_op) deviations.push_back(std::fabs(v - result.median_ns));
+        result.mad_ns = median(deviations);
+
+        char line[256];
+        std::snprintf(line, sizeof(line), "%-22s %-22s %10.1f ns/op  +-%5.1f%%  min %10.1f  (%zu x %zu)",
+                      result.name.c_str(), formatParams(result.params).c_str(), result.median_ns,
+                      result.median_ns > 0 ? 100 * result.mad_ns / result.median_ns : 0.0,
+                      result.min_ns, result.samples, result.iterations);
+        std::cout << line << std::endl;
+        if (perf.available()) {
+            std::cout << "    " << result.counters.perOp(result.ops) << std::endl;
+        }
+        results.push_back(result);
+    }
+}
+
+/**
+ * @brief Writes the JSON report, if one was requested
+ */
+void BenchHarness::finish() const {
+    if (json_path.empty()) {
+        return;
+    }
+    std::ofstream out(json_path);
+    if (!out) {
+        std::cerr << "Error: cannot write " << json_path << std::endl;
+        return;
+    }
+
+    out << "{\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        out << (i ? "," : "") << "\n    {\"name\": \"" << r.name << "\", \"params\": {";
+        for (size_t p = 0; p < r.params.size(); p++) {
+            out << (p ? ", " : "") << "\"" << r.params[p].first << "\": " << r.params[p].second;
+        }
+        out << "}, \"samples\": " << r.samples << ", \"iterations\": " << r.iterations
+            << ", \"median_ns\": " << r.median_ns << ", \"min_ns\": " << r.min_ns
+            << ", \"mean_ns\": " << r.mean_ns << ", \"stddev_ns\": " << r.stddev_ns
+            << ", \"mad_ns\": " << r.mad_ns << ", \"counters_per_op\": {";
+        bool first = true;
+        for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+            if (r.counters.valid[event]) {
+                out << (first ? "" : ", ") << "\"" << PerfCounters::eventName(event) << "\": "
+                    << r.counters.counts[event] / r.ops;
+                first = false;
+            }
+        }
+        out << "}}";
+    }
+    out << "\n  ]\n}\n";
+}
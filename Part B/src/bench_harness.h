@@ -0,0 +1,171 @@
+/**
+ * @file bench_harness.h
+ * @brief Header file for the microbenchmark harness
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <cstddef>
+#include "perf_counters.h"
+
+/**
+ * @brief Default number of timed samples per case
+ */
+#define BENCH_DEFAULT_SAMPLES 15
+
+/**
+ * @brief Minimum duration of one sample, in nanoseconds
+ */
+#define BENCH_MIN_SAMPLE_NS 5000000
+
+/**
+ * @brief Keeps the compiler from optimizing away a computed value
+ * @param value The value
+ */
+template <typename T>
+inline void benchDoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * @struct BenchCase
+ * @brief One parameterized microbenchmark
+ */
+struct BenchCase {
+    /**
+     * @brief Component and operation, e.g. "table.lookup_hit"
+     */
+    std::string name;
+
+    /**
+     * @brief Parameters the case was built with, e.g. {"keys", 100000}
+     */
+    std::vector<std::pair<std::string, size_t>> params;
+
+    /**
+     * @brief Runs n iterations of the operation
+     */
+    std::function<void(size_t n)> run;
+
+    /**
+     * @brief Called before every sample, untimed; may be empty
+     */
+    std::function<void()> setup;
+
+    /**
+     * @brief Largest n a single sample may use, 0 for no limit
+     */
+    size_t max_iterations = 0;
+
+    /**
+     * @brief Operations performed by one iteration
+     */
+    size_t ops_per_iteration = 1;
+};
+
+/**
+ * @struct BenchResult
+ * @brief Statistics of one case
+ */
+struct BenchResult {
+    std::string name;
+    std::vector<std::pair<std::string, size_t>> params;
+    size_t samples = 0;
+    size_t iterations = 0;       // Per sample
+    double median_ns = 0;        // Per operation
+    double min_ns = 0;
+    double mean_ns = 0;
+    double stddev_ns = 0;
+    double mad_ns = 0;           // Median absolute deviation
+    PerfSample counters;         // Summed over all timed samples
+    double ops = 0;              // Operations over all timed samples
+};
+
+/**
+ * @class BenchHarness
+ * @brief Calibrates, samples and reports microbenchmarks
+ *
+ * Each case is calibrated by doubling its iteration count until one sample
+ * lasts at least BENCH_MIN_SAMPLE_NS, then timed over a fixed number of
+ * samples after one untimed warm-up sample. The median and the median
+ * absolute deviation are reported since, unlike mean and standard
+ * deviation, a few samples disturbed by the scheduler barely move them.
+ * Hardware counters are read around every timed sample, excluding setup,
+ * and reported per operation.
+ */
+class BenchHarness {
+private:
+    /**
+     * @brief Substring a case name must contain to run
+     */
+    std::string filter;
+
+    /**
+     * @brief Timed samples per case
+     */
+    size_t samples = BENCH_DEFAULT_SAMPLES;
+
+    /**
+     * @brief Path of the JSON report, empty for none
+     */
+    std::string json_path;
+
+    /**
+     * @brief Results of every case run so far
+     */
+    std::vector<BenchResult> results;
+
+    /**
+     * @brief Counters read around each timed sample
+     */
+    PerfCounters perf;
+
+    /**
+     * @brief Times one sample
+     * @param bench The case
+     * @param n Iterations
+     * @param counters If not null, receives the sample's counter values
+     * @return Elapsed nanoseconds
+     */
+    double timeSample(const BenchCase& bench, size_t n, PerfSample* counters = nullptr);
+
+public:
+    /**
+     * @brief Reads harness options from the command line
+     * @param argc Number of command-line arguments
+     * @param argv Array of command-line arguments
+     *
+     * Accepts --filter <substring>, --samples <n> and --json <path>.
+     * Throws std::invalid_argument on anything else.
+     */
+    BenchHarness(int argc, char* argv[]);
+
+    /**
+     * @brief Checks whether any case of a name would run
+     * @param name Case name
+     * @return true if the name passes the filter
+     */
+    bool selected(const std::string& name) const;
+
+    /**
+     * @brief Runs cases and prints one line per case
+     * @param cases The cases
+     *
+     * Fixtures may be released once this returns; results are kept.
+     */
+    void run(const std::vector<BenchCase>& cases);
+
+    /**
+     * @brief Writes the JSON report, if one was requested
+     */
+    void finish() const;
+};
+
+#endif // BENCH_HARNESS_H
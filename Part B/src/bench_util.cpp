@@ -0,0 +1,166 @@
+/**
+ * @file bench_util.cpp
+ * @brief Implementation of helpers shared by the benchmark tools
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#include "bench_util.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * @brief Value at a percentile of a sample
+ * @param values The sample, sorted in place
+ * @param p Percentile between 0 and 1
+ * @return The value, 0 for an empty sample
+ */
+double benchPercentile(std::vector<double>& values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))];
+}
+
+/**
+ * @brief Starts a program with its standard output discarded
+ * @param path Path of the program
+ * @param args Program arguments, without the program name
+ * @param workdir_prefix If not empty, the program runs in a new directory /tmp/<prefix>.XXXXXX
+ * @return Child pid, or -1 on failure
+ */
+pid_t benchSpawn(const std::string& path, const std::vector<std::string>& args, const std::string& workdir_prefix) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (!workdir_prefix.empty()) {
+            std::string dir = "/tmp/" + workdir_prefix + ".XXXXXX";
+            if (!mkdtemp(&dir[0]) || chdir(dir.c_str()) != 0) {
+                std::cerr << "Error: cannot create a working directory: " << strerror(errno) << std::endl;
+                _exit(1);
+            }
+        }
+        std::vector<char*> argv = {const_cast<char*>(path.c_str())};
+        for (const std::string& arg : args) {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+        // Keep the children's startup banners out of the report
+        if (!freopen("/dev/null", "w", stdout)) {
+            _exit(1);
+        }
+        execv(path.c_str(), argv.data());
+        std::cerr << "Error: cannot run " << path << ": " << strerror(errno) << std::endl;
+        _exit(1);
+    }
+    return pid;
+}
+
+/**
+ * @brief Opens a TCP connection to a local port, with Nagle's algorithm off
+ * @param port The port
+ * @return Connected socket, or -1 on failure
+ */
+int benchConnect(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    return fd;
+}
+
+/**
+ * @brief Connects to a local port, retrying while the server starts
+ * @param port The port
+ * @return Connected socket, or -1 after five seconds
+ */
+int benchWaitForPort(int port) {
+    for (int attempt = 0; attempt < 500; attempt++) {
+        int fd = benchConnect(port);
+        if (fd >= 0) {
+            return fd;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return -1;
+}
+
+/**
+ * @brief Reads a process's parent and CPU ticks from /proc
+ * @param pid_name The process id as named in /proc
+ * @param ppid Output parent pid
+ * @param ticks Output user plus system ticks
+ * @return true if the process still existed
+ */
+static bool readStat(const std::string& pid_name, long long& ppid, unsigned long long& ticks) {
+    std::ifstream stat("/proc/" + pid_name + "/stat");
+    std::string line;
+    if (!std::getline(stat, line)) {
+        return false;
+    }
+    // Fields after the parenthesised command name: state ppid ... utime(12th) stime(13th)
+    std::istringstream fields(line.substr(line.rfind(')') + 2));
+    std::string skip;
+    fields >> skip >> ppid;
+    for (int i = 0; i < 9; i++) {
+        fields >> skip;
+    }
+    unsigned long long utime = 0, stime = 0;
+    fields >> utime >> stime;
+    ticks = utime + stime;
+    return true;
+}
+
+/**
+ * @brief CPU time used by a process, in clock ticks
+ * @param pid The process
+ * @param children Whether to add the process's direct children
+ * @return User plus system ticks, read from /proc
+ *
+ * The load balancer forks a handler per connection, so its own counters
+ * alone would miss nearly all of its work; children covers those.
+ */
+unsigned long long benchCpuTicks(pid_t pid, bool children) {
+    long long ppid = 0;
+    unsigned long long ticks = 0;
+    if (!children) {
+        return readStat(std::to_string(pid), ppid, ticks) ? ticks : 0;
+    }
+
+    unsigned long long total = 0;
+    DIR* proc = opendir("/proc");
+    if (!proc) {
+        return 0;
+    }
+    while (dirent* entry = readdir(proc)) {
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9') {
+            continue;
+        }
+        if (readStat(entry->d_name, ppid, ticks) && (std::atoll(entry->d_name) == pid || ppid == pid)) {
+            total += ticks;
+        }
+    }
+    closedir(proc);
+    return total;
+}
@@ -0,0 +1,58 @@
+/**
+ * @file bench_util.h
+ * @brief Header file for helpers shared by the benchmark tools
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+/**
+ * @brief Value at a percentile of a sample
+ * @param values The sample, sorted in place
+ * @param p Percentile between 0 and 1
+ * @return The value, 0 for an empty sample
+ */
+double benchPercentile(std::vector<double>& values, double p);
+
+/**
+ * @brief Starts a program with its standard output discarded
+ * @param path Path of the program
+ * @param args Program arguments, without the program name
+ * @param workdir_prefix If not empty, the program runs in a new directory /tmp/<prefix>.XXXXXX
+ * @return Child pid, or -1 on failure
+ *
+ * A fresh working directory keeps a server's snapshot file from touching
+ * one in the current directory.
+ */
+pid_t benchSpawn(const std::string& path, const std::vector<std::string>& args,
+                 const std::string& workdir_prefix = "");
+
+/**
+ * @brief Opens a TCP connection to a local port, with Nagle's algorithm off
+ * @param port The port
+ * @return Connected socket, or -1 on failure
+ */
+int benchConnect(int port);
+
+/**
+ * @brief Connects to a local port, retrying while the server starts
+ * @param port The port
+ * @return Connected socket, or -1 after five seconds
+ */
+int benchWaitForPort(int port);
+
+/**
+ * @brief CPU time used by a process, in clock ticks
+ * @param pid The process
+ * @param children Whether to add the process's direct children
+ * @return User plus system ticks, read from /proc
+ */
+unsigned long long benchCpuTicks(pid_t pid, bool children = false);
+
+#endif // BENCH_UTIL_H
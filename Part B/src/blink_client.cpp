@@ -0,0 +1,317 @@
+/**
+ * @file blink_client.cpp
+ * @brief Implementation of the BlinkDB RESP client library
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#include "blink_client.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+
+/**
+ * @brief Copies a decoded reply out of the receive buffer
+ * @param value The decoded reply
+ * @return An owning copy
+ */
+RespReply RespReply::from(const RespValue& value) {
+    RespReply reply;
+    reply.type = value.type;
+    reply.is_null = value.is_null;
+    reply.str = std::string(value.str);
+    reply.integer = value.integer;
+    reply.elements.reserve(value.elements.size());
+    for (const auto& element : value.elements) {
+        reply.elements.push_back(from(element));
+    }
+    return reply;
+}
+
+/**
+ * @brief Connects to a server and starts the I/O thread
+ * @param host IPv4 address of the server
+ * @param port Port of the server
+ */
+BlinkConnection::BlinkConnection(const std::string& host, int port) {
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) <= 0) {
+        throw std::runtime_error("Invalid server address " + host);
+    }
+
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        throw std::runtime_error("Socket creation failed");
+    }
+    if (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        throw std::runtime_error("Connection to " + host + ":" + std::to_string(port) + " failed");
+    }
+
+    // Pipelined writes are already batched, don't let Nagle delay them further
+    int opt = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+    wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (wake_fd < 0) {
+        close(sock);
+        throw std::runtime_error("Eventfd creation failed");
+    }
+
+    io_thread = std::thread(&BlinkConnection::ioLoop, this);
+}
+
+/**
+ * @brief Destructor
+ * 
+ * Stops the I/O thread and fails commands still waiting for a reply.
+ */
+BlinkConnection::~BlinkConnection() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        closed = true;
+    }
+    wake();
+    io_thread.join();
+    fail("connection closed");
+    close(wake_fd);
+    close(sock);
+}
+
+/**
+ * @brief Wakes the I/O thread
+ */
+void BlinkConnection::wake() {
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+/**
+ * @brief Sends a command and calls back with its reply
+ * @param args Command arguments
+ * @param callback Called on the I/O thread with the reply
+ * 
+ * Only the first command queued since the I/O thread's last write wakes
+ * it up; later ones ride along in the same write.
+ */
+void BlinkConnection::commandAsync(const std::vector<std::string>& args, ReplyCallback callback) {
+    bool need_wake;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (closed) {
+            RespValue error;
+            error.type = RespValue::ERROR;
+            error.str = "ERR connection closed";
+            callback(error);
+            return;
+        }
+        need_wake = outgoing.empty();
+        RespCodec::appendCommand(outgoing, args);
+        callbacks.push_back(std::move(callback));
+        in_flight++;
+    }
+    if (need_wake) {
+        wake();
+    }
+}
+
+/**
+ * @brief Sends a command and returns a future for its reply
+ * @param args Command arguments
+ * @return Future that becomes ready with an owning copy of the reply
+ */
+std::future<RespReply> BlinkConnection::command(const std::vector<std::string>& args) {
+    auto promise = std::make_shared<std::promise<RespReply>>();
+    std::future<RespReply> future = promise->get_future();
+    commandAsync(args, [promise](const RespValue& reply) {
+        promise->set_value(RespReply::from(reply));
+    });
+    return future;
+}
+
+/**
+ * @brief Sends a command and waits for its reply
+ * @param args Command arguments
+ * @return The reply
+ */
+RespReply BlinkConnection::call(const std::vector<std::string>& args) {
+    return command(args).get();
+}
+
+/**
+ * @brief Number of commands waiting for a reply
+ * @return In-flight count
+ */
+size_t BlinkConnection::pending() const {
+    return in_flight.load();
+}
+
+/**
+ * @brief Checks whether the connection can still be used
+ * @return false once the connection has failed
+ */
+bool BlinkConnection::connected() {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    return !closed;
+}
+
+/**
+ * @brief Marks the connection closed and fails every waiting command
+ * @param reason Error message passed to the callbacks
+ */
+void BlinkConnection::fail(const std::string& reason) {
+    std::deque<ReplyCallback> failed;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        closed = true;
+        failed.swap(callbacks);
+        outgoing.clear();
+    }
+
+    std::string message = "ERR " + reason;
+    RespValue error;
+    error.type = RespValue::ERROR;
+    error.str = message;
+    for (auto& callback : failed) {
+        in_flight--;
+        callback(error);
+    }
+}
+
+/**
+ * @brief Writes queued commands and dispatches replies until closed
+ */
+void BlinkConnection::ioLoop() {
+    std::string writing;      // Bytes taken from outgoing, not yet fully sent
+    size_t written = 0;
+    std::string input;        // Received bytes not yet decoded
+    char buffer[65536];
+
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            if (closed) return;
+            if (written == writing.size() && !outgoing.empty()) {
+                // Everything queued since the last write goes out together
+                writing.swap(outgoing);
+                outgoing.clear();
+                written = 0;
+            }
+        }
+
+        pollfd fds[2];
+        fds[0].fd = sock;
+        fds[0].events = POLLIN | (written < writing.size() ? POLLOUT : 0);
+        fds[1].fd = wake_fd;
+        fds[1].events = POLLIN;
+
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            fail("poll failed");
+            return;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            uint64_t count;
+            ssize_t ignored = read(wake_fd, &count, sizeof(count));
+            (void)ignored;
+        }
+
+        if (written < writing.size()) {
+            ssize_t n = send(sock, writing.data() + written, writing.size() - written, MSG_NOSIGNAL);
+            if (n > 0) {
+                written += n;
+            } else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                fail("write failed");
+                return;
+            }
+        }
+
+        if (fds[0].revents & (POLLIN | POLLERR | POLLHUP)) {
+            ssize_t n = recv(sock, buffer, sizeof(buffer), 0);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                fail("connection lost");
+                return;
+            }
+            if (n > 0) {
+                input.append(buffer, n);
+            }
+
+            size_t pos = 0;
+            RespValue reply;
+            ParseResult result;
+            while ((result = RespCodec::decodeReply(input, pos, reply)) == ParseResult::COMPLETE) {
+                ReplyCallback callback;
+                {
+                    std::lock_guard<std::mutex> lock(queue_mutex);
+                    if (callbacks.empty()) break; // Unsolicited reply, nothing to match it with
+                    callback = std::move(callbacks.front());
+                    callbacks.pop_front();
+                }
+                in_flight--;
+                callback(reply);
+            }
+            if (result == ParseResult::INVALID) {
+                fail("protocol error");
+                return;
+            }
+            input.erase(0, pos);
+        }
+    }
+}
+
+/**
+ * @brief Opens the pool's connections
+ * @param host IPv4 address of the server
+ * @param port Port of the server
+ * @param size Number of connections
+ */
+BlinkClientPool::BlinkClientPool(const std::string& host, int port, size_t size) {
+    for (size_t i = 0; i < std::max<size_t>(size, 1); i++) {
+        connections.push_back(std::make_unique<BlinkConnection>(host, port));
+    }
+}
+
+/**
+ * @brief Picks the least loaded connection
+ * @return A connection from the pool
+ */
+BlinkConnection& BlinkClientPool::connection() {
+    BlinkConnection* best = connections[0].get();
+    for (const auto& connection : connections) {
+        if (connection->pending() < best->pending()) {
+            best = connection.get();
+        }
+    }
+    return *best;
+}
+
+/**
+ * @brief Sends a command on the least loaded connection
+ * @param args Command arguments
+ * @param callback Called on the I/O thread with the reply
+ */
+void BlinkClientPool::commandAsync(const std::vector<std::string>& args, ReplyCallback callback) {
+    connection().commandAsync(args, std::move(callback));
+}
+
+/**
+ * @brief Sends a command on the least loaded connection
+ * @param args Command arguments
+ * @return Future that becomes ready with the reply
+ */
+std::future<RespReply> BlinkClientPool::command(const std::vector<std::string>& args) {
+    return connection().command(args);
+}
@@ -0,0 +1,244 @@
+/**
+ * @file blink_client.h
+ * @brief Header file for the BlinkDB RESP client library
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#ifndef BLINK_CLIENT_H
+#define BLINK_CLIENT_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include "resp.h"
+
+/**
+ * @struct RespReply
+ * @brief A reply that owns its data, for use outside of a reply callback
+ */
+struct RespReply {
+    /**
+     * @brief Type of the reply
+     */
+    RespValue::Type type = RespValue::SIMPLE;
+    
+    /**
+     * @brief Whether the reply is a null bulk string or null array
+     */
+    bool is_null = false;
+    
+    /**
+     * @brief Contents of a simple string, error or bulk string
+     */
+    std::string str;
+    
+    /**
+     * @brief Value of an integer reply
+     */
+    long long integer = 0;
+    
+    /**
+     * @brief Elements of an array reply
+     */
+    std::vector<RespReply> elements;
+    
+    /**
+     * @brief Copies a decoded reply out of the receive buffer
+     * @param value The decoded reply
+     * @return An owning copy
+     */
+    static RespReply from(const RespValue& value);
+    
+    /**
+     * @brief Checks whether the reply is an error
+     * @return true for error replies, including connection failures
+     */
+    bool isError() const { return type == RespValue::ERROR; }
+};
+
+/**
+ * @brief Callback receiving a reply
+ *
+ * The reply's strings point into the connection's receive buffer and are
+ * only valid during the call. Callbacks run on the connection's I/O thread
+ * and must not block.
+ */
+using ReplyCallback = std::function<void(const RespValue& reply)>;
+
+/**
+ * @class BlinkConnection
+ * @brief A pipelined, non-blocking connection to a BlinkDB server
+ *
+ * Commands may be issued from any number of threads. They are appended to
+ * one outgoing buffer, and a dedicated I/O thread writes everything queued
+ * since its last write in a single call, so concurrent requests are
+ * pipelined automatically. Replies are decoded in place and matched to
+ * requests in order.
+ *
+ * Out-of-band messages (pub/sub deliveries) would break the request/reply
+ * matching, so connections used for SUBSCRIBE are not supported. CLIENT
+ * TRACKING works, since the server sends invalidations to a separate
+ * subscriber connection given with REDIRECT.
+ */
+class BlinkConnection {
+private:
+    /**
+     * @brief Socket connected to the server
+     */
+    int sock = -1;
+    
+    /**
+     * @brief Eventfd used to wake the I/O thread when commands are queued
+     */
+    int wake_fd = -1;
+    
+    /**
+     * @brief Protects outgoing, callbacks and closed
+     */
+    std::mutex queue_mutex;
+    
+    /**
+     * @brief Encoded commands not yet handed to the I/O thread
+     */
+    std::string outgoing;
+    
+    /**
+     * @brief Callbacks of sent or queued commands, in request order
+     */
+    std::deque<ReplyCallback> callbacks;
+    
+    /**
+     * @brief Set once the connection failed or is shutting down
+     */
+    bool closed = false;
+    
+    /**
+     * @brief Number of commands waiting for a reply
+     */
+    std::atomic<size_t> in_flight{0};
+    
+    /**
+     * @brief Thread running ioLoop()
+     */
+    std::thread io_thread;
+    
+    /**
+     * @brief Writes queued commands and dispatches replies until closed
+     */
+    void ioLoop();
+    
+    /**
+     * @brief Marks the connection closed and fails every waiting command
+     * @param reason Error message passed to the callbacks
+     */
+    void fail(const std::string& reason);
+    
+    /**
+     * @brief Wakes the I/O thread
+     */
+    void wake();
+
+public:
+    /**
+     * @brief Connects to a server and starts the I/O thread
+     * @param host IPv4 address of the server
+     * @param port Port of the server
+     */
+    BlinkConnection(const std::string& host, int port);
+    
+    /**
+     * @brief Destructor
+     * 
+     * Stops the I/O thread and fails commands still waiting for a reply.
+     */
+    ~BlinkConnection();
+    
+    BlinkConnection(const BlinkConnection&) = delete;
+    BlinkConnection& operator=(const BlinkConnection&) = delete;
+    
+    /**
+     * @brief Sends a command and calls back with its reply
+     * @param args Command arguments
+     * @param callback Called on the I/O thread with the reply
+     */
+    void commandAsync(const std::vector<std::string>& args, ReplyCallback callback);
+    
+    /**
+     * @brief Sends a command and returns a future for its reply
+     * @param args Command arguments
+     * @return Future that becomes ready with an owning copy of the reply
+     */
+    std::future<RespReply> command(const std::vector<std::string>& args);
+    
+    /**
+     * @brief Sends a command and waits for its reply
+     * @param args Command arguments
+     * @return The reply
+     */
+    RespReply call(const std::vector<std::string>& args);
+    
+    /**
+     * @brief Number of commands waiting for a reply
+     * @return In-flight count
+     */
+    size_t pending() const;
+    
+    /**
+     * @brief Checks whether the connection can still be used
+     * @return false once the connection has failed
+     */
+    bool connected();
+};
+
+/**
+ * @class BlinkClientPool
+ * @brief A fixed set of connections to one server
+ *
+ * Each command goes to the connection with the fewest replies outstanding,
+ * which spreads load while keeping every connection's pipeline full.
+ */
+class BlinkClientPool {
+private:
+    /**
+     * @brief The pooled connections
+     */
+    std::vector<std::unique_ptr<BlinkConnection>> connections;
+
+public:
+    /**
+     * @brief Opens the pool's connections
+     * @param host IPv4 address of the server
+     * @param port Port of the server
+     * @param size Number of connections
+     */
+    BlinkClientPool(const std::string& host, int port, size_t size);
+    
+    /**
+     * @brief Picks the least loaded connection
+     * @return A connection from the pool
+     */
+    BlinkConnection& connection();
+    
+    /**
+     * @brief Sends a command on the least loaded connection
+     * @param args Command arguments
+     * @param callback Called on the I/O thread with the reply
+     */
+    void commandAsync(const std::vector<std::string>& args, ReplyCallback callback);
+    
+    /**
+     * @brief Sends a command on the least loaded connection
+     * @param args Command arguments
+     * @return Future that becomes ready with the reply
+     */
+    std::future<RespReply> command(const std::vector<std::string>& args);
+};
+
+#endif // BLINK_CLIENT_H
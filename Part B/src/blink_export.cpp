@@ -0,0 +1,508 @@
+/**
+ * @file blink_export.cpp
+ * @brief Parallel, sharded export of BlinkDB data from a snapshot or a live server
+ * @author Madhumita
+ * @date 2025-03-31
+ *
+ * The export tool has two sources:
+ * - a persistence file (flush_data.txt), which is memory-mapped and split
+ *   between reader threads, so the serving process is not involved at all;
+ * - a running blink_server, which is walked with SCAN on one connection
+ *   while worker connections fetch the values with pipelined GETs. SCAN runs
+ *   in the server's bulk lane, so the export does not delay fast commands.
+ *
+ * Live mode is not free for the server it reads: every SCAN and GET is
+ * served by that server's reactor, each GET moves the key to the front of
+ * its LRU, and GETs of keys evicted to disk load them back, pushing out
+ * keys that are actually in use. Export a primary from its snapshot, or
+ * point live mode at a server that takes no production traffic, such as a
+ * copy kept current from the change feed.
+ *
+ * Every key is routed to one of N shard files by hash, and shards can be
+ * gzip-compressed. The TSV output can be fed straight to blink_import.
+ */
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <zlib.h>
+#include "blink_client.h"
+
+/**
+ * @brief Bytes buffered per shard and thread before they are written out
+ */
+#define EXPORT_FLUSH_BYTES (1 << 20)
+
+/**
+ * @brief Keys requested per SCAN call in live mode
+ */
+#define EXPORT_SCAN_COUNT 1000
+
+/**
+ * @brief Maximum number of key batches waiting for a worker in live mode
+ */
+#define EXPORT_QUEUE_DEPTH 64
+
+/**
+ * @enum OutputFormat
+ * @brief Format of the exported records
+ */
+enum class OutputFormat {
+    TSV,
+    RESP
+};
+
+/**
+ * @class ShardWriter
+ * @brief One output file, optionally gzip-compressed, shared by all threads
+ */
+class ShardWriter {
+private:
+    /**
+     * @brief Plain output file, used when not compressing
+     */
+    FILE* plain = nullptr;
+
+    /**
+     * @brief Compressed output file, used when compressing
+     */
+    gzFile compressed = nullptr;
+
+    /**
+     * @brief Path of the file, for error messages
+     */
+    std::string file_path;
+
+    /**
+     * @brief Serialises writes from different threads
+     */
+    std::mutex write_mutex;
+
+public:
+    /**
+     * @brief Opens a shard file
+     * @param path Path of the file
+     * @param gzip Whether to gzip the output
+     */
+    ShardWriter(const std::string& path, bool gzip) : file_path(path) {
+        if (gzip) {
+            compressed = gzopen(path.c_str(), "wb6");
+        } else {
+            plain = fopen(path.c_str(), "w");
+        }
+        if (!plain && !compressed) {
+            throw std::runtime_error("Cannot create " + path);
+        }
+    }
+
+    /**
+     * @brief Destructor
+     *
+     * Closes the file if close() wasn't called, ignoring errors.
+     */
+    ~ShardWriter() {
+        if (compressed) gzclose(compressed);
+        if (plain) fclose(plain);
+    }
+
+    /**
+     * @brief Flushes and closes the file
+     *
+     * A failure here means the shard is truncated, e.g. because the disk is full.
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        bool ok = true;
+        if (compressed) {
+            ok = gzclose(compressed) == Z_OK;
+            compressed = nullptr;
+        }
+        if (plain) {
+            ok = fclose(plain) == 0;
+            plain = nullptr;
+        }
+        if (!ok) {
+            throw std::runtime_error("Cannot finish " + file_path + ": " + strerror(errno));
+        }
+    }
+
+    ShardWriter(const ShardWriter&) = delete;
+    ShardWriter& operator=(const ShardWriter&) = delete;
+
+    /**
+     * @brief Appends a block of encoded records
+     * @param data The bytes to write
+     */
+    void write(const std::string& data) {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        size_t written = compressed ? static_cast<size_t>(std::max(0, gzwrite(compressed, data.data(), data.size())))
+                                    : fwrite(data.data(), 1, data.size(), plain);
+        if (written != data.size()) {
+            throw std::runtime_error("Cannot write " + file_path + ": " + strerror(errno));
+        }
+    }
+};
+
+/**
+ * @class ShardSet
+ * @brief Routes records to shard files through per-thread buffers
+ */
+class ShardSet {
+private:
+    /**
+     * @brief The shard files
+     */
+    std::vector<std::unique_ptr<ShardWriter>> shards;
+
+    /**
+     * @brief Encoding of the records
+     */
+    OutputFormat format;
+
+public:
+    /**
+     * @brief Per-thread buffers, one per shard
+     */
+    using Buffers = std::vector<std::string>;
+
+    /**
+     * @brief Creates the shard files
+     * @param prefix Path prefix of the files
+     * @param count Number of shards
+     * @param gzip Whether to gzip the output
+     * @param output_format Encoding of the records
+     */
+    ShardSet(const std::string& prefix, size_t count, bool gzip, OutputFormat output_format)
+        : format(output_format) {
+        for (size_t i = 0; i < count; i++) {
+            char suffix[32];
+            snprintf(suffix, sizeof(suffix), "-%05zu.%s%s", i,
+                     format == OutputFormat::TSV ? "tsv" : "resp", gzip ? ".gz" : "");
+            shards.push_back(std::make_unique<ShardWriter>(prefix + suffix, gzip));
+        }
+    }
+
+    /**
+     * @brief Creates an empty set of buffers for one thread
+     * @return One buffer per shard
+     */
+    Buffers makeBuffers() const {
+        return Buffers(shards.size());
+    }
+
+    /**
+     * @brief Encodes a record into the buffer of its shard
+     * @param buffers The calling thread's buffers
+     * @param key The key
+     * @param value The value
+     */
+    void add(Buffers& buffers, std::string_view key, std::string_view value) {
+        size_t shard = std::hash<std::string_view>{}(key) % shards.size();
+        std::string& buffer = buffers[shard];
+
+        if (format == OutputFormat::TSV) {
+            buffer.append(key).append(1, '\t').append(value).append(1, '\n');
+        } else {
+            buffer.append("*3\r\n$3\r\nSET\r\n$").append(std::to_string(key.size())).append("\r\n");
+            buffer.append(key).append("\r\n$").append(std::to_string(value.size())).append("\r\n");
+            buffer.append(value).append("\r\n");
+        }
+
+        if (buffer.size() >= EXPORT_FLUSH_BYTES) {
+            shards[shard]->write(buffer);
+            buffer.clear();
+        }
+    }
+
+    /**
+     * @brief Writes out whatever is left in a thread's buffers
+     * @param buffers The calling thread's buffers
+     */
+    void flush(Buffers& buffers) {
+        for (size_t i = 0; i < buffers.size(); i++) {
+            if (!buffers[i].empty()) {
+                shards[i]->write(buffers[i]);
+                buffers[i].clear();
+            }
+        }
+    }
+
+    /**
+     * @brief Closes every shard file, failing if any of them is incomplete
+     */
+    void close() {
+        for (auto& shard : shards) {
+            shard->close();
+        }
+    }
+};
+
+/**
+ * @brief Exports a persistence file using several reader threads
+ * @param path Path of the persistence file
+ * @param shards Destination shards
+ * @param num_threads Number of reader threads
+ * @return Number of records exported
+ */
+static size_t exportSnapshot(const std::string& path, ShardSet& shards, size_t num_threads) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    size_t size = st.st_size;
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Cannot map " + path);
+    }
+    const char* data = static_cast<const char*>(mapping);
+
+    // Chunk boundaries start right after a newline
+    std::vector<size_t> bounds{0};
+    for (size_t i = 1; i < num_threads; i++) {
+        size_t pos = std::max(bounds.back(), size * i / num_threads);
+        const void* newline = (pos < size) ? memchr(data + pos, '\n', size - pos) : nullptr;
+        if (!newline) break;
+        bounds.push_back(static_cast<const char*>(newline) - data + 1);
+    }
+    bounds.push_back(size);
+
+    std::vector<size_t> counts(bounds.size() - 1, 0);
+    std::vector<std::string> errors(bounds.size() - 1);
+    std::vector<std::thread> threads;
+    for (size_t c = 0; c + 1 < bounds.size(); c++) {
+        threads.emplace_back([&, c]() {
+            try {
+                ShardSet::Buffers buffers = shards.makeBuffers();
+                size_t pos = bounds[c];
+                while (pos < bounds[c + 1]) {
+                    const void* newline = memchr(data + pos, '\n', bounds[c + 1] - pos);
+                    size_t end = newline ? static_cast<const char*>(newline) - data : bounds[c + 1];
+                    std::string_view line(data + pos, end - pos);
+                    size_t tab = line.find('\t');
+                    if (tab != std::string_view::npos) {
+                        shards.add(buffers, line.substr(0, tab), line.substr(tab + 1));
+                        counts[c]++;
+                    }
+                    pos = end + 1;
+                }
+                shards.flush(buffers);
+            } catch (const std::exception& e) {
+                errors[c] = e.what();
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    munmap(mapping, size);
+
+    size_t total = 0;
+    for (size_t c = 0; c < counts.size(); c++) {
+        if (!errors[c].empty()) {
+            throw std::runtime_error(errors[c]);
+        }
+        total += counts[c];
+    }
+    return total;
+}
+
+/**
+ * @brief Exports a live server's keys with SCAN and pipelined GETs
+ * @param host IPv4 address of the server
+ * @param port Port of the server
+ * @param shards Destination shards
+ * @param num_threads Number of GET worker connections
+ * @return Number of records exported
+ *
+ * Keys deleted between SCAN and GET are skipped. Like Redis SCAN, a key
+ * that exists for the whole export is returned at least once; keys added
+ * during the export may or may not be included. The first failing
+ * connection stops the scan and the other workers.
+ */
+static size_t exportLive(const std::string& host, int port, ShardSet& shards, size_t num_threads) {
+    std::deque<std::vector<std::string>> queue;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    bool scan_done = false;
+    bool aborted = false;   // A worker failed
+    std::string scan_error;
+
+    std::vector<size_t> counts(num_threads, 0);
+    std::vector<std::string> errors(num_threads);
+    std::vector<std::thread> workers;
+
+    for (size_t w = 0; w < num_threads; w++) {
+        workers.emplace_back([&, w]() {
+            try {
+                BlinkConnection connection(host, port);
+                ShardSet::Buffers buffers = shards.makeBuffers();
+                while (true) {
+                    std::vector<std::string> keys;
+                    {
+                        std::unique_lock<std::mutex> lock(queue_mutex);
+                        queue_cv.wait(lock, [&]() { return !queue.empty() || scan_done || aborted; });
+                        if (queue.empty() || aborted) break;
+                        keys = std::move(queue.front());
+                        queue.pop_front();
+                    }
+                    queue_cv.notify_all();
+
+                    // Issued back to back, the GETs share one pipelined write
+                    std::vector<std::future<RespReply>> replies;
+                    replies.reserve(keys.size());
+                    for (const auto& key : keys) {
+                        replies.push_back(connection.command({"GET", key}));
+                    }
+
+                    for (size_t i = 0; i < keys.size(); i++) {
+                        RespReply reply = replies[i].get();
+                        if (reply.isError()) {
+                            throw std::runtime_error("Server error: " + reply.str);
+                        }
+                        if (!reply.is_null) {
+                            shards.add(buffers, keys[i], reply.str);
+                            counts[w]++;
+                        }
+                    }
+                }
+                shards.flush(buffers);
+            } catch (const std::exception& e) {
+                errors[w] = e.what();
+                {
+                    std::lock_guard<std::mutex> lock(queue_mutex);
+                    aborted = true;
+                }
+                queue_cv.notify_all();
+            }
+        });
+    }
+
+    try {
+        BlinkConnection scanner(host, port);
+        std::string cursor = "0";
+        do {
+            RespReply reply = scanner.call({"SCAN", cursor, "COUNT", std::to_string(EXPORT_SCAN_COUNT)});
+            if (reply.isError() || reply.elements.size() != 2) {
+                throw std::runtime_error("Unexpected SCAN reply: " + reply.str);
+            }
+            cursor = reply.elements[0].str;
+            std::vector<std::string> keys;
+            keys.reserve(reply.elements[1].elements.size());
+            for (auto& key : reply.elements[1].elements) {
+                keys.push_back(std::move(key.str));
+            }
+
+            if (!keys.empty()) {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                queue_cv.wait(lock, [&]() { return queue.size() < EXPORT_QUEUE_DEPTH || aborted; });
+                if (aborted) break;
+                queue.push_back(std::move(keys));
+                queue_cv.notify_all();
+            }
+        } while (cursor != "0");
+    } catch (const std::exception& e) {
+        scan_error = e.what();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        scan_done = true;
+    }
+    queue_cv.notify_all();
+    for (auto& worker : workers) worker.join();
+
+    if (!scan_error.empty()) {
+        throw std::runtime_error(scan_error);
+    }
+    size_t total = 0;
+    for (size_t w = 0; w < num_threads; w++) {
+        if (!errors[w].empty()) {
+            throw std::runtime_error(errors[w]);
+        }
+        total += counts[w];
+    }
+    return total;
+}
+
+/**
+ * @brief Main function for the export tool
+ * @param argc Number of command-line arguments
+ * @param argv Array of command-line arguments
+ * @return Exit code (0 for success, 1 for failure)
+ */
+int main(int argc, char* argv[]) {
+    std::string snapshot;
+    std::string host;
+    int port = 9001;
+    size_t num_shards = 4;
+    size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+    bool gzip = false;
+    OutputFormat format = OutputFormat::TSV;
+    std::string prefix = "export";
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-s" && i + 1 < argc) {
+            snapshot = argv[++i];
+        } else if (arg == "-h" && i + 1 < argc) {
+            host = argv[++i];
+        } else if (arg == "-p" && i + 1 < argc) {
+            port = std::stoi(argv[++i]);
+        } else if (arg == "-n" && i + 1 < argc) {
+            num_shards = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "-t" && i + 1 < argc) {
+            num_threads = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "-z") {
+            gzip = true;
+        } else if (arg == "-F" && i + 1 < argc) {
+            format = (std::string(argv[++i]) == "resp") ? OutputFormat::RESP : OutputFormat::TSV;
+        } else if (arg == "-o" && i + 1 < argc) {
+            prefix = argv[++i];
+        } else {
+            snapshot.clear();
+            host.clear();
+            break;
+        }
+    }
+
+    if (snapshot.empty() == host.empty()) {
+        std::cerr << "Usage: " << argv[0] << " (-s <snapshot> | -h <server_ip> [-p <port>])"
+                  << " [-n shards] [-t threads] [-z] [-F tsv|resp] [-o prefix]" << std::endl;
+        return 1;
+    }
+
+    try {
+        size_t exported;
+        {
+            ShardSet shards(prefix, num_shards, gzip, format);
+            exported = snapshot.empty() ? exportLive(host, port, shards, num_threads)
+                                        : exportSnapshot(snapshot, shards, num_threads);
+            shards.close();
+        }
+        std::cout << "Exported " << exported << " keys into " << num_shards << " shards" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -6,13 +6,48 @@
  */
  
 #include "blink_server.h"
+#include <fstream>
+#include <malloc.h>
+#include <sys/resource.h>
+#include <sys/eventfd.h>
+#include <strings.h>
 
 /**
  * @brief Constructor implementation
  * 
  * Initializes the database and sets up the server socket.
  */
-BlinkServer::BlinkServer() : database(std::make_unique<BlinkDB>()) {
+BlinkServer::BlinkServer(int max_connections, int listen_backlog)
+    : database(std::make_unique<BlinkDB>()), max_clients(max_connections), backlog(listen_backlog),
+      clients(max_connections + FD_HEADROOM) {
+    // Every write, delete or eviction invalidates client-side copies of the key
+    // and is recorded in the change feed once a consumer has used FEED; writes
+    // and deletes also feed big-key tracking. Evictions may come from a restore
+    // on bulk_thread, so sendInvalidations() applies them.
+    database->setKeyEventListener([this](KeyEvent event, const std::string& key, const std::string& value) {
+        if (event == KeyEvent::EVICT) {
+            std::lock_guard<std::mutex> lock(evicted_mutex);
+            evicted_invalidations.push_back(key);
+        } else {
+            tracking.invalidate(key);
+        }
+        feed.append(event, key, value);
+        if (event == KeyEvent::SET) {
+            key_stats.recordWrite(key, value.size());
+        } else if (event == KeyEvent::DEL) {
+            key_stats.recordDelete(key);
+        }
+    });
+    save_done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (save_done_fd < 0) {
+        throw std::runtime_error("Save eventfd creation failed");
+    }
+    bulk_done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (bulk_done_fd < 0) {
+        close(save_done_fd);
+        throw std::runtime_error("Bulk eventfd creation failed");
+    }
+    raiseFileLimit();
     setupServer();
 }
 
@@ -22,7 +57,52 @@ BlinkServer::BlinkServer() : database(std::make_unique<BlinkDB>()) {
  * Closes the server socket.
  */
 BlinkServer::~BlinkServer() {
+    // Stop accepting before the listening socket goes away
+    acceptor.reset();
+    if (save_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(save_mutex);
+            save_stopping = true;
+        }
+        save_cv.notify_one();
+        save_thread.join();
+    }
+    if (bulk_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(bulk_mutex);
+            bulk_stopping = true;
+        }
+        bulk_cv.notify_one();
+        bulk_thread.join();
+    }
+    close(save_done_fd);
+    close(bulk_done_fd);
     close(server_fd);
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+    }
+}
+
+/**
+ * @brief Raises the open file limit to cover max_clients connections
+ * 
+ * Only the soft limit is raised, up to the hard limit; with a lower hard
+ * limit, accepting fails once it is reached.
+ */
+void BlinkServer::raiseFileLimit() {
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+        return;
+    }
+    rlim_t wanted = static_cast<rlim_t>(clients.capacity());
+    if (limit.rlim_cur >= wanted) {
+        return;
+    }
+    limit.rlim_cur = std::min(wanted, limit.rlim_max);
+    if (setrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur < wanted) {
+        std::cerr << "Open file limit is " << limit.rlim_cur << ", fewer than " << max_clients
+                  << " clients can connect" << std::endl;
+    }
 }
 
 /**
@@ -32,8 +112,8 @@ BlinkServer::~BlinkServer() {
  * and starts listening for connections.
  */
 void BlinkServer::setupServer() {
-    // Create socket file descriptor
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    // Create socket file descriptor; non-blocking, so the acceptor can drain it
+    server_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
 
     if (server_fd < 0) {
         throw std::runtime_error("Socket creation failed");
@@ -55,18 +135,37 @@ void BlinkServer::setupServer() {
         throw std::runtime_error("Socket binding failed");
     }
 
-    // Start listening with increased backlog
-    if (listen(server_fd, 1024) < 0) { // Increased backlog to 1024
+    // A long accept queue absorbs connection storms instead of dropping SYNs
+    if (listen(server_fd, backlog) < 0) {
         throw std::runtime_error("Listening failed");
     }
 }
 
+/**
+ * @brief Enables busy-poll mode, for latency at the cost of a CPU
+ * @param cpu CPU to pin the event loop to
+ * @param idle_us Microseconds without events after which the loop blocks again
+ */
+void BlinkServer::setBusyPoll(int cpu, int idle_us) {
+    reactor_cpu = cpu;
+    poller.enable(idle_us);
+}
+
 /**
  * @brief Starts the server
  * 
  * Begins listening for and handling client connections.
  */
 void BlinkServer::start() {
+    Tracer::setThreadName("reactor");
+    // Started before pinning, so the acceptor, save and bulk threads stay off the busy-poll CPU
+    acceptor = std::make_unique<Acceptor>(server_fd);
+    acceptor->start();
+    save_thread = std::thread([this] { runSaveThread(); });
+    bulk_thread = std::thread([this] { runBulkThread(); });
+    if (reactor_cpu >= 0 && !CpuAffinity::pin(reactor_cpu)) {
+        std::cerr << "Cannot pin the event loop to CPU " << reactor_cpu << ", running unpinned" << std::endl;
+    }
     std::cout << "BLINK DB Server started on port " << PORT << std::endl;
     handleClientConnections();
 }
@@ -74,11 +173,12 @@ void BlinkServer::start() {
 /**
  * @brief Handles client connections using epoll
  * 
- * Main event loop that accepts new connections and processes
- * client requests using epoll for efficient I/O multiplexing.
+ * Main event loop that processes client requests using epoll for
+ * efficient I/O multiplexing. New connections arrive from the acceptor
+ * thread in batches.
  */
 void BlinkServer::handleClientConnections() {
-    int epoll_fd = epoll_create1(0);
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
     if (epoll_fd < 0) {
         std::cerr << "Epoll creation failed" << std::endl;
         return;
@@ -86,47 +186,95 @@ void BlinkServer::handleClientConnections() {
 
     epoll_event event;
     event.events = EPOLLIN;
-    event.data.fd = server_fd;
+    event.data.fd = acceptor->readyFd();
 
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &event) < 0) {
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, acceptor->readyFd(), &event) < 0) {
         std::cerr << "Epoll control failed" << std::endl;
         return;
     }
 
-    std::vector<epoll_event> events(MAX_CLIENTS + 1);
+    event.data.fd = save_done_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, save_done_fd, &event) < 0) {
+        std::cerr << "Epoll control failed" << std::endl;
+        return;
+    }
+
+    event.data.fd = bulk_done_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, bulk_done_fd, &event) < 0) {
+        std::cerr << "Epoll control failed" << std::endl;
+        return;
+    }
+
+    std::vector<epoll_event> events(MAX_EVENTS);
 
     while (true) {
-        int num_events = epoll_wait(epoll_fd, events.data(), MAX_CLIENTS + 1, -1);
+        int num_events = poller.wait(epoll_fd, events.data(), MAX_EVENTS, -1);
         if (num_events < 0) {
             std::cerr << "Epoll wait failed" << std::endl;
             continue;
         }
 
         for (int i = 0; i < num_events; i++) {
-            if (events[i].data.fd == server_fd) {
-                // Handle new connection
-                sockaddr_in client_addr;
-                socklen_t client_len = sizeof(client_addr);
-                int client_socket = accept(server_fd, (struct sockaddr*)&client_addr, &client_len);
-
-                if (client_socket < 0) {
-                    std::cerr << "Accept failed" << std::endl;
-                    continue;
-                }
+            if (events[i].data.fd == acceptor->readyFd()) {
+                acceptConnections();
+            } else if (events[i].data.fd == save_done_fd) {
+                finishSave();
+            } else if (events[i].data.fd == bulk_done_fd) {
+                finishBulkJobs();
+            } else {
+                int client_socket = events[i].data.fd;
 
-                // Add to epoll
-                event.events = EPOLLIN;
-                event.data.fd = client_socket;
-                if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_socket, &event) < 0) {
-                    std::cerr << "Epoll control failed" << std::endl;
-                    close(client_socket);
-                    continue;
+                // Socket drained, continue with queued output
+                if (events[i].events & EPOLLOUT) {
+                    ClientState* client = clients.find(client_socket);
+                    if (client) {
+                        flushOutput(client_socket, *client);
+                    }
                 }
-            } else {
+
                 // Handle client data
-                handleClientRead(events[i].data.fd);
+                if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                    handleClientRead(client_socket);
+                }
             }
         }
+
+        // Fast commands of this iteration are done, hand out queued bulk work
+        runBulkLane();
+        sendInvalidations();
+    }
+}
+
+/**
+ * @brief Registers the connections accepted by the acceptor thread
+ * 
+ * The sockets are already non-blocking. Each still needs its own
+ * epoll_ctl, but one wakeup covers a whole batch, and the client slot is
+ * preallocated.
+ */
+void BlinkServer::acceptConnections() {
+    acceptor->take(accepted_sockets);
+
+    epoll_event event;
+    event.events = EPOLLIN;
+    for (int client_socket : accepted_sockets) {
+        if (clients.size() >= static_cast<size_t>(max_clients) ||
+            static_cast<size_t>(client_socket) >= clients.capacity()) {
+            rejected_connections++;
+            close(client_socket);
+            continue;
+        }
+        poller.configureSocket(client_socket);
+
+        event.data.fd = client_socket;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_socket, &event) < 0) {
+            std::cerr << "Epoll control failed" << std::endl;
+            close(client_socket);
+            continue;
+        }
+
+        ClientState* client = clients.open(client_socket, next_client_id++);
+        client_sockets[client->id] = client_socket;
     }
 }
 
@@ -134,95 +282,410 @@ void BlinkServer::handleClientConnections() {
  * @brief Handles a read event from a client
  * @param client_socket The client socket file descriptor
  * 
- * Reads data from the client, processes the command, and sends the response.
+ * Reads data from the client and decodes every complete command in its
+ * input buffer. Fast commands are answered immediately; bulk commands,
+ * GETs that turn out to need a restore, and anything the client sent after
+ * one, are queued for the bulk lane. For tracing, one read and everything
+ * it triggers is one request.
  */
 void BlinkServer::handleClientRead(int client_socket) {
-    char buffer[1024] = {0};
+    TraceRequest request;
+    char buffer[16384];
+    TraceSpan read_span("read");
     int bytes_read = read(client_socket, buffer, sizeof(buffer));
+    read_span.end();
 
+    if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return;
+    }
     if (bytes_read <= 0) {
-        close(client_socket); // Close connection if read fails or client disconnects
+        closeClient(client_socket); // Close connection if read fails or client disconnects
         return;
     }
 
-    std::string raw_input(buffer, bytes_read);
-    std::vector<std::string> command = decodeCommand(raw_input);
+    ClientState* state = clients.find(client_socket);
+    if (!state) {
+        close(client_socket);
+        return;
+    }
+    ClientState& client = *state;
+    client.input.append(buffer, bytes_read);
 
-    if (command.empty()) {
-        std::string error = encodeError("Invalid Command");
-       	write(client_socket, error.c_str(), error.length());
+    std::string responses;
+    size_t pos = 0;
+    bool was_queued = !client.pending.empty();
+
+    while (pos < client.input.size()) {
+        std::vector<std::string> command;
+        TraceSpan parse_span("parse");
+        ParseResult result = RespCodec::decodeCommand(client.input, pos, command);
+        parse_span.end();
+
+        if (result == ParseResult::INCOMPLETE) {
+            break;
+        }
+        if (result == ParseResult::INVALID) {
+            // The stream can't be resynchronised, so drop what is buffered
+            responses += RespCodec::encodeError("Invalid Command");
+            pos = client.input.size();
+            break;
+        }
+
+        if (!client.pending.empty() || classifyCommand(command) == CommandLane::BULK) {
+            client.pending.push_back(std::move(command));
+            continue;
+        }
+        std::string response = handleCommand(client, command);
+        if (response.empty()) {
+            client.pending.push_back(std::move(command));
+        } else {
+            responses += response;
+        }
+    }
+    client.input.erase(0, pos);
+
+    if (client.input.size() > CLIENT_INPUT_LIMIT) {
+        responses += RespCodec::encodeError("Protocol error: request too large");
+        sendResponse(client_socket, responses);
+        closeClient(client_socket);
         return;
     }
 
-    std::string response = handleCommand(command);
-    write(client_socket, response.c_str(), response.length());
+    if (!was_queued && !client.pending.empty()) {
+        bulk_lane.emplace_back(client_socket, client.id);
+    }
+    if (!responses.empty()) {
+        sendResponse(client_socket, responses);
+    }
 }
 
 /**
- * @brief Decodes a RESP-2 command from raw input
- * @param raw_input The raw input string to decode
- * @return Vector of command arguments
+ * @brief Hands the next bulk command of each queued client to its thread
  * 
- * Parses RESP-2 protocol formatted commands into a vector of strings.
+ * Fast commands at the front of a client's queue, left there by a SAVE
+ * that finished, run first. A SAVE goes to save_thread, anything else to
+ * bulk_thread; the client stays out of the lane, its later commands
+ * queued, until the reply.
  */
-std::vector<std::string> BlinkServer::decodeCommand(const std::string& raw_input) {
-    std::vector<std::string> parsed_command;
-    size_t index = 0;
+void BlinkServer::runBulkLane() {
+    while (!bulk_lane.empty()) {
+        auto [client_socket, id] = bulk_lane.front();
+        bulk_lane.pop_front();
 
-    if (raw_input.empty() || raw_input[index] != '*') return parsed_command;
+        ClientState* state = clients.find(client_socket);
+        if (!state || state->id != id || state->pending.empty()) {
+            continue; // Client went away while queued
+        }
 
-    index++;
+        ClientState& client = *state;
+        TraceRequest request;
+        std::string responses = runFastCommands(client);
+        if (!responses.empty()) {
+            sendResponse(client_socket, responses);
+        }
+        if (client.pending.empty()) {
+            continue;
+        }
 
-    size_t next = raw_input.find("\r\n", index);
+        const std::vector<std::string>& next = client.pending.front();
+        if (pubsub.subscriptionCount(id) > 0) {
+            // Refused without touching the database
+            std::string response = handleCommand(client, next);
+            client.pending.pop_front();
+            if (!client.pending.empty()) {
+                bulk_lane.emplace_back(client_socket, id);
+            }
+            sendResponse(client_socket, response);
+            continue;
+        }
+        if (next.size() == 1 && strcasecmp(next[0].c_str(), "SAVE") == 0) {
+            queueSave(client_socket, id);
+            continue;
+        }
 
-    if (next == std::string::npos) return parsed_command;
+        BulkJob job;
+        job.client_socket = client_socket;
+        job.id = id;
+        job.command = std::move(client.pending.front());
+        client.pending.front().clear();
+        {
+            std::lock_guard<std::mutex> lock(bulk_mutex);
+            bulk_jobs.push_back(std::move(job));
+        }
+        bulk_cv.notify_one();
+    }
+}
 
-    int arg_count = std::stoi(raw_input.substr(index, next - index));
+/**
+ * @brief Runs the fast commands at the front of a client's queue
+ * @param client State of the client
+ * @return Their RESP-2 encoded responses
+ * 
+ * Stops at a bulk command, or at a GET that needs a restore.
+ */
+std::string BlinkServer::runFastCommands(ClientState& client) {
+    std::string responses;
+    while (!client.pending.empty() && classifyCommand(client.pending.front()) == CommandLane::FAST) {
+        std::string response = handleCommand(client, client.pending.front());
+        if (response.empty()) {
+            break;
+        }
+        responses += response;
+        client.pending.pop_front();
+    }
+    return responses;
+}
 
-    index = next + 2;
+/**
+ * @brief Queues a response for a client and tries to write it out
+ * @param client_socket The client socket file descriptor
+ * @param response The bytes to send
+ */
+void BlinkServer::sendResponse(int client_socket, std::string response) {
+    ClientState* client = clients.find(client_socket);
+    if (!client) {
+        return;
+    }
+    queueOutput(client_socket, *client, std::make_shared<const std::string>(std::move(response)));
+    flushOutput(client_socket, *client);
+}
 
-    for (int i = 0; i < arg_count; i++) {
-        if (index >= raw_input.size() || raw_input[index] != '$') return parsed_command;
+/**
+ * @brief Appends a shared buffer to a client's output queue
+ * @param client_socket The client socket file descriptor
+ * @param client State of the client
+ * @param data The buffer to send
+ * 
+ * A subscriber that lets more than PUBSUB_OUTPUT_LIMIT bytes pile up is
+ * shut down, so a slow consumer can't grow server memory without bound.
+ * The event loop closes the connection once it sees the hangup.
+ */
+void BlinkServer::queueOutput(int client_socket, ClientState& client, std::shared_ptr<const std::string> data) {
+    if (client.closing || data->empty()) {
+        return;
+    }
 
-        index++; 
-        next = raw_input.find("\r\n", index);
-        if (next == std::string::npos) return parsed_command;
-        int len = std::stoi(raw_input.substr(index, next - index));
-        index = next + 2; 
+    client.output_bytes += data->size();
+    client.output.push_back(std::move(data));
 
-        if (index + len > raw_input.size()) return parsed_command;
-        parsed_command.push_back(raw_input.substr(index, len));
-        index += len + 2;
+    if (client.output_bytes > PUBSUB_OUTPUT_LIMIT && pubsub.subscriptionCount(client.id) > 0) {
+        std::cerr << "Closing slow subscriber " << client.id << std::endl;
+        client.output.clear();
+        client.output_offset = 0;
+        client.output_bytes = 0;
+        client.closing = true;
+        shutdown(client_socket, SHUT_RDWR);
     }
+}
+
+/**
+ * @brief Writes as much of a client's output queue as the socket accepts
+ * @param client_socket The client socket file descriptor
+ * @param client State of the client
+ * 
+ * Queued buffers are gathered into one sendmsg call. The socket is
+ * registered for EPOLLOUT while data remains queued.
+ */
+void BlinkServer::flushOutput(int client_socket, ClientState& client) {
+    while (!client.output.empty()) {
+        iovec iov[MAX_IOVECS];
+        int count = 0;
+        size_t skip = client.output_offset;
+        for (auto it = client.output.begin(); it != client.output.end() && count < MAX_IOVECS; ++it, ++count) {
+            iov[count].iov_base = const_cast<char*>((*it)->data()) + skip;
+            iov[count].iov_len = (*it)->size() - skip;
+            skip = 0;
+        }
+
+        msghdr msg = {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        TraceSpan write_span("write");
+        ssize_t written = sendmsg(client_socket, &msg, MSG_NOSIGNAL);
+        write_span.end();
+
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                // Peer is gone; the read side will see the error and close it
+                client.output.clear();
+                client.output_offset = 0;
+                client.output_bytes = 0;
+            }
+            break;
+        }
 
-    return parsed_command;
+        client.output_bytes -= written;
+        size_t consumed = written;
+        while (consumed > 0) {
+            size_t remaining = client.output.front()->size() - client.output_offset;
+            if (consumed < remaining) {
+                client.output_offset += consumed;
+                break;
+            }
+            consumed -= remaining;
+            client.output.pop_front();
+            client.output_offset = 0;
+        }
+    }
+
+    bool want_write = !client.output.empty();
+    if (want_write != client.want_write) {
+        epoll_event event;
+        event.events = want_write ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+        event.data.fd = client_socket;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client_socket, &event);
+        client.want_write = want_write;
+    }
+}
+
+/**
+ * @brief Closes a client connection and drops its state
+ * @param client_socket The client socket file descriptor
+ */
+void BlinkServer::closeClient(int client_socket) {
+    ClientState* client = clients.find(client_socket);
+    if (client) {
+        tracking.disable(client->id);
+        pubsub.removeClient(client->id);
+        client_sockets.erase(client->id);
+        clients.close(client_socket);
+    }
+    close(client_socket);
+}
+
+/**
+ * @brief Sends queued invalidation messages to tracking clients
+ * 
+ * Each message is a pub/sub message on INVALIDATE_CHANNEL, delivered to
+ * the tracking client's redirect connection, with an array of keys as its
+ * payload, or nil when the client must drop its whole cache. Messages for
+ * a redirect connection that is gone or not subscribed to the channel are
+ * dropped.
+ */
+void BlinkServer::sendInvalidations() {
+    std::vector<std::string> evicted;
+    {
+        std::lock_guard<std::mutex> lock(evicted_mutex);
+        evicted.swap(evicted_invalidations);
+    }
+    for (const std::string& key : evicted) {
+        tracking.invalidate(key);
+    }
+
+    if (!tracking.hasPending()) {
+        return;
+    }
+
+    for (auto& [id, invalidation] : tracking.takePending()) {
+        // Only a subscriber connection expects unrequested messages; any other would take one for a reply
+        uint64_t target = tracking.redirectOf(id);
+        auto it = client_sockets.find(target);
+        if (it == client_sockets.end()) {
+            continue;
+        }
+        std::vector<std::string> channels = pubsub.channelsOf(target);
+        if (std::find(channels.begin(), channels.end(), INVALIDATE_CHANNEL) == channels.end()) {
+            continue;
+        }
+
+        std::string message = "*3\r\n" + RespCodec::encodeBulkString("message") + RespCodec::encodeBulkString(INVALIDATE_CHANNEL);
+        message += invalidation.flush_all ? "*-1\r\n" : RespCodec::encodeArray(invalidation.keys);
+        sendResponse(it->second, message);
+    }
+}
+
+/**
+ * @brief Determines which scheduling lane a command belongs to
+ * @param command Vector of command arguments
+ * @return The lane the command is executed in
+ * 
+ * SCAN, SAVE, MEMORY STATS and MEMORY PREFIXES walk or sample the whole
+ * keyspace and TRACE DUMP renders every trace ring, so those go to the
+ * bulk lane. A GET or MGET of an evicted key gets there too, when its
+ * lookup finds the key evicted.
+ */
+CommandLane BlinkServer::classifyCommand(const std::vector<std::string>& command) {
+    std::string cmd = command[0];
+    std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::toupper);
+
+    if (cmd == "SCAN" || cmd == "SAVE") {
+        return CommandLane::BULK;
+    }
+    if (cmd == "MEMORY" && command.size() >= 2) {
+        std::string sub = command[1];
+        std::transform(sub.begin(), sub.end(), sub.begin(), ::toupper);
+        if (sub == "STATS" || sub == "PREFIXES") {
+            return CommandLane::BULK;
+        }
+    }
+    if (cmd == "TRACE" && command.size() >= 2) {
+        std::string sub = command[1];
+        std::transform(sub.begin(), sub.end(), sub.begin(), ::toupper);
+        if (sub == "DUMP") {
+            return CommandLane::BULK;
+        }
+    }
+    return CommandLane::FAST;
 }
 
 /**
  * @brief Handles a decoded command
  * @param command Vector of command arguments
- * @return RESP-2 encoded response
+ * @return RESP-2 encoded response, or an empty string if the command must
+ *         go to the bulk lane
  * 
  * Routes the command to the appropriate handler based on the command type.
  */
-std::string BlinkServer::handleCommand(const std::vector<std::string>& command) {
+std::string BlinkServer::handleCommand(ClientState& client, const std::vector<std::string>& command) {
     if (command.empty()) {
-        return encodeError("Empty command");
+        return RespCodec::encodeError("Empty command");
     }
+    TraceSpan span("command");
 
     std::string cmd = command[0];
     std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::toupper);
 
+    bool subscription_command = cmd == "SUBSCRIBE" || cmd == "PSUBSCRIBE" ||
+                                cmd == "UNSUBSCRIBE" || cmd == "PUNSUBSCRIBE";
+    if (!subscription_command && cmd != "PING" && pubsub.subscriptionCount(client.id) > 0) {
+        return RespCodec::encodeError("only (P)SUBSCRIBE / (P)UNSUBSCRIBE / PING allowed in this context");
+    }
+
     if (cmd == "SET" && command.size() == 3) {
         return processSet(command);
     } else if (cmd == "GET" && command.size() == 2) {
-        return processGet(command);
+        return processGet(client, command);
+    } else if (cmd == "MGET" && command.size() >= 2) {
+        return processMget(client, command);
     } else if (cmd == "DEL" && command.size() == 2) {
         return processDel(command);
+    } else if (cmd == "SCAN" && (command.size() == 2 || command.size() == 4)) {
+        return processScan(command);
+    } else if (cmd == "CLIENT" && command.size() >= 2) {
+        return processClient(client, command);
+    } else if ((cmd == "SUBSCRIBE" || cmd == "PSUBSCRIBE") && command.size() >= 2) {
+        return processSubscribe(client, command);
+    } else if (cmd == "UNSUBSCRIBE" || cmd == "PUNSUBSCRIBE") {
+        return processUnsubscribe(client, command);
+    } else if (cmd == "PUBLISH" && command.size() == 3) {
+        return processPublish(command);
+    } else if (cmd == "FEED" && command.size() >= 2) {
+        return processFeed(command);
+    } else if (cmd == "MEMORY" && command.size() >= 2) {
+        return processMemory(command);
+    } else if (cmd == "HOTKEYS" || cmd == "BIGKEYS") {
+        return processKeyStats(command, cmd == "BIGKEYS");
+    } else if (cmd == "TRACE" && command.size() >= 2) {
+        return processTrace(command);
+    } else if (cmd == "INFO" && command.size() <= 2) {
+        return processInfo(command);
+    } else if (cmd == "PING" && command.size() == 1) {
+        return RespCodec::encodeSimpleString("PONG");
     } else if (cmd == "CONFIG") {
         return "*0\r\n";
     } else {
-        return encodeError("Unknown command");
+        return RespCodec::encodeError("Unknown command");
     }
 }
 
@@ -236,20 +699,75 @@ std::string BlinkServer::handleCommand(const std::vector<std::string>& command)
 std::string BlinkServer::processSet(const std::vector<std::string>& args) {
     //std::cout << "DEBUG: SET key=" << args[1] << " value=" << args[2] << std::endl;
     database->set(args[1], args[2]);
-    return encodeSimpleString("OK");
+    key_stats.recordAccess(args[1]);
+    return RespCodec::encodeSimpleString("OK");
 }
 
 /**
  * @brief Processes a GET command
  * @param args Command arguments
+ * @return RESP-2 encoded response, or an empty string if the key is evicted
+ * 
+ * Retrieves a value by key from the database. Restoring an evicted key
+ * reads the disk, so that is left to the bulk lane.
+ */
+std::string BlinkServer::processGet(ClientState& client, const std::vector<std::string>& args) {
+    std::string value;
+    if (!database->getIfResident(args[1], value)) {
+        return "";
+    }
+    return finishGet(client, args[1], value);
+}
+
+/**
+ * @brief Records a GET and encodes its reply
+ * @param client State of the client that sent the command
+ * @param key The key that was read
+ * @param value The value, or "NULL" if not found
  * @return RESP-2 encoded response
+ */
+std::string BlinkServer::finishGet(ClientState& client, const std::string& key, const std::string& value) {
+    tracking.recordRead(client.id, key);
+    key_stats.recordAccess(key);
+    //std::cout << "DEBUG: GET key=" << key << " value=" << value << std::endl;
+    TraceSpan span("encode");
+    return (value == "NULL") ? RespCodec::encodeBulkString("") : RespCodec::encodeBulkString(value);
+}
+
+/**
+ * @brief Processes an MGET command
+ * @param args Command arguments
+ * @return RESP-2 encoded response, or an empty string if a key is evicted
  * 
- * Retrieves a value by key from the database.
+ * Retrieves several values with one batched lookup and replies with an
+ * array holding a bulk string, or null, per key. As with GET, restores are
+ * left to the bulk lane.
+ */
+std::string BlinkServer::processMget(ClientState& client, const std::vector<std::string>& args) {
+    std::vector<std::string> keys(args.begin() + 1, args.end());
+    std::vector<std::string> values;
+    if (!database->mgetResident(keys, values).empty()) {
+        return "";
+    }
+    return finishMget(client, keys, values);
+}
+
+/**
+ * @brief Records an MGET and encodes its reply
+ * @param client State of the client that sent the command
+ * @param keys The keys that were read
+ * @param values The values in key order, "NULL" for keys not found
+ * @return RESP-2 encoded response
  */
-std::string BlinkServer::processGet(const std::vector<std::string>& args) {
-    std::string value = database->get(args[1]);
-    //std::cout << "DEBUG: GET key=" << args[1] << " value=" << value << std::endl;
-    return (value == "NULL") ? encodeBulkString("") : encodeBulkString(value);
+std::string BlinkServer::finishMget(ClientState& client, const std::vector<std::string>& keys, const std::vector<std::string>& values) {
+    TraceSpan span("encode");
+    std::string response = "*" + std::to_string(values.size()) + "\r\n";
+    for (size_t i = 0; i < values.size(); i++) {
+        tracking.recordRead(client.id, keys[i]);
+        key_stats.recordAccess(keys[i]);
+        response += (values[i] == "NULL") ? RespCodec::encodeBulkString("") : RespCodec::encodeBulkString(values[i]);
+    }
+    return response;
 }
 
 /**
@@ -261,44 +779,745 @@ std::string BlinkServer::processGet(const std::vector<std::string>& args) {
  */
 std::string BlinkServer::processDel(const std::vector<std::string>& args) {
     bool deleted = database->del(args[1]);
-    return encodeInteger(deleted ? 1 : 0);
+    return RespCodec::encodeInteger(deleted ? 1 : 0);
+}
+
+/**
+ * @brief Processes a SCAN command
+ * @param args Command arguments
+ * @return RESP-2 encoded response
+ * 
+ * Supports SCAN <cursor> [COUNT <n>] and replies with the next cursor and
+ * a batch of keys. The COUNT hint is capped at MAX_SCAN_COUNT so a single
+ * call stays a bounded unit of bulk work.
+ */
+std::string BlinkServer::processScan(const std::vector<std::string>& args) {
+    size_t cursor;
+    size_t count = 10;
+    try {
+        cursor = std::stoull(args[1]);
+        if (args.size() == 4) {
+            std::string option = args[2];
+            std::transform(option.begin(), option.end(), option.begin(), ::toupper);
+            if (option != "COUNT") {
+                return RespCodec::encodeError("syntax error");
+            }
+            count = std::stoull(args[3]);
+        }
+    } catch (const std::exception&) {
+        return RespCodec::encodeError("invalid cursor or count");
+    }
+    count = std::min<size_t>(std::max<size_t>(count, 1), MAX_SCAN_COUNT);
+
+    std::vector<std::string> keys;
+    size_t next_cursor = database->scan(cursor, count, keys);
+
+    std::string response = "*2\r\n" + RespCodec::encodeBulkString(std::to_string(next_cursor));
+    return response + RespCodec::encodeArray(keys);
+}
+
+/**
+ * @brief Heap bytes allocated and free according to malloc
+ * @param allocated Set to bytes in use, including mmapped blocks
+ * @param free Set to bytes held by malloc but not in use
+ */
+static void allocatorBytes(size_t& allocated, size_t& free) {
+    struct mallinfo2 info = mallinfo2();
+    allocated = info.uordblks + info.hblkhd;
+    free = info.fordblks;
 }
 
 /**
- * @brief Encodes a simple string in RESP-2 format
- * @param msg The string to encode
- * @return The RESP-2 encoded simple string
+ * @brief Resident set size of the process
+ * @return RSS in bytes
  */
-std::string BlinkServer::encodeSimpleString(const std::string& msg) {
-    return "+" + msg + "\r\n";
+static size_t residentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
 }
 
 /**
- * @brief Encodes a bulk string in RESP-2 format
- * @param msg The string to encode
- * @return The RESP-2 encoded bulk string
+ * @brief Processes a MEMORY command
+ * @param args Command arguments
+ * @return RESP-2 encoded response
+ * 
+ * Supports:
+ * - MEMORY USAGE <key>: bytes attributable to a resident key, or null
+ * - MEMORY STATS: per-structure breakdown plus allocator figures, as a
+ *   flat array of name and value pairs like Redis
+ * - MEMORY PREFIXES [SAMPLES n] [SEPARATOR c]: samples keys at random and
+ *   estimates, per prefix up to the first separator (':' by default), how
+ *   many keys and bytes it accounts for, largest first
  */
-std::string BlinkServer::encodeBulkString(const std::string& msg) {
-    if (msg.empty()) {
-        return "$-1\r\n";  // Null bulk string
+std::string BlinkServer::processMemory(const std::vector<std::string>& args) {
+    std::string sub = args[1];
+    std::transform(sub.begin(), sub.end(), sub.begin(), ::toupper);
+
+    if (sub == "USAGE" && args.size() == 3) {
+        std::optional<size_t> bytes = database->memoryUsage(args[2]);
+        return bytes ? RespCodec::encodeInteger(*bytes) : RespCodec::encodeBulkString("");
     }
-    return "$" + std::to_string(msg.length()) + "\r\n" + msg + "\r\n";
+
+    if (sub == "STATS" && args.size() == 2) {
+        size_t allocated, free;
+        allocatorBytes(allocated, free);
+        return encodeMemoryStats(database->memoryStats(), allocated, free, residentBytes());
+    }
+
+    if (sub == "PREFIXES" && args.size() % 2 == 0) {
+        size_t samples = DEFAULT_MEMORY_SAMPLES;
+        std::string separator = ":";
+        for (size_t i = 2; i < args.size(); i += 2) {
+            std::string option = args[i];
+            std::transform(option.begin(), option.end(), option.begin(), ::toupper);
+            if (option == "SAMPLES") {
+                try {
+                    samples = std::stoull(args[i + 1]);
+                } catch (const std::exception&) {
+                    return RespCodec::encodeError("invalid sample count");
+                }
+            } else if (option == "SEPARATOR" && !args[i + 1].empty()) {
+                separator = args[i + 1];
+            } else {
+                return RespCodec::encodeError("syntax error");
+            }
+        }
+        samples = std::min<size_t>(std::max<size_t>(samples, 1), MAX_MEMORY_SAMPLES);
+
+        std::vector<std::pair<std::string, size_t>> sampled;
+        size_t total_keys = database->sampleMemory(samples, sampled);
+
+        // prefix -> (sampled keys, sampled bytes)
+        std::unordered_map<std::string, std::pair<size_t, size_t>> groups;
+        for (const auto& [key, bytes] : sampled) {
+            size_t end = key.find(separator);
+            auto& group = groups[end == std::string::npos ? std::string() : key.substr(0, end + separator.size())];
+            group.first++;
+            group.second += bytes;
+        }
+
+        std::vector<std::pair<std::string, std::pair<size_t, size_t>>> sorted(groups.begin(), groups.end());
+        std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+            return a.second.second > b.second.second;
+        });
+
+        // Scale the sample up to the whole keyspace
+        double scale = sampled.empty() ? 0.0 : static_cast<double>(total_keys) / sampled.size();
+        std::string response = "*" + std::to_string(sorted.size()) + "\r\n";
+        for (const auto& [prefix, group] : sorted) {
+            response += "*3\r\n" + RespCodec::encodeBulkString(prefix.empty() ? "(no prefix)" : prefix);
+            response += RespCodec::encodeInteger(static_cast<long long>(group.first * scale + 0.5));
+            response += RespCodec::encodeInteger(static_cast<long long>(group.second * scale + 0.5));
+        }
+        return response;
+    }
+
+    return RespCodec::encodeError("unknown MEMORY subcommand or wrong number of arguments");
+}
+
+/**
+ * @brief Encodes the MEMORY STATS reply
+ * @param stats Figures of the database
+ * @param allocated Heap bytes in use according to malloc
+ * @param free Heap bytes held by malloc but not in use
+ * @param rss Resident set size in bytes
+ * @return RESP-2 encoded response
+ * 
+ * Client, feed and tracking figures are read here, on the event loop that
+ * owns them.
+ */
+std::string BlinkServer::encodeMemoryStats(const MemoryStats& stats, size_t allocated, size_t free, size_t rss) {
+    size_t client_buffers = 0;
+    clients.forEach([&client_buffers](int fd, const ClientState& client) {
+        (void)fd;
+        client_buffers += client.input.capacity() + client.output_bytes;
+    });
+
+    std::vector<std::pair<std::string, size_t>> fields = {
+        {"keys.count", stats.keys},
+        {"table.entries.bytes", stats.table.entry_bytes},
+        {"table.index.bytes", stats.table.index_bytes},
+        {"table.spilled-keys.bytes", stats.table.spilled_key_bytes},
+        {"table.values.bytes", stats.table.value_heap_bytes},
+        {"table.free-entries", stats.table.free_entries},
+        {"evicted-keys.count", stats.evicted_keys},
+        {"evicted-keys.bytes", stats.evicted_bytes},
+        {"inflight-loads", stats.inflight_loads},
+        {"clients.count", clients.size()},
+        {"clients.buffers.bytes", client_buffers},
+        {"feed.bytes", feed.retainedBytes()},
+        {"tracking.entries", tracking.size()},
+        {"tracking.bytes", tracking.memoryBytes()},
+        {"allocator.allocated", allocated},
+        {"allocator.free", free},
+        {"rss.bytes", rss},
+    };
+    std::string response = "*" + std::to_string(fields.size() * 2 + 2) + "\r\n";
+    for (const auto& [name, value] : fields) {
+        response += RespCodec::encodeBulkString(name) + RespCodec::encodeInteger(value);
+    }
+    std::ostringstream ratio;
+    ratio.precision(3);
+    ratio << std::fixed << (allocated ? static_cast<double>(rss) / allocated : 0.0);
+    response += RespCodec::encodeBulkString("fragmentation") + RespCodec::encodeBulkString(ratio.str());
+    return response;
+}
+
+/**
+ * @brief Processes a HOTKEYS or BIGKEYS command
+ * @param args Command arguments
+ * @param big Whether to list big keys rather than hot keys
+ * @return RESP-2 encoded response
+ * 
+ * Supports HOTKEYS [COUNT n] and BIGKEYS [COUNT n]. Replies with an array
+ * of [key, count] pairs, where count is the key's estimated recent number
+ * of accesses for HOTKEYS and its value size in bytes for BIGKEYS.
+ */
+std::string BlinkServer::processKeyStats(const std::vector<std::string>& args, bool big) {
+    if (args.size() != 1 && args.size() != 3) {
+        return RespCodec::encodeError("syntax error");
+    }
+    long long count = KEY_STATS_TOP_K;
+    if (args.size() == 3) {
+        std::string option = args[1];
+        std::transform(option.begin(), option.end(), option.begin(), ::toupper);
+        if (option != "COUNT") {
+            return RespCodec::encodeError("syntax error");
+        }
+        try {
+            count = std::stoll(args[2]);
+        } catch (const std::exception&) {
+            count = 0;
+        }
+        if (count < 1) {
+            return RespCodec::encodeError("invalid count");
+        }
+    }
+
+    std::vector<KeyCount> keys = big ? key_stats.bigKeys(count) : key_stats.hotKeys(count);
+    std::string response = "*" + std::to_string(keys.size()) + "\r\n";
+    for (const auto& entry : keys) {
+        response += "*2\r\n" + RespCodec::encodeBulkString(entry.key) + RespCodec::encodeInteger(entry.count);
+    }
+    return response;
+}
+
+/**
+ * @brief Processes a TRACE command
+ * @param args Command arguments
+ * @return RESP-2 encoded response
+ * 
+ * Supports TRACE ON [every], TRACE OFF, TRACE DUMP and TRACE RESET. ON
+ * samples one request in every (default TRACE_DEFAULT_SAMPLE_EVERY); DUMP
+ * replies with the recorded spans as Chrome trace JSON, to be opened in
+ * chrome://tracing or ui.perfetto.dev.
+ */
+std::string BlinkServer::processTrace(const std::vector<std::string>& args) {
+    std::string sub = args[1];
+    std::transform(sub.begin(), sub.end(), sub.begin(), ::toupper);
+
+    if (sub == "ON" && args.size() <= 3) {
+        long long every = TRACE_DEFAULT_SAMPLE_EVERY;
+        if (args.size() == 3) {
+            try {
+                every = std::stoll(args[2]);
+            } catch (const std::exception&) {
+                every = 0;
+            }
+            if (every < 1 || every > UINT32_MAX) {
+                return RespCodec::encodeError("Invalid sample rate");
+            }
+        }
+        Tracer::setSampleRate(static_cast<uint32_t>(every));
+        return RespCodec::encodeSimpleString("OK");
+    } else if (sub == "OFF" && args.size() == 2) {
+        Tracer::setSampleRate(0);
+        return RespCodec::encodeSimpleString("OK");
+    } else if (sub == "DUMP" && args.size() == 2) {
+        return RespCodec::encodeBulkString(Tracer::dumpJson());
+    } else if (sub == "RESET" && args.size() == 2) {
+        Tracer::clear();
+        return RespCodec::encodeSimpleString("OK");
+    }
+    return RespCodec::encodeError("Unknown TRACE subcommand");
+}
+
+/**
+ * @brief Processes an INFO command
+ * @param args Command arguments
+ * @return RESP-2 encoded response
+ * 
+ * Supports INFO [section] and replies with a bulk string of "field:value"
+ * lines grouped under "# Section" headers, in the format Redis tools parse.
+ */
+std::string BlinkServer::processInfo(const std::vector<std::string>& args) {
+    std::string section = (args.size() == 2) ? args[1] : "all";
+    std::transform(section.begin(), section.end(), section.begin(), ::tolower);
+    bool all = section == "all" || section == "everything" || section == "default";
+
+    std::ostringstream info;
+    if (all || section == "memory") {
+        HugePageStats pages = HugePages::stats();
+        info << "# Memory\r\n"
+             << "huge_pages_mode:" << HugePages::modeName(pages.mode) << "\r\n"
+             << "huge_pages_mapped_bytes:" << pages.mapped_bytes << "\r\n"
+             << "huge_pages_explicit:" << pages.explicit_pages << "\r\n"
+             << "huge_pages_advised:" << pages.advised_pages << "\r\n"
+             << "huge_pages_explicit_fallbacks:" << pages.explicit_fallbacks << "\r\n"
+             << "huge_pages_thp_bytes:" << pages.thp_bytes << "\r\n";
+
+        size_t allocated, free;
+        allocatorBytes(allocated, free);
+        size_t rss = residentBytes();
+        info << "used_memory:" << allocated << "\r\n"
+             << "used_memory_rss:" << rss << "\r\n"
+             << "allocator_free:" << free << "\r\n"
+             << "mem_fragmentation_ratio:" << (allocated ? static_cast<double>(rss) / allocated : 0.0) << "\r\n";
+    }
+    if (all || section == "clients") {
+        info << "# Clients\r\n"
+             << "connected_clients:" << clients.size() << "\r\n"
+             << "max_clients:" << max_clients << "\r\n"
+             << "listen_backlog:" << backlog << "\r\n"
+             << "accepted_connections:" << acceptor->acceptedCount() << "\r\n"
+             << "accept_batches:" << acceptor->batchCount() << "\r\n"
+             << "rejected_connections:" << rejected_connections << "\r\n";
+    }
+    if (all || section == "reactor") {
+        const BusyPollStats& polls = poller.stats();
+        info << "# Reactor\r\n"
+             << "busy_poll:" << (poller.isEnabled() ? 1 : 0) << "\r\n"
+             << "reactor_cpu:" << reactor_cpu << "\r\n"
+             << "busy_poll_idle_us:" << (poller.isEnabled() ? poller.idleUs() : 0) << "\r\n"
+             << "busy_poll_spin_hits:" << polls.spin_hits << "\r\n"
+             << "busy_poll_blocking_waits:" << polls.blocking_waits << "\r\n";
+    }
+    if (all || section == "keystats") {
+        info << "# Keystats\r\n"
+             << "key_accesses:" << key_stats.totalAccesses() << "\r\n"
+             << "key_sample_rate:" << KEY_STATS_SAMPLE_RATE << "\r\n";
+        std::vector<KeyCount> hot = key_stats.hotKeys(10);
+        for (size_t i = 0; i < hot.size(); i++) {
+            info << "hot_key_" << i << ":key=" << hot[i].key << ",accesses=" << hot[i].count << "\r\n";
+        }
+        std::vector<KeyCount> big = key_stats.bigKeys(10);
+        for (size_t i = 0; i < big.size(); i++) {
+            info << "big_key_" << i << ":key=" << big[i].key << ",bytes=" << big[i].count << "\r\n";
+        }
+    }
+    return RespCodec::encodeBulkString(info.str());
+}
+
+/**
+ * @brief Queues a client's SAVE, starting a save unless one is running
+ * @param client_socket The client socket file descriptor
+ * @param id Connection id of the client
+ * 
+ * Writing the whole keyspace can take seconds, so it runs on its own
+ * thread and the reactor keeps serving other clients meanwhile. The SAVE
+ * stays at the front of the client's queue, which holds back its later
+ * commands until the reply.
+ */
+void BlinkServer::queueSave(int client_socket, uint64_t id) {
+    if (save_running) {
+        next_save_waiters.emplace_back(client_socket, id);
+        return;
+    }
+    save_waiters.emplace_back(client_socket, id);
+    startSave();
+}
+
+/**
+ * @brief Asks save_thread for a snapshot
+ */
+void BlinkServer::startSave() {
+    save_running = true;
+    {
+        std::lock_guard<std::mutex> lock(save_mutex);
+        save_requested = true;
+    }
+    save_cv.notify_one();
+}
+
+/**
+ * @brief Body of save_thread: writes a snapshot per request until stopped
+ */
+void BlinkServer::runSaveThread() {
+    Tracer::setThreadName("save");
+    std::unique_lock<std::mutex> lock(save_mutex);
+    while (true) {
+        save_cv.wait(lock, [this] { return save_requested || save_stopping; });
+        if (save_stopping) {
+            return;
+        }
+        save_requested = false;
+        lock.unlock();
+        database->persistToFile();
+        uint64_t one = 1;
+        ssize_t written = write(save_done_fd, &one, sizeof(one));
+        (void)written;
+        lock.lock();
+    }
+}
+
+/**
+ * @brief Answers the clients of a finished save and starts the next one if asked for
+ * 
+ * Each answered client goes back to the bulk lane if more commands are
+ * queued behind its SAVE.
+ */
+void BlinkServer::finishSave() {
+    uint64_t count;
+    ssize_t bytes = read(save_done_fd, &count, sizeof(count));
+    (void)bytes;
+    save_running = false;
+
+    for (auto [client_socket, id] : save_waiters) {
+        ClientState* client = clients.find(client_socket);
+        if (!client || client->id != id || client->pending.empty()) {
+            continue; // Client went away while saving
+        }
+        client->pending.pop_front();
+        if (!client->pending.empty()) {
+            bulk_lane.emplace_back(client_socket, id);
+        }
+        sendResponse(client_socket, RespCodec::encodeSimpleString("OK"));
+    }
+    save_waiters.clear();
+
+    if (!next_save_waiters.empty()) {
+        save_waiters.swap(next_save_waiters);
+        startSave();
+    }
+}
+
+/**
+ * @brief Runs the database part of a bulk command
+ * @param command Vector of command arguments
+ * @return Step that completes the command on the event loop and returns its reply
+ * 
+ * Runs on bulk_thread, so it only touches the database and the tracer,
+ * which have their own locks. Client, tracking and key statistics state
+ * is left to the returned step.
+ */
+std::function<std::string(ClientState&)> BlinkServer::runBulkCommand(const std::vector<std::string>& command) {
+    std::string cmd = command[0];
+    std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::toupper);
+
+    if (cmd == "GET" && command.size() == 2) {
+        std::string value = database->get(command[1]);
+        return [this, key = command[1], value](ClientState& client) {
+            return finishGet(client, key, value);
+        };
+    }
+    if (cmd == "MGET" && command.size() >= 2) {
+        std::vector<std::string> keys(command.begin() + 1, command.end());
+        std::vector<std::string> values = database->mget(keys);
+        return [this, keys, values](ClientState& client) {
+            return finishMget(client, keys, values);
+        };
+    }
+
+    std::string response;
+    if (cmd == "SCAN" && (command.size() == 2 || command.size() == 4)) {
+        response = processScan(command);
+    } else if (cmd == "MEMORY" && command.size() == 2 && strcasecmp(command[1].c_str(), "STATS") == 0) {
+        MemoryStats stats = database->memoryStats();
+        size_t allocated, free;
+        allocatorBytes(allocated, free);
+        size_t rss = residentBytes();
+        return [this, stats, allocated, free, rss](ClientState&) {
+            return encodeMemoryStats(stats, allocated, free, rss);
+        };
+    } else if (cmd == "MEMORY" && command.size() >= 2) {
+        response = processMemory(command);
+    } else if (cmd == "TRACE" && command.size() >= 2) {
+        response = processTrace(command);
+    } else {
+        response = RespCodec::encodeError("Unknown command");
+    }
+    return [response](ClientState&) { return response; };
 }
 
 /**
- * @brief Encodes an integer in RESP-2 format
- * @param value The integer to encode
- * @return The RESP-2 encoded integer
+ * @brief Body of bulk_thread: runs bulk jobs until stopped
+ * 
+ * Jobs run one at a time in the order the event loop handed them out,
+ * which serves the queued clients round-robin.
  */
-std::string BlinkServer::encodeInteger(int value) {
-    return ":" + std::to_string(value) + "\r\n";
+void BlinkServer::runBulkThread() {
+    Tracer::setThreadName("bulk");
+    std::unique_lock<std::mutex> lock(bulk_mutex);
+    while (true) {
+        bulk_cv.wait(lock, [this] { return !bulk_jobs.empty() || bulk_stopping; });
+        if (bulk_stopping) {
+            return;
+        }
+        BulkJob job = std::move(bulk_jobs.front());
+        bulk_jobs.pop_front();
+        lock.unlock();
+        {
+            TraceRequest request;
+            job.finish = runBulkCommand(job.command);
+        }
+        lock.lock();
+        bulk_done.push_back(std::move(job));
+        uint64_t one = 1;
+        ssize_t written = write(bulk_done_fd, &one, sizeof(one));
+        (void)written;
+    }
 }
 
 /**
- * @brief Encodes an error message in RESP-2 format
- * @param msg The error message to encode
- * @return The RESP-2 encoded error message
+ * @brief Answers the bulk commands bulk_thread has finished
+ * 
+ * Each reply also covers the fast commands queued behind the bulk command;
+ * a client with more queued goes back to the bulk lane.
  */
-std::string BlinkServer::encodeError(const std::string& msg) {
-    return "-ERR " + msg + "\r\n";
+void BlinkServer::finishBulkJobs() {
+    uint64_t count;
+    ssize_t bytes = read(bulk_done_fd, &count, sizeof(count));
+    (void)bytes;
+
+    std::vector<BulkJob> done;
+    {
+        std::lock_guard<std::mutex> lock(bulk_mutex);
+        done.swap(bulk_done);
+    }
+
+    for (BulkJob& job : done) {
+        ClientState* state = clients.find(job.client_socket);
+        if (!state || state->id != job.id || state->pending.empty()) {
+            continue; // Client went away while the job ran
+        }
+        ClientState& client = *state;
+        TraceRequest request;
+        client.pending.pop_front();
+        std::string responses = job.finish(client);
+        responses += runFastCommands(client);
+        if (!client.pending.empty()) {
+            bulk_lane.emplace_back(job.client_socket, job.id);
+        }
+        sendResponse(job.client_socket, responses);
+    }
+}
+
+/**
+ * @brief Processes a CLIENT command
+ * @param client State of the client that sent the command
+ * @param args Command arguments
+ * @return RESP-2 encoded response
+ * 
+ * Supports CLIENT ID and CLIENT TRACKING ON REDIRECT <id> [BCAST]
+ * [PREFIX <prefix>]... and CLIENT TRACKING OFF. While tracking is on, the
+ * server sends invalidation messages for keys the client has read (or,
+ * with BCAST, for keys matching its prefixes) to the redirect connection,
+ * which subscribes to INVALIDATE_CHANNEL to receive them, as in Redis
+ * under RESP-2. The tracking connection itself only ever gets replies.
+ */
+std::string BlinkServer::processClient(ClientState& client, const std::vector<std::string>& args) {
+    std::string subcommand = args[1];
+    std::transform(subcommand.begin(), subcommand.end(), subcommand.begin(), ::toupper);
+
+    if (subcommand == "ID" && args.size() == 2) {
+        return RespCodec::encodeInteger(client.id);
+    }
+    if (subcommand != "TRACKING" || args.size() < 3) {
+        return RespCodec::encodeError("Unknown CLIENT subcommand");
+    }
+
+    std::string mode = args[2];
+    std::transform(mode.begin(), mode.end(), mode.begin(), ::toupper);
+    if (mode == "OFF" && args.size() == 3) {
+        tracking.disable(client.id);
+        return RespCodec::encodeSimpleString("OK");
+    }
+    if (mode != "ON") {
+        return RespCodec::encodeError("syntax error");
+    }
+
+    bool bcast = false;
+    uint64_t redirect = 0;
+    std::vector<std::string> prefixes;
+    for (size_t i = 3; i < args.size(); i++) {
+        std::string option = args[i];
+        std::transform(option.begin(), option.end(), option.begin(), ::toupper);
+        if (option == "BCAST") {
+            bcast = true;
+        } else if (option == "PREFIX" && i + 1 < args.size()) {
+            prefixes.push_back(args[++i]);
+        } else if (option == "REDIRECT" && i + 1 < args.size()) {
+            try {
+                redirect = std::stoull(args[++i]);
+            } catch (const std::exception&) {
+                return RespCodec::encodeError("Invalid client ID");
+            }
+        } else {
+            return RespCodec::encodeError("syntax error");
+        }
+    }
+    if (!prefixes.empty() && !bcast) {
+        return RespCodec::encodeError("PREFIX requires BCAST");
+    }
+    // RESP-2 has no push type, so invalidations can only go to a separate subscriber connection
+    if (redirect == 0) {
+        return RespCodec::encodeError("Tracking requires REDIRECT to a connection subscribed to " INVALIDATE_CHANNEL);
+    }
+    if (client_sockets.find(redirect) == client_sockets.end()) {
+        return RespCodec::encodeError("The client ID you want redirect to does not exist");
+    }
+
+    tracking.enable(client.id, redirect, bcast, prefixes);
+    return RespCodec::encodeSimpleString("OK");
+}
+
+/**
+ * @brief Processes a SUBSCRIBE or PSUBSCRIBE command
+ * @param client State of the client that sent the command
+ * @param args Command arguments
+ * @return RESP-2 encoded response
+ * 
+ * Replies with one confirmation per channel or pattern, carrying the
+ * client's total subscription count.
+ */
+std::string BlinkServer::processSubscribe(ClientState& client, const std::vector<std::string>& args) {
+    bool pattern = (args[0][0] == 'p' || args[0][0] == 'P');
+    std::string kind = pattern ? "psubscribe" : "subscribe";
+
+    std::string response;
+    for (size_t i = 1; i < args.size(); i++) {
+        size_t count = pattern ? pubsub.psubscribe(client.id, args[i]) : pubsub.subscribe(client.id, args[i]);
+        response += "*3\r\n" + RespCodec::encodeBulkString(kind) + RespCodec::encodeBulkString(args[i]) + RespCodec::encodeInteger(count);
+    }
+    return response;
+}
+
+/**
+ * @brief Processes an UNSUBSCRIBE or PUNSUBSCRIBE command
+ * @param client State of the client that sent the command
+ * @param args Command arguments
+ * @return RESP-2 encoded response
+ * 
+ * Without arguments the client leaves all of its channels (or patterns).
+ */
+std::string BlinkServer::processUnsubscribe(ClientState& client, const std::vector<std::string>& args) {
+    bool pattern = (args[0][0] == 'p' || args[0][0] == 'P');
+    std::string kind = pattern ? "punsubscribe" : "unsubscribe";
+
+    std::vector<std::string> names(args.begin() + 1, args.end());
+    if (names.empty()) {
+        names = pattern ? pubsub.patternsOf(client.id) : pubsub.channelsOf(client.id);
+    }
+    if (names.empty()) {
+        return "*3\r\n" + RespCodec::encodeBulkString(kind) + "$-1\r\n" + RespCodec::encodeInteger(pubsub.subscriptionCount(client.id));
+    }
+
+    std::string response;
+    for (const auto& name : names) {
+        size_t count = pattern ? pubsub.punsubscribe(client.id, name) : pubsub.unsubscribe(client.id, name);
+        response += "*3\r\n" + RespCodec::encodeBulkString(kind) + RespCodec::encodeBulkString(name) + RespCodec::encodeInteger(count);
+    }
+    return response;
+}
+
+/**
+ * @brief Processes a PUBLISH command
+ * @param args Command arguments
+ * @return RESP-2 encoded response
+ * 
+ * The message is encoded once for the channel's subscribers and once per
+ * matching pattern, and the same buffer is queued to every receiver.
+ * Replies with the number of clients that received the message.
+ */
+std::string BlinkServer::processPublish(const std::vector<std::string>& args) {
+    const std::string& channel = args[1];
+    const std::string& message = args[2];
+    long long receivers = 0;
+
+    pubsub.forEachReceiver(channel, [&](const std::string* pattern, const std::vector<uint64_t>& ids) {
+        auto payload = std::make_shared<const std::string>(pattern
+            ? RespCodec::encodeArray({"pmessage", *pattern, channel, message})
+            : RespCodec::encodeArray({"message", channel, message}));
+
+        for (uint64_t id : ids) {
+            auto socket_it = client_sockets.find(id);
+            if (socket_it == client_sockets.end()) continue;
+            ClientState* client = clients.find(socket_it->second);
+            if (!client) continue;
+
+            queueOutput(socket_it->second, *client, payload);
+            flushOutput(socket_it->second, *client);
+            receivers++;
+        }
+    });
+
+    return RespCodec::encodeInteger(receivers);
+}
+
+/**
+ * @brief Processes a FEED command
+ * @param args Command arguments
+ * @return RESP-2 encoded response
+ * 
+ * FEED INFO replies with the first retained and the next offset.
+ * The first FEED command turns the feed on; until then writes are not
+ * recorded, so consumers start with the resync described below.
+ * FEED READ <offset> [COUNT <n>] replies with the offset to continue from
+ * and up to n events, each an array of offset, type, key and value.
+ * 
+ * An offset past the next one is an error. A consumer whose offset has
+ * left the retention window gets a -TRIMMED error. It resynchronises by noting the next offset from FEED INFO,
+ * copying the keyspace with SCAN and GET, and then reading the feed from
+ * the noted offset; replaying events it already saw is harmless.
+ */
+std::string BlinkServer::processFeed(const std::vector<std::string>& args) {
+    std::string subcommand = args[1];
+    std::transform(subcommand.begin(), subcommand.end(), subcommand.begin(), ::toupper);
+    feed.enable();
+
+    if (subcommand == "INFO" && args.size() == 2) {
+        return "*2\r\n" + RespCodec::encodeInteger(feed.firstOffset()) + RespCodec::encodeInteger(feed.nextOffset());
+    }
+    if (subcommand != "READ" || (args.size() != 3 && args.size() != 5)) {
+        return RespCodec::encodeError("Unknown FEED subcommand");
+    }
+
+    uint64_t offset;
+    size_t count = 100;
+    try {
+        offset = std::stoull(args[2]);
+        if (args.size() == 5) {
+            std::string option = args[3];
+            std::transform(option.begin(), option.end(), option.begin(), ::toupper);
+            if (option != "COUNT") {
+                return RespCodec::encodeError("syntax error");
+            }
+            count = std::stoull(args[4]);
+        }
+    } catch (const std::exception&) {
+        return RespCodec::encodeError("invalid offset or count");
+    }
+    count = std::min<size_t>(std::max<size_t>(count, 1), MAX_FEED_COUNT);
+
+    std::vector<std::shared_ptr<const ChangeEvent>> events;
+    FeedReadResult result = feed.read(offset, count, events);
+    if (result == FeedReadResult::TRIMMED) {
+        return "-TRIMMED offset " + std::to_string(offset) + " is older than the first retained offset " +
+               std::to_string(feed.firstOffset()) + ", resync from a snapshot\r\n";
+    }
+    if (result == FeedReadResult::BEYOND_END) {
+        return RespCodec::encodeError("offset " + std::to_string(offset) + " is beyond the next offset " +
+                                      std::to_string(feed.nextOffset()));
+    }
+
+    static const char* const type_names[] = {"set", "del", "evict"};
+    uint64_t next = events.empty() ? offset : events.back()->offset + 1;
+    std::string response = "*2\r\n" + RespCodec::encodeInteger(next) + "*" + std::to_string(events.size()) + "\r\n";
+    for (const auto& event : events) {
+        response += "*4\r\n" + RespCodec::encodeInteger(event->offset) + RespCodec::encodeBulkString(type_names[static_cast<int>(event->type)]);
+        response += RespCodec::encodeBulkString(event->key) + RespCodec::encodeBulkString(event->value);
+    }
+    return response;
 }
@@ -20,10 +20,231 @@
 #include <poll.h>
 #include <fcntl.h>
 #include <cstring>
+#include <cerrno>
 #include <memory>
 #include <algorithm>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 #include <sys/epoll.h>
+#include <sys/uio.h>
 #include "blinkdb.h"
+#include "resp.h"
+#include "tracking_table.h"
+#include "pubsub.h"
+#include "change_feed.h"
+#include "key_stats.h"
+#include "trace.h"
+#include "busy_poll.h"
+#include "acceptor.h"
+
+/**
+ * @enum CommandLane
+ * @brief Scheduling class of a command in the event loop
+ *
+ * FAST commands are point operations executed as soon as they are parsed.
+ * BULK commands (SCAN, SAVE, MEMORY STATS, GETs that must restore a key
+ * from disk) are queued and handed to a worker thread, so they cannot hold
+ * up the fast lane.
+ */
+enum class CommandLane {
+    FAST,
+    BULK
+};
+
+/**
+ * @struct ClientState
+ * @brief Per-connection state kept by the event loop
+ */
+struct ClientState {
+    /**
+     * @brief Connection id, used to detect reuse of the file descriptor
+     */
+    uint64_t id = 0;
+    
+    /**
+     * @brief Bytes read from the socket that do not yet form a full command
+     */
+    std::string input;
+    
+    /**
+     * @brief Parsed commands waiting behind a queued bulk command
+     *
+     * Replies must go out in request order, so once a bulk command is queued
+     * every later command of the same client waits behind it. While
+     * bulk_thread runs the front command, an empty placeholder holds its
+     * place.
+     */
+    std::deque<std::vector<std::string>> pending;
+    
+    /**
+     * @brief Buffers waiting to be written to the socket
+     *
+     * Buffers are shared, so a message published to many subscribers is
+     * encoded once and queued by reference.
+     */
+    std::deque<std::shared_ptr<const std::string>> output;
+    
+    /**
+     * @brief Bytes of the first output buffer that were already written
+     */
+    size_t output_offset = 0;
+    
+    /**
+     * @brief Total bytes queued in output and not yet written
+     */
+    size_t output_bytes = 0;
+    
+    /**
+     * @brief Whether the socket is registered for EPOLLOUT
+     */
+    bool want_write = false;
+    
+    /**
+     * @brief Whether the connection is being shut down
+     */
+    bool closing = false;
+    
+    /**
+     * @brief Largest input buffer capacity a reset slot keeps for its next connection
+     */
+    static constexpr size_t KEPT_INPUT_CAPACITY = 64 * 1024;
+    
+    /**
+     * @brief Empties the state for the next connection on the same descriptor
+     * 
+     * Buffers keep their capacity, up to KEPT_INPUT_CAPACITY for the input,
+     * so a new connection usually starts without allocating.
+     */
+    void reset() {
+        id = 0;
+        input.clear();
+        if (input.capacity() > KEPT_INPUT_CAPACITY) {
+            input.shrink_to_fit();
+        }
+        pending.clear();
+        output.clear();
+        output_offset = 0;
+        output_bytes = 0;
+        want_write = false;
+        closing = false;
+    }
+};
+
+/**
+ * @struct BulkJob
+ * @brief A bulk command on its way through bulk_thread
+ */
+struct BulkJob {
+    /**
+     * @brief Socket of the client that sent the command
+     */
+    int client_socket = -1;
+    
+    /**
+     * @brief Connection id of the client, to detect reuse of the socket
+     */
+    uint64_t id = 0;
+    
+    /**
+     * @brief The command
+     */
+    std::vector<std::string> command;
+    
+    /**
+     * @brief Set by bulk_thread: completes the command on the event loop
+     */
+    std::function<std::string(ClientState&)> finish;
+};
+
+/**
+ * @class ClientTable
+ * @brief Client states in slots preallocated for every descriptor a client may get
+ *
+ * The kernel hands out the lowest free descriptor, so clients occupy a
+ * dense range and a socket's state can live at its descriptor's index:
+ * lookups are an array access and a connection storm neither allocates
+ * nor rehashes. A slot is in use while its id is non-zero.
+ */
+class ClientTable {
+private:
+    std::vector<ClientState> slots;
+    size_t open_count = 0;
+    
+public:
+    /**
+     * @brief Constructor
+     * @param capacity Number of descriptors covered, from 0
+     */
+    explicit ClientTable(size_t capacity) : slots(capacity) {}
+    
+    /**
+     * @brief Number of descriptors covered
+     * @return Slot count
+     */
+    size_t capacity() const { return slots.size(); }
+    
+    /**
+     * @brief Number of slots in use
+     * @return Connected clients
+     */
+    size_t size() const { return open_count; }
+    
+    /**
+     * @brief State of a connected client
+     * @param fd The client socket
+     * @return The state, or nullptr if no client has this socket
+     */
+    ClientState* find(int fd) {
+        return (fd >= 0 && static_cast<size_t>(fd) < slots.size() && slots[fd].id) ? &slots[fd] : nullptr;
+    }
+    
+    /**
+     * @brief Takes a descriptor's slot for a new connection
+     * @param fd The client socket
+     * @param id Connection id, non-zero
+     * @return The state, or nullptr if the descriptor is beyond the table
+     */
+    ClientState* open(int fd, uint64_t id) {
+        if (fd < 0 || static_cast<size_t>(fd) >= slots.size()) {
+            return nullptr;
+        }
+        if (!slots[fd].id) {
+            open_count++;
+        }
+        slots[fd].reset();
+        slots[fd].id = id;
+        return &slots[fd];
+    }
+    
+    /**
+     * @brief Frees a descriptor's slot
+     * @param fd The client socket
+     */
+    void close(int fd) {
+        ClientState* client = find(fd);
+        if (client) {
+            client->reset();
+            open_count--;
+        }
+    }
+    
+    /**
+     * @brief Calls a function for every connected client
+     * @param visit Called with the socket and the state
+     */
+    template <typename Visitor>
+    void forEach(Visitor visit) const {
+        for (size_t fd = 0; fd < slots.size(); fd++) {
+            if (slots[fd].id) {
+                visit(static_cast<int>(fd), slots[fd]);
+            }
+        }
+    }
+};
 
 /**
  * @class BlinkServer
@@ -42,15 +263,60 @@ private:
     static const int PORT = 9001;
     
     /**
-     * @brief Maximum number of simultaneous client connections
+     * @brief Client table slots beyond max_clients, for the server's own descriptors
      */
-    static const int MAX_CLIENTS = 1500;
+    static constexpr int FD_HEADROOM = 64;
+    
+    /**
+     * @brief Maximum number of events taken from one epoll wait
+     */
+    static constexpr int MAX_EVENTS = 1024;
+    
+    /**
+     * @brief Upper bound on the COUNT hint of a single SCAN call
+     */
+    static constexpr int MAX_SCAN_COUNT = 1000;
+    
+    /**
+     * @brief Default number of keys sampled by MEMORY PREFIXES
+     */
+    static constexpr int DEFAULT_MEMORY_SAMPLES = 1000;
+    
+    /**
+     * @brief Upper bound on the number of keys sampled by MEMORY PREFIXES
+     */
+    static constexpr int MAX_MEMORY_SAMPLES = 100000;
+    
+    /**
+     * @brief Maximum number of buffers passed to a single sendmsg call
+     */
+    static constexpr int MAX_IOVECS = 64;
+    
+    /**
+     * @brief Upper bound on the COUNT of a single FEED READ call
+     */
+    static constexpr int MAX_FEED_COUNT = 1000;
+    
+    /**
+     * @brief Output queue size at which a subscribed client is disconnected
+     */
+    static constexpr size_t PUBSUB_OUTPUT_LIMIT = 32 * 1024 * 1024;
+    
+    /**
+     * @brief Unparsed input at which a client is disconnected, room for one largest bulk string
+     */
+    static constexpr size_t CLIENT_INPUT_LIMIT = RESP_MAX_BULK_LENGTH + 64 * 1024;
     
     /**
      * @brief Socket file descriptor for the server
      */
     int server_fd;
     
+    /**
+     * @brief Epoll instance of the event loop
+     */
+    int epoll_fd = -1;
+    
     /**
      * @brief Server address structure
      */
@@ -60,48 +326,199 @@ private:
      * @brief Database instance for storing key-value pairs
      */
     std::unique_ptr<BlinkDB> database;
-
+    
+    /**
+     * @brief Maximum number of simultaneous client connections
+     */
+    int max_clients;
+    
+    /**
+     * @brief Length of the listening socket's accept queue
+     */
+    int backlog;
+    
+    /**
+     * @brief State of every connected client, indexed by socket
+     */
+    ClientTable clients;
+    
+    /**
+     * @brief Thread accepting connections for the event loop
+     */
+    std::unique_ptr<Acceptor> acceptor;
+    
+    /**
+     * @brief Sockets taken from the acceptor, reused so batches don't allocate
+     */
+    std::vector<int> accepted_sockets;
+    
+    /**
+     * @brief Connections closed at once because max_clients were connected
+     */
+    uint64_t rejected_connections = 0;
+    
+    /**
+     * @brief Clients whose next pending command is a bulk command
+     *
+     * Each entry holds the socket and connection id of the client.
+     */
+    std::deque<std::pair<int, uint64_t>> bulk_lane;
+    
+    /**
+     * @brief Thread running bulk commands off the event loop
+     *
+     * Started before the event loop is pinned, like save_thread.
+     */
+    std::thread bulk_thread;
+    
+    /**
+     * @brief Guards bulk_jobs, bulk_done and bulk_stopping
+     */
+    std::mutex bulk_mutex;
+    
+    /**
+     * @brief Wakes bulk_thread
+     */
+    std::condition_variable bulk_cv;
+    
+    /**
+     * @brief Bulk commands waiting for bulk_thread, oldest first
+     */
+    std::deque<BulkJob> bulk_jobs;
+    
+    /**
+     * @brief Bulk commands bulk_thread has run, waiting to be answered
+     */
+    std::vector<BulkJob> bulk_done;
+    
+    /**
+     * @brief Whether bulk_thread should exit
+     */
+    bool bulk_stopping = false;
+    
+    /**
+     * @brief eventfd signalled by bulk_thread when it adds to bulk_done
+     */
+    int bulk_done_fd = -1;
+    
+    /**
+     * @brief Keys evicted off the event loop, whose invalidation is still due
+     *
+     * A restore on bulk_thread evicts other keys, but the tracking table
+     * belongs to the event loop.
+     */
+    std::vector<std::string> evicted_invalidations;
+    
+    /**
+     * @brief Guards evicted_invalidations
+     */
+    std::mutex evicted_mutex;
+    
+    /**
+     * @brief Thread writing the snapshots SAVE asks for
+     *
+     * Started once, before the event loop is pinned, so it never inherits
+     * the busy-poll CPU.
+     */
+    std::thread save_thread;
+    
+    /**
+     * @brief Guards save_requested and save_stopping
+     */
+    std::mutex save_mutex;
+    
     /**
-     * @brief Encodes a simple string in RESP-2 format
-     * @param msg The string to encode
-     * @return The RESP-2 encoded simple string
+     * @brief Wakes save_thread
      */
-    std::string encodeSimpleString(const std::string& msg);
+    std::condition_variable save_cv;
     
     /**
-     * @brief Encodes a bulk string in RESP-2 format
-     * @param msg The string to encode
-     * @return The RESP-2 encoded bulk string
+     * @brief Whether save_thread should write a snapshot
      */
-    std::string encodeBulkString(const std::string& msg);
+    bool save_requested = false;
     
     /**
-     * @brief Encodes an integer in RESP-2 format
-     * @param value The integer to encode
-     * @return The RESP-2 encoded integer
+     * @brief Whether save_thread should exit
      */
-    std::string encodeInteger(int value);
+    bool save_stopping = false;
     
     /**
-     * @brief Encodes an error message in RESP-2 format
-     * @param msg The error message to encode
-     * @return The RESP-2 encoded error message
+     * @brief Whether a save is running, seen from the event loop
      */
-    std::string encodeError(const std::string& msg);
+    bool save_running = false;
     
     /**
-     * @brief Decodes a RESP-2 command from raw input
-     * @param raw_input The raw input string to decode
-     * @return Vector of command arguments
+     * @brief eventfd signalled by save_thread when the snapshot is written
      */
-    std::vector<std::string> decodeCommand(const std::string& raw_input);
+    int save_done_fd = -1;
+    
+    /**
+     * @brief Clients, as socket and id, whose SAVE the running save answers
+     */
+    std::vector<std::pair<int, uint64_t>> save_waiters;
+    
+    /**
+     * @brief Clients whose SAVE arrived during a save, answered by the next one
+     *
+     * The running save may have passed their latest writes already.
+     */
+    std::vector<std::pair<int, uint64_t>> next_save_waiters;
+    
+    /**
+     * @brief Id assigned to the next accepted connection
+     */
+    uint64_t next_client_id = 1;
+    
+    /**
+     * @brief Socket of every connected client, keyed by connection id
+     */
+    std::unordered_map<uint64_t, int> client_sockets;
+    
+    /**
+     * @brief Keys cached by clients that enabled CLIENT TRACKING
+     */
+    TrackingTable tracking;
+    
+    /**
+     * @brief Channel and pattern subscriptions of all clients
+     */
+    PubSub pubsub;
+    
+    /**
+     * @brief Ordered stream of keyspace changes for mirroring consumers
+     */
+    ChangeFeed feed;
+    
+    /**
+     * @brief Sampled hot-key and big-key statistics
+     */
+    KeyStats key_stats;
+    
+    /**
+     * @brief Waits for events of the event loop, spinning in busy-poll mode
+     */
+    BusyPoller poller;
+    
+    /**
+     * @brief CPU the event loop is pinned to, -1 for none
+     */
+    int reactor_cpu = -1;
+
+    /**
+     * @brief Determines which scheduling lane a command belongs to
+     * @param command Vector of command arguments
+     * @return The lane the command is executed in
+     */
+    CommandLane classifyCommand(const std::vector<std::string>& command);
 
      /**
      * @brief Handles a decoded command
+     * @param client State of the client that sent the command
      * @param command Vector of command arguments
-     * @return RESP-2 encoded response
+     * @return RESP-2 encoded response, or an empty string if the command must
+     *         go to the bulk lane
      */
-    std::string handleCommand(const std::vector<std::string>& command);
+    std::string handleCommand(ClientState& client, const std::vector<std::string>& command);
     
     /**
      * @brief Processes a SET command
@@ -112,10 +529,76 @@ private:
     
     /**
      * @brief Processes a GET command
+     * @param client State of the client that sent the command
+     * @param args Command arguments
+     * @return RESP-2 encoded response, or an empty string if the key is evicted
+     */
+    std::string processGet(ClientState& client, const std::vector<std::string>& args);
+    
+    /**
+     * @brief Records a GET and encodes its reply
+     * @param client State of the client that sent the command
+     * @param key The key that was read
+     * @param value The value, or "NULL" if not found
+     * @return RESP-2 encoded response
+     */
+    std::string finishGet(ClientState& client, const std::string& key, const std::string& value);
+    
+    /**
+     * @brief Processes an MGET command
+     * @param client State of the client that sent the command
+     * @param args Command arguments
+     * @return RESP-2 encoded response, or an empty string if a key is evicted
+     */
+    std::string processMget(ClientState& client, const std::vector<std::string>& args);
+    
+    /**
+     * @brief Records an MGET and encodes its reply
+     * @param client State of the client that sent the command
+     * @param keys The keys that were read
+     * @param values The values in key order, "NULL" for keys not found
+     * @return RESP-2 encoded response
+     */
+    std::string finishMget(ClientState& client, const std::vector<std::string>& keys, const std::vector<std::string>& values);
+    
+    /**
+     * @brief Processes an INFO command
+     * @param args Command arguments
+     * @return RESP-2 encoded response
+     */
+    std::string processInfo(const std::vector<std::string>& args);
+    
+    /**
+     * @brief Processes a MEMORY command
+     * @param args Command arguments
+     * @return RESP-2 encoded response
+     */
+    std::string processMemory(const std::vector<std::string>& args);
+    
+    /**
+     * @brief Encodes the MEMORY STATS reply
+     * @param stats Figures of the database
+     * @param allocated Heap bytes in use according to malloc
+     * @param free Heap bytes held by malloc but not in use
+     * @param rss Resident set size in bytes
+     * @return RESP-2 encoded response
+     */
+    std::string encodeMemoryStats(const MemoryStats& stats, size_t allocated, size_t free, size_t rss);
+    
+    /**
+     * @brief Processes a HOTKEYS or BIGKEYS command
      * @param args Command arguments
+     * @param big Whether to list big keys rather than hot keys
      * @return RESP-2 encoded response
      */
-    std::string processGet(const std::vector<std::string>& args);
+    std::string processKeyStats(const std::vector<std::string>& args, bool big);
+    
+    /**
+     * @brief Processes a TRACE command
+     * @param args Command arguments
+     * @return RESP-2 encoded response
+     */
+    std::string processTrace(const std::vector<std::string>& args);
     
     /**
      * @brief Processes a DEL command
@@ -123,6 +606,97 @@ private:
      * @return RESP-2 encoded response
      */
     std::string processDel(const std::vector<std::string>& args);
+    
+    /**
+     * @brief Processes a SCAN command
+     * @param args Command arguments
+     * @return RESP-2 encoded response
+     */
+    std::string processScan(const std::vector<std::string>& args);
+    
+    /**
+     * @brief Queues a client's SAVE, starting a save unless one is running
+     * @param client_socket The client socket file descriptor
+     * @param id Connection id of the client
+     */
+    void queueSave(int client_socket, uint64_t id);
+    
+    /**
+     * @brief Asks save_thread for a snapshot
+     */
+    void startSave();
+    
+    /**
+     * @brief Body of save_thread: writes a snapshot per request until stopped
+     */
+    void runSaveThread();
+    
+    /**
+     * @brief Answers the clients of a finished save and starts the next one if asked for
+     */
+    void finishSave();
+    
+    /**
+     * @brief Runs the database part of a bulk command
+     * @param command Vector of command arguments
+     * @return Step that completes the command on the event loop and returns its reply
+     */
+    std::function<std::string(ClientState&)> runBulkCommand(const std::vector<std::string>& command);
+    
+    /**
+     * @brief Body of bulk_thread: runs bulk jobs until stopped
+     */
+    void runBulkThread();
+    
+    /**
+     * @brief Answers the bulk commands bulk_thread has finished
+     */
+    void finishBulkJobs();
+    
+    /**
+     * @brief Runs the fast commands at the front of a client's queue
+     * @param client State of the client
+     * @return Their RESP-2 encoded responses
+     */
+    std::string runFastCommands(ClientState& client);
+    
+    /**
+     * @brief Processes a CLIENT command
+     * @param client State of the client that sent the command
+     * @param args Command arguments
+     * @return RESP-2 encoded response
+     */
+    std::string processClient(ClientState& client, const std::vector<std::string>& args);
+    
+    /**
+     * @brief Processes a SUBSCRIBE or PSUBSCRIBE command
+     * @param client State of the client that sent the command
+     * @param args Command arguments
+     * @return RESP-2 encoded response
+     */
+    std::string processSubscribe(ClientState& client, const std::vector<std::string>& args);
+    
+    /**
+     * @brief Processes an UNSUBSCRIBE or PUNSUBSCRIBE command
+     * @param client State of the client that sent the command
+     * @param args Command arguments
+     * @return RESP-2 encoded response
+     */
+    std::string processUnsubscribe(ClientState& client, const std::vector<std::string>& args);
+    
+    /**
+     * @brief Processes a PUBLISH command
+     * @param args Command arguments
+     * @return RESP-2 encoded response
+     */
+    std::string processPublish(const std::vector<std::string>& args);
+    
+    /**
+     * @brief Processes a FEED command
+     * @param args Command arguments
+     * @return RESP-2 encoded response
+     */
+    std::string processFeed(const std::vector<std::string>& args);
 
     /**
      * @brief Sets up the server socket
@@ -140,6 +714,18 @@ private:
      */
     void handleClientConnections();
     
+    /**
+     * @brief Registers the connections accepted by the acceptor thread
+     * 
+     * Connections beyond max_clients are closed right away.
+     */
+    void acceptConnections();
+    
+    /**
+     * @brief Raises the open file limit to cover max_clients connections
+     */
+    void raiseFileLimit();
+    
     /**
      * @brief Handles a read event from a client
      * @param client_socket The client socket file descriptor
@@ -147,14 +733,68 @@ private:
      * Reads data from the client, processes the command, and sends the response.
      */
     void handleClientRead(int client_socket);
+    
+    /**
+     * @brief Hands the next bulk command of each queued client to its thread
+     */
+    void runBulkLane();
+    
+    /**
+     * @brief Queues a response for a client and tries to write it out
+     * @param client_socket The client socket file descriptor
+     * @param response The bytes to send
+     */
+    void sendResponse(int client_socket, std::string response);
+    
+    /**
+     * @brief Appends a shared buffer to a client's output queue
+     * @param client_socket The client socket file descriptor
+     * @param client State of the client
+     * @param data The buffer to send
+     */
+    void queueOutput(int client_socket, ClientState& client, std::shared_ptr<const std::string> data);
+    
+    /**
+     * @brief Writes as much of a client's output queue as the socket accepts
+     * @param client_socket The client socket file descriptor
+     * @param client State of the client
+     * 
+     * Registers the socket for EPOLLOUT while data remains queued.
+     */
+    void flushOutput(int client_socket, ClientState& client);
+    
+    /**
+     * @brief Closes a client connection and drops its state
+     * @param client_socket The client socket file descriptor
+     */
+    void closeClient(int client_socket);
+    
+    /**
+     * @brief Sends queued invalidation messages to tracking clients
+     */
+    void sendInvalidations();
 
 public:
+    /**
+     * @brief Default maximum number of simultaneous client connections
+     */
+    static constexpr int DEFAULT_MAX_CLIENTS = 10000;
+    
+    /**
+     * @brief Default length of the listening socket's accept queue
+     * 
+     * The kernel caps it at net.core.somaxconn.
+     */
+    static constexpr int DEFAULT_BACKLOG = 4096;
+    
     /**
      * @brief Constructor
+     * @param max_connections Maximum number of simultaneous client connections
+     * @param listen_backlog Length of the listening socket's accept queue
      * 
      * Initializes the database and sets up the server socket.
      */
-    BlinkServer();
+    explicit BlinkServer(int max_connections = DEFAULT_MAX_CLIENTS, int listen_backlog = DEFAULT_BACKLOG);
     
     /**
      * @brief Destructor
@@ -163,6 +803,16 @@ public:
      */
     ~BlinkServer();
     
+    /**
+     * @brief Enables busy-poll mode, for latency at the cost of a CPU
+     * @param cpu CPU to pin the event loop to
+     * @param idle_us Microseconds without events after which the loop blocks again
+     * 
+     * Must be called before start(). Background threads should already have
+     * been kept off the CPU with CpuAffinity::keepOff() before construction.
+     */
+    void setBusyPoll(int cpu, int idle_us);
+    
     /**
      * @brief Starts the server
      * 
@@ -9,7 +9,6 @@
 #define BLINKDB_H
 
 #include <unordered_map>
-#include <list>
 #include <string>
 #include <fstream>
 #include <mutex>
@@ -20,12 +19,68 @@
 #include <future>
 #include <exception>
 #include <cstdio>
+#include <vector>
+#include <functional>
+#include <optional>
+#include <atomic>
+#include <condition_variable>
+#include "key_table.h"
 
 #define VALUE_SIZE 256
 #define MAX_CAPACITY 10000
 #define FLUSH_FILE "flush_data.txt"
 #define COMPACTION_THRESHOLD 1000
 
+/**
+ * @enum KeyEvent
+ * @brief Kinds of keyspace changes reported to a key event listener
+ */
+enum class KeyEvent {
+    SET,
+    DEL,
+    EVICT
+};
+
+/**
+ * @brief Callback invoked after a key is written, deleted or evicted
+ *
+ * The value is only set for SET events. The listener runs on the thread
+ * that made the change while the database lock is held, so it must not
+ * call back into BlinkDB.
+ */
+using KeyEventListener = std::function<void(KeyEvent event, const std::string& key, const std::string& value)>;
+
+/**
+ * @struct MemoryStats
+ * @brief Memory used by a BlinkDB instance, split by structure
+ */
+struct MemoryStats {
+    /**
+     * @brief Number of resident keys
+     */
+    size_t keys = 0;
+    
+    /**
+     * @brief Breakdown of the resident key table
+     */
+    KeyTableMemory table;
+    
+    /**
+     * @brief Number of keys evicted to disk
+     */
+    size_t evicted_keys = 0;
+    
+    /**
+     * @brief Estimated bytes of the evicted key set: buckets, nodes and key heap allocations
+     */
+    size_t evicted_bytes = 0;
+    
+    /**
+     * @brief Disk loads currently in progress
+     */
+    size_t inflight_loads = 0;
+};
+
 /**
  * @class BlinkDB
  * @brief An in-memory key-value database with LRU caching and disk persistence
@@ -37,24 +92,27 @@
 class BlinkDB {
 private:
     /**
-     * @brief Main storage for key-value pairs
+     * @brief Resident key-value pairs, in LRU order
      */
-    std::unordered_map<std::string, std::string> store;
+    KeyTable table;
     
     /**
-     * @brief List maintaining LRU order of keys
+     * @brief Set of keys that have been evicted from memory but exist on disk
      */
-    std::list<std::string> lru_keys;
+    std::unordered_map<std::string, bool> evicted_keys;
     
     /**
-     * @brief Map for quick access to keys' positions in the LRU list
+     * @brief Disk loads in progress for evicted keys
+     *
+     * Concurrent misses on the same evicted key wait on the one load that is
+     * already running instead of each scanning the persistence file.
      */
-    std::unordered_map<std::string, std::list<std::string>::iterator> lru_map;
+    std::unordered_map<std::string, std::shared_future<std::optional<std::string>>> inflight_loads;
     
     /**
-     * @brief Set of keys that have been evicted from memory but exist on disk
+     * @brief Number of persistence file scans done to restore evicted keys
      */
-    std::unordered_map<std::string, bool> evicted_keys;
+    std::atomic<size_t> disk_reads{0};
     
     /**
      * @brief Mutex for thread-safe access to the database
@@ -64,47 +122,101 @@ private:
     /**
      * @brief Maximum number of items to keep in memory
      */
-    const size_t max_cache_size = MAX_CAPACITY;
+    const size_t max_cache_size;
     
     /**
      * @brief Path to the persistence file
      */
-    const std::string persistence_file = FLUSH_FILE;
+    const std::string persistence_file;
+    
+    /**
+     * @brief Serializes writers of the persistence file
+     */
+    std::mutex persist_mutex;
+    
+    /**
+     * @brief Background thread running flushToDiskPeriodically()
+     */
+    std::thread flush_thread;
+    
+    /**
+     * @brief Guards stopping, waited on by the flush thread between flushes
+     */
+    std::mutex flush_mutex;
+    
+    /**
+     * @brief Wakes the flush thread early when the database is destroyed
+     */
+    std::condition_variable flush_cv;
+    
+    /**
+     * @brief Set by the destructor to end the flush thread
+     */
+    bool stopping = false;
     
     /**
      * @brief Flag indicating whether data has been modified since last flush
      */
     bool dirty = false;
     
+    /**
+     * @brief Listener notified of keyspace changes, may be empty
+     */
+    KeyEventListener key_event_listener;
+    
+    /**
+     * @brief Notifies the key event listener, if one is set
+     * @param event The kind of change
+     * @param key The affected key
+     * @param value The new value for SET events
+     */
+    void notifyKeyEvent(KeyEvent event, const std::string& key, const std::string& value = std::string());
+    
     /**
      * @brief Loads data from persistence file into memory
      */
     void loadFromFile();
     
     /**
-     * @brief Updates the LRU status of a key
-     * @param key The key to update in the LRU cache
+     * @brief Evicts least recently used keys until the cache is within its capacity
+     */
+    void evictIfNeeded();
+    
+    /**
+     * @brief Sets a key-value pair, with the database lock already held
+     * @param key The key to set
+     * @param value The value to associate with the key
+     */
+    void setLocked(const std::string& key, const std::string& value);
+    
+    /**
+     * @brief Deletes a key, with the database lock already held
+     * @param key The key to delete
+     * @return true if the key was found and deleted, false otherwise
      */
-    void updateLRU(const std::string& key);
+    bool delLocked(const std::string& key);
     
     /**
-     * @brief Restores an evicted key from disk
+     * @brief Reads the value of an evicted key from disk
      * @param key The key to restore
+     * @return The value, or nothing if the key is not in the persistence file
      */
-    void restoreFromDisk(const std::string& key);
+    std::optional<std::string> restoreFromDisk(const std::string& key);
 
 public:
     /**
      * @brief Constructor
+     * @param capacity Maximum number of keys kept in memory
+     * @param file Path to the persistence file
      * 
      * Initializes the database and starts the background flush thread
      */
-    BlinkDB();
+    explicit BlinkDB(size_t capacity = MAX_CAPACITY, const std::string& file = FLUSH_FILE);
     
     /**
      * @brief Destructor
      * 
-     * Ensures any pending changes are persisted to disk
+     * Stops the flush thread and ensures any pending changes are persisted to disk
      */
     ~BlinkDB();
     
@@ -122,6 +234,14 @@ public:
      */
     std::string get(const std::string& key);
     
+    /**
+     * @brief Retrieves a value unless that means restoring it from disk
+     * @param key The key to look up
+     * @param value Output: the value, or "NULL" if not found
+     * @return false if the key is evicted, leaving value untouched
+     */
+    bool getIfResident(const std::string& key, std::string& value);
+    
     /**
      * @brief Deletes a key-value pair from the database
      * @param key The key to delete
@@ -129,8 +249,82 @@ public:
      */
     bool del(const std::string& key);
     
+    /**
+     * @brief Sets several key-value pairs under a single lock acquisition
+     * @param pairs The key-value pairs, applied in order
+     */
+    void mset(const std::vector<std::pair<std::string, std::string>>& pairs);
+    
+    /**
+     * @brief Retrieves several values
+     * @param keys The keys to look up
+     * @return The values in key order, "NULL" for keys that are not found
+     */
+    std::vector<std::string> mget(const std::vector<std::string>& keys);
+    
+    /**
+     * @brief Retrieves the resident ones of several values
+     * @param keys The keys to look up
+     * @param values Output, resized to the key count: values in key order, "NULL" for keys that are not found
+     * @return Indices of the evicted keys, whose values are left empty
+     */
+    std::vector<size_t> mgetResident(const std::vector<std::string>& keys, std::vector<std::string>& values);
+    
+    /**
+     * @brief Deletes several keys under a single lock acquisition
+     * @param keys The keys to delete
+     * @return Per key, whether it was found and deleted
+     */
+    std::vector<bool> mdel(const std::vector<std::string>& keys);
+    
+    /**
+     * @brief Registers the listener notified of keyspace changes
+     * @param listener Callback to invoke, or an empty function to remove it
+     */
+    void setKeyEventListener(KeyEventListener listener);
+    
+    /**
+     * @brief Incrementally iterates over the keys held in memory
+     * @param cursor Position returned by the previous call, 0 to start
+     * @param count Approximate number of keys to return
+     * @param keys Output vector the keys are appended to
+     * @return Cursor for the next call, 0 once the iteration is complete
+     */
+    size_t scan(size_t cursor, size_t count, std::vector<std::string>& keys) const;
+    
+    /**
+     * @brief Bytes attributable to a resident key
+     * @param key The key
+     * @return Its entry, index share and heap allocations, or nothing if the key is not resident
+     */
+    std::optional<size_t> memoryUsage(const std::string& key) const;
+    
+    /**
+     * @brief Memory used by the database, split by structure
+     * @return Current breakdown
+     */
+    MemoryStats memoryStats() const;
+    
+    /**
+     * @brief Samples resident keys with their memory use
+     * @param samples Number of keys to sample, with replacement
+     * @param out Output vector the key and byte count pairs are appended to
+     * @return Number of resident keys the sample was drawn from
+     */
+    size_t sampleMemory(size_t samples, std::vector<std::pair<std::string, size_t>>& out) const;
+    
+    /**
+     * @brief Number of times an evicted key was read back from disk
+     * @return Count of persistence file scans
+     */
+    size_t diskReads() const;
+    
     /**
      * @brief Writes all in-memory data to disk
+     *
+     * The data is copied under the read lock and written without it, so
+     * writers and LRU updates wait for the copy only, not for the disk.
+     * The file is replaced in one rename, never truncated in place.
      */
     void persistToFile();
     
@@ -0,0 +1,128 @@
+/**
+ * @file busy_poll.cpp
+ * @brief Implementation of CPU pinning and the busy-polling event loop wait
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#include "busy_poll.h"
+#include <sstream>
+#include <algorithm>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+/**
+ * @brief Parses a CPU list such as "2", "2,3" or "2-5"
+ * @param text The list
+ * @param cpus Output CPU numbers
+ * @return true if the list was valid and not empty
+ */
+bool CpuAffinity::parseList(const std::string& text, std::vector<int>& cpus) {
+    cpus.clear();
+    std::stringstream list(text);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        size_t dash = item.find('-');
+        try {
+            int first = std::stoi(item.substr(0, dash));
+            int last = (dash == std::string::npos) ? first : std::stoi(item.substr(dash + 1));
+            if (first < 0 || last < first || last >= CPU_SETSIZE) {
+                return false;
+            }
+            for (int cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return !cpus.empty();
+}
+
+/**
+ * @brief Runs the calling thread on one CPU only
+ * @param cpu The CPU
+ * @return true on success
+ */
+bool CpuAffinity::pin(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+/**
+ * @brief Removes CPUs from the calling thread's allowed set
+ * @param cpus CPUs to keep off
+ * @return true on success; false, leaving the affinity as it was, if no other CPU is allowed
+ */
+bool CpuAffinity::keepOff(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        return false;
+    }
+    for (int cpu : cpus) {
+        CPU_CLR(cpu, &set);
+    }
+    return CPU_COUNT(&set) > 0 && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+/**
+ * @brief Turns spinning on
+ * @param idle_us Microseconds without events after which waits block again
+ */
+void BusyPoller::enable(int idle_us) {
+    enabled = true;
+    idle = std::chrono::microseconds(idle_us);
+    last_event = std::chrono::steady_clock::now();
+}
+
+/**
+ * @brief Waits for events like epoll_wait
+ * @param epoll_fd The epoll instance
+ * @param events Output events
+ * @param max_events Capacity of events
+ * @param timeout_ms Timeout of the blocking fallback, -1 for none; 0 polls once
+ * @return Number of events, or -1 with errno set
+ *
+ * Spins only while the last events are recent, so a burst of traffic keeps
+ * the loop hot and an idle period lets it sleep until the next request,
+ * which restarts spinning.
+ */
+int BusyPoller::wait(int epoll_fd, epoll_event* events, int max_events, int timeout_ms) {
+    if (!enabled || timeout_ms == 0) {
+        return epoll_wait(epoll_fd, events, max_events, timeout_ms);
+    }
+
+    while (std::chrono::steady_clock::now() - last_event < idle) {
+        int count = epoll_wait(epoll_fd, events, max_events, 0);
+        if (count != 0) {
+            if (count > 0) {
+                counters.spin_hits++;
+                last_event = std::chrono::steady_clock::now();
+            }
+            return count;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    counters.blocking_waits++;
+    int count = epoll_wait(epoll_fd, events, max_events, timeout_ms);
+    last_event = std::chrono::steady_clock::now();
+    return count;
+}
+
+/**
+ * @brief Asks the kernel to busy poll a socket's receive queue
+ * @param fd The socket
+ */
+void BusyPoller::configureSocket(int fd) const {
+    if (!enabled) {
+        return;
+    }
+    int busy_us = BUSY_POLL_SOCKET_US;
+    setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busy_us, sizeof(busy_us));
+}
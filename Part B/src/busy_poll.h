@@ -0,0 +1,153 @@
+/**
+ * @file busy_poll.h
+ * @brief Header file for CPU pinning and the busy-polling event loop wait
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#ifndef BUSY_POLL_H
+#define BUSY_POLL_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <sys/epoll.h>
+
+/**
+ * @brief Microseconds without events after which a busy poller blocks again
+ */
+#define BUSY_POLL_DEFAULT_IDLE_US 1000
+
+/**
+ * @brief SO_BUSY_POLL time requested for client sockets, in microseconds
+ */
+#define BUSY_POLL_SOCKET_US 50
+
+/**
+ * @class CpuAffinity
+ * @brief Pins threads to CPUs or keeps them off CPUs
+ *
+ * Threads inherit the affinity of the thread that creates them, so
+ * background threads started after keepOff() stay off those CPUs.
+ */
+class CpuAffinity {
+public:
+    /**
+     * @brief Parses a CPU list such as "2", "2,3" or "2-5"
+     * @param text The list
+     * @param cpus Output CPU numbers
+     * @return true if the list was valid and not empty
+     */
+    static bool parseList(const std::string& text, std::vector<int>& cpus);
+
+    /**
+     * @brief Runs the calling thread on one CPU only
+     * @param cpu The CPU
+     * @return true on success
+     */
+    static bool pin(int cpu);
+
+    /**
+     * @brief Removes CPUs from the calling thread's allowed set
+     * @param cpus CPUs to keep off
+     * @return true on success; false, leaving the affinity as it was, if no other CPU is allowed
+     */
+    static bool keepOff(const std::vector<int>& cpus);
+};
+
+/**
+ * @struct BusyPollStats
+ * @brief Counters describing how a BusyPoller waited
+ */
+struct BusyPollStats {
+    /**
+     * @brief Waits that found events while spinning
+     */
+    uint64_t spin_hits = 0;
+
+    /**
+     * @brief Waits that fell back to blocking after spinning idle
+     */
+    uint64_t blocking_waits = 0;
+};
+
+/**
+ * @class BusyPoller
+ * @brief epoll_wait that spins on a zero timeout while traffic is flowing
+ *
+ * Disabled, wait() is a plain epoll_wait. Enabled, it polls with a zero
+ * timeout until events arrive, trading a CPU for the wakeup latency of a
+ * sleeping thread. Once nothing has arrived for the idle period it blocks
+ * as usual, so an idle server doesn't burn its core forever.
+ *
+ * Not thread-safe; each event loop owns one.
+ */
+class BusyPoller {
+private:
+    /**
+     * @brief Whether waits spin before blocking
+     */
+    bool enabled = false;
+
+    /**
+     * @brief Spinning without events for this long falls back to blocking
+     */
+    std::chrono::microseconds idle{BUSY_POLL_DEFAULT_IDLE_US};
+
+    /**
+     * @brief When the last wait returned events
+     */
+    std::chrono::steady_clock::time_point last_event;
+
+    /**
+     * @brief How waits ended
+     */
+    BusyPollStats counters;
+
+public:
+    /**
+     * @brief Turns spinning on
+     * @param idle_us Microseconds without events after which waits block again
+     */
+    void enable(int idle_us);
+
+    /**
+     * @brief Whether waits spin
+     * @return true if enabled
+     */
+    bool isEnabled() const { return enabled; }
+
+    /**
+     * @brief Spinning period before falling back to blocking
+     * @return Microseconds
+     */
+    int idleUs() const { return static_cast<int>(idle.count()); }
+
+    /**
+     * @brief Waits for events like epoll_wait
+     * @param epoll_fd The epoll instance
+     * @param events Output events
+     * @param max_events Capacity of events
+     * @param timeout_ms Timeout of the blocking fallback, -1 for none; 0 polls once
+     * @return Number of events, or -1 with errno set
+     */
+    int wait(int epoll_fd, epoll_event* events, int max_events, int timeout_ms);
+
+    /**
+     * @brief Asks the kernel to busy poll a socket's receive queue
+     * @param fd The socket
+     *
+     * Best effort: SO_BUSY_POLL needs CAP_NET_ADMIN above net.core.busy_read
+     * and does nothing on loopback, so failures are ignored.
+     */
+    void configureSocket(int fd) const;
+
+    /**
+     * @brief How waits ended so far
+     * @return The counters
+     */
+    const BusyPollStats& stats() const { return counters; }
+};
+
+#endif // BUSY_POLL_H
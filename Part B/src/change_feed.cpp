@@ -0,0 +1,131 @@
+/**
+ * @file change_feed.cpp
+ * @brief Implementation of the ChangeFeed class
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#include "change_feed.h"
+#include <algorithm>
+
+/**
+ * @brief Constructor
+ * @param capacity Maximum number of retained events
+ * @param byte_limit Maximum number of retained key and value bytes
+ */
+ChangeFeed::ChangeFeed(size_t capacity, size_t byte_limit)
+    : ring(capacity), max_bytes(byte_limit) {
+}
+
+/**
+ * @brief Starts recording events; changes made before are not in the feed
+ */
+void ChangeFeed::enable() {
+    enabled.store(true, std::memory_order_release);
+}
+
+/**
+ * @brief Appends an event, dropping the oldest ones if needed
+ * @param type Kind of change
+ * @param key The affected key
+ * @param value The new value for SET events
+ * @return Offset assigned to the event, or the next offset if the feed is disabled
+ * 
+ * Slots are published with atomic shared_ptr stores, so a reader copying
+ * an entry never holds up the writer beyond that pointer copy.
+ * 
+ * An event larger than the whole byte budget is not stored. Its offset is
+ * used up and every earlier event dropped, so consumers that haven't read
+ * past it get TRIMMED and resync instead of silently missing it.
+ */
+uint64_t ChangeFeed::append(KeyEvent type, const std::string& key, const std::string& value) {
+    uint64_t offset = next_offset.load(std::memory_order_relaxed);
+    if (!enabled.load(std::memory_order_relaxed)) {
+        return offset;
+    }
+    uint64_t first = first_offset.load(std::memory_order_relaxed);
+    size_t size = key.size() + value.size();
+    bool oversized = size > max_bytes;
+
+    // Trim from the front until the new event fits both budgets
+    while (first < offset && (oversized || offset - first >= ring.size() || retained_bytes + size > max_bytes)) {
+        auto& slot = ring[first % ring.size()];
+        auto oldest = std::atomic_load(&slot);
+        if (oldest) {
+            retained_bytes -= oldest->key.size() + oldest->value.size();
+        }
+        std::atomic_store(&slot, std::shared_ptr<const ChangeEvent>());
+        first++;
+    }
+    if (oversized) {
+        first_offset.store(offset + 1, std::memory_order_release);
+        next_offset.store(offset + 1, std::memory_order_release);
+        return offset;
+    }
+    first_offset.store(first, std::memory_order_release);
+
+    auto event = std::make_shared<const ChangeEvent>(ChangeEvent{offset, type, key, value});
+    std::atomic_store(&ring[offset % ring.size()], std::move(event));
+    retained_bytes += size;
+    next_offset.store(offset + 1, std::memory_order_release);
+    return offset;
+}
+
+/**
+ * @brief Reads events starting at an offset
+ * @param offset Offset of the first event to read
+ * @param count Maximum number of events to read
+ * @param events Output vector the events are appended to
+ * @return TRIMMED if the offset is older than the retention window,
+ *         BEYOND_END if it is past the next offset
+ * 
+ * Reading at the next offset is not an error; it returns no events. An
+ * offset past it was never handed out, so the consumer is confused.
+ */
+FeedReadResult ChangeFeed::read(uint64_t offset, size_t count, std::vector<std::shared_ptr<const ChangeEvent>>& events) const {
+    if (offset < first_offset.load(std::memory_order_acquire)) {
+        return FeedReadResult::TRIMMED;
+    }
+    uint64_t next = next_offset.load(std::memory_order_acquire);
+    if (offset > next) {
+        return FeedReadResult::BEYOND_END;
+    }
+
+    uint64_t end = std::min<uint64_t>(next, offset + count);
+    for (uint64_t current = offset; current < end; current++) {
+        auto event = std::atomic_load(&ring[current % ring.size()]);
+        if (!event || event->offset != current) {
+            // Overwritten while reading; the reader is now behind
+            if (current == offset) {
+                return FeedReadResult::TRIMMED;
+            }
+            break;
+        }
+        events.push_back(std::move(event));
+    }
+    return FeedReadResult::OK;
+}
+
+/**
+ * @brief Offset of the oldest retained event
+ * @return First readable offset
+ */
+uint64_t ChangeFeed::firstOffset() const {
+    return first_offset.load(std::memory_order_acquire);
+}
+
+/**
+ * @brief Offset the next event will get
+ * @return End of the feed
+ */
+uint64_t ChangeFeed::nextOffset() const {
+    return next_offset.load(std::memory_order_acquire);
+}
+
+/**
+ * @brief Key and value bytes of the retained events
+ * @return Retained payload size
+ */
+size_t ChangeFeed::retainedBytes() const {
+    return retained_bytes;
+}
@@ -0,0 +1,162 @@
+/**
+ * @file change_feed.h
+ * @brief Header file for the ChangeFeed keyspace change stream
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#ifndef CHANGE_FEED_H
+#define CHANGE_FEED_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include "blinkdb.h"
+
+/**
+ * @brief Maximum number of events retained by the change feed
+ */
+#define CHANGE_FEED_CAPACITY 65536
+
+/**
+ * @brief Maximum number of key and value bytes retained by the change feed
+ */
+#define CHANGE_FEED_MAX_BYTES (64 * 1024 * 1024)
+
+/**
+ * @struct ChangeEvent
+ * @brief One entry of the change feed
+ */
+struct ChangeEvent {
+    /**
+     * @brief Position of the event in the feed
+     */
+    uint64_t offset;
+    
+    /**
+     * @brief Kind of change
+     */
+    KeyEvent type;
+    
+    /**
+     * @brief The affected key
+     */
+    std::string key;
+    
+    /**
+     * @brief The new value for SET events, empty otherwise
+     */
+    std::string value;
+};
+
+/**
+ * @enum FeedReadResult
+ * @brief Outcome of reading the change feed at an offset
+ */
+enum class FeedReadResult {
+    OK,
+    TRIMMED,
+    BEYOND_END
+};
+
+/**
+ * @class ChangeFeed
+ * @brief Ordered, bounded log of keyspace changes readable by offset
+ *
+ * Events live in a fixed-size ring of immutable, shared entries. There is a
+ * single writer (changes are serialised by the database lock) which never
+ * waits for readers: it overwrites the oldest slot and readers that find a
+ * slot overwritten learn they have fallen behind. Retention is bounded both
+ * in events and in bytes, so memory use does not depend on how far behind
+ * any consumer is.
+ *
+ * The feed records nothing until enable() is called, so a server without
+ * consumers doesn't pay for copying every write.
+ */
+class ChangeFeed {
+private:
+    /**
+     * @brief Ring of events, indexed by offset modulo capacity
+     */
+    std::vector<std::shared_ptr<const ChangeEvent>> ring;
+    
+    /**
+     * @brief Offset of the oldest retained event
+     */
+    std::atomic<uint64_t> first_offset{0};
+    
+    /**
+     * @brief Offset the next event will get
+     */
+    std::atomic<uint64_t> next_offset{0};
+    
+    /**
+     * @brief Key and value bytes of the retained events
+     */
+    size_t retained_bytes = 0;
+    
+    /**
+     * @brief Byte budget for retained events
+     */
+    const size_t max_bytes;
+    
+    /**
+     * @brief Whether append() records events
+     */
+    std::atomic<bool> enabled{false};
+
+public:
+    /**
+     * @brief Constructor
+     * @param capacity Maximum number of retained events
+     * @param byte_limit Maximum number of retained key and value bytes
+     */
+    explicit ChangeFeed(size_t capacity = CHANGE_FEED_CAPACITY, size_t byte_limit = CHANGE_FEED_MAX_BYTES);
+    
+    /**
+     * @brief Starts recording events; changes made before are not in the feed
+     */
+    void enable();
+    
+    /**
+     * @brief Appends an event, dropping the oldest ones if needed
+     * @param type Kind of change
+     * @param key The affected key
+     * @param value The new value for SET events
+     * @return Offset assigned to the event, or the next offset if the feed is disabled
+     */
+    uint64_t append(KeyEvent type, const std::string& key, const std::string& value);
+    
+    /**
+     * @brief Reads events starting at an offset
+     * @param offset Offset of the first event to read
+     * @param count Maximum number of events to read
+     * @param events Output vector the events are appended to
+     * @return TRIMMED if the offset is older than the retention window,
+     *         BEYOND_END if it is past the next offset
+     */
+    FeedReadResult read(uint64_t offset, size_t count, std::vector<std::shared_ptr<const ChangeEvent>>& events) const;
+    
+    /**
+     * @brief Offset of the oldest retained event
+     * @return First readable offset
+     */
+    uint64_t firstOffset() const;
+    
+    /**
+     * @brief Offset the next event will get
+     * @return End of the feed
+     */
+    uint64_t nextOffset() const;
+    
+    /**
+     * @brief Key and value bytes of the retained events
+     * @return Retained payload size
+     */
+    size_t retainedBytes() const;
+};
+
+#endif // CHANGE_FEED_H
@@ -0,0 +1,287 @@
+/**
+ * @file connect_bench.cpp
+ * @brief Benchmark of how fast blink_server takes on a storm of new connections
+ * @author Madhumita
+ * @date 2025-03-31
+ *
+ * Starts blink_server, then opens thousands of connections to it at once
+ * from one non-blocking client and sends a PING on each as soon as it is
+ * connected. A connection counts as established when its PONG arrives,
+ * i.e. once the server has accepted and registered it, not merely when the
+ * kernel finished the handshake. Reports the time until every connection
+ * was established, the per-connection p50/p99/max time to its PONG and how
+ * many connections failed.
+ *
+ * Each server runs in a fresh temporary directory, so its snapshot file
+ * doesn't touch one in the current directory.
+ *
+ * Compilation: g++ -std=c++17 -O2 connect_bench.cpp bench_util.cpp -o connect_bench
+ * Execution: ./connect_bench [-n connections,...] [-r repeats] [-s server_binary] [-j output.json]
+ *            [-- blink_server options]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bench_util.h"
+
+#define SERVER_PORT 9001
+#define STORM_TIMEOUT_S 30
+#define PING "*1\r\n$4\r\nPING\r\n"
+#define PONG "+PONG\r\n"
+
+/**
+ * @struct StormResult
+ * @brief Measurements of one connection storm
+ */
+struct StormResult {
+    size_t connections;
+    size_t established;
+    double total_ms;      // Until the last PONG arrived
+    double p50_ms;
+    double p99_ms;
+    double max_ms;
+};
+
+/**
+ * @struct StormConnection
+ * @brief One client connection of a storm
+ */
+struct StormConnection {
+    int fd = -1;
+    size_t received = 0;   // Bytes of the PONG read so far
+    bool connected = false;
+    bool done = false;
+};
+
+/**
+ * @brief Local server address
+ * @return 127.0.0.1:SERVER_PORT
+ */
+static sockaddr_in serverAddress() {
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(SERVER_PORT);
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    return address;
+}
+
+/**
+ * @brief Closes a socket with a reset
+ * @param fd The socket
+ *
+ * Skips TIME_WAIT, so repeated storms don't run out of local ports.
+ */
+static void resetClose(int fd) {
+    linger reset = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+    close(fd);
+}
+
+/**
+ * @brief Opens connections all at once and waits for a PONG on each
+ * @param count Number of connections
+ * @return The measurements
+ */
+static StormResult storm(size_t count) {
+    sockaddr_in address = serverAddress();
+    int epoll_fd = epoll_create1(0);
+    std::vector<StormConnection> conns(count);
+    std::vector<double> times;
+    times.reserve(count);
+    size_t finished = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++) {
+        StormConnection& conn = conns[i];
+        conn.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (conn.fd < 0 ||
+            (connect(conn.fd, (struct sockaddr*)&address, sizeof(address)) < 0 && errno != EINPROGRESS)) {
+            conn.done = true;
+            finished++;
+            continue;
+        }
+        epoll_event event = {};
+        event.events = EPOLLOUT;
+        event.data.u64 = i;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, conn.fd, &event);
+    }
+
+    std::vector<epoll_event> events(1024);
+    auto deadline = start + std::chrono::seconds(STORM_TIMEOUT_S);
+    char buffer[64];
+    while (finished < count && std::chrono::steady_clock::now() < deadline) {
+        int ready = epoll_wait(epoll_fd, events.data(), events.size(), 100);
+        for (int e = 0; e < ready; e++) {
+            StormConnection& conn = conns[events[e].data.u64];
+            if (conn.done) continue;
+            if (!conn.connected) {
+                int error = 0;
+                socklen_t length = sizeof(error);
+                getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+                if (error != 0 || write(conn.fd, PING, sizeof(PING) - 1) != sizeof(PING) - 1) {
+                    conn.done = true;
+                    finished++;
+                    continue;
+                }
+                conn.connected = true;
+                epoll_event event = {};
+                event.events = EPOLLIN;
+                event.data.u64 = events[e].data.u64;
+                epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn.fd, &event);
+                continue;
+            }
+            ssize_t bytes = read(conn.fd, buffer, sizeof(buffer));
+            if (bytes <= 0) {
+                if (bytes < 0 && errno == EAGAIN) continue;
+                conn.done = true;
+                finished++;
+                continue;
+            }
+            conn.received += bytes;
+            if (conn.received >= sizeof(PONG) - 1) {
+                conn.done = true;
+                finished++;
+                times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            }
+        }
+    }
+    double total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    for (StormConnection& conn : conns) {
+        if (conn.fd >= 0) {
+            resetClose(conn.fd);
+        }
+    }
+    close(epoll_fd);
+
+    StormResult result = {count, times.size(), total, 0, 0, 0};
+    result.p50_ms = benchPercentile(times, 0.5);
+    result.p99_ms = benchPercentile(times, 0.99);
+    result.max_ms = times.empty() ? 0 : times.back();
+    return result;
+}
+
+/**
+ * @brief Writes all results as JSON
+ * @param path Output file
+ * @param results The results
+ */
+static void writeJson(const std::string& path, const std::vector<StormResult>& results) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Error: cannot write " << path << std::endl;
+        return;
+    }
+    out << "{\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const StormResult& r = results[i];
+        out << (i ? "," : "") << "\n    {\"connections\": " << r.connections << ", \"established\": " << r.established
+            << ", \"total_ms\": " << r.total_ms << ", \"p50_ms\": " << r.p50_ms << ", \"p99_ms\": " << r.p99_ms
+            << ", \"max_ms\": " << r.max_ms << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+/**
+ * @brief Main function
+ * @param argc Number of command-line arguments
+ * @param argv Array of command-line arguments
+ * @return Exit code
+ */
+int main(int argc, char* argv[]) {
+    std::vector<size_t> counts = {1000, 10000};
+    int repeats = 3;
+    std::string server_path = "./blink_server";
+    std::string json_path;
+    std::vector<std::string> server_options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc) {
+            counts.clear();
+            std::stringstream list(argv[++i]);
+            std::string count;
+            while (std::getline(list, count, ',')) {
+                counts.push_back(std::stoull(count));
+            }
+        } else if (arg == "-r" && i + 1 < argc) {
+            repeats = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "-s" && i + 1 < argc) {
+            server_path = argv[++i];
+        } else if (arg == "-j" && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (arg == "--") {
+            server_options.assign(argv + i + 1, argv + argc);
+            break;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [-n connections,...] [-r repeats] [-s server_binary]"
+                      << " [-j output.json] [-- blink_server options]" << std::endl;
+            return 1;
+        }
+    }
+
+    char server[PATH_MAX];
+    if (!realpath(server_path.c_str(), server)) {
+        std::cerr << "Error: cannot find " << server_path << std::endl;
+        return 1;
+    }
+
+    // The client holds one descriptor per connection too
+    rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    pid_t pid = benchSpawn(server, server_options, "connect_bench");
+    int probe = (pid > 0) ? benchWaitForPort(SERVER_PORT) : -1;
+    if (probe < 0) {
+        std::cerr << "Error: server did not start; is another one on port " << SERVER_PORT << "?" << std::endl;
+        if (pid > 0) {
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+        return 1;
+    }
+    close(probe);
+
+    std::vector<StormResult> results;
+    std::printf("%11s %12s %10s %10s %10s %10s\n", "connections", "established", "total ms", "p50 ms", "p99 ms",
+                "max ms");
+    for (size_t count : counts) {
+        for (int r = 0; r < repeats; r++) {
+            StormResult result = storm(count);
+            std::printf("%11zu %12zu %10.1f %10.1f %10.1f %10.1f\n", result.connections, result.established,
+                        result.total_ms, result.p50_ms, result.p99_ms, result.max_ms);
+            results.push_back(result);
+            // Let the server see the resets before the next storm
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        }
+    }
+
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    if (!json_path.empty()) {
+        writeJson(json_path, results);
+    }
+    return 0;
+}
@@ -0,0 +1,371 @@
+/**
+ * @file fake_backend.cpp
+ * @brief Stand-in RESP backend with injectable latency, errors and stalls
+ * @author Madhumita
+ * @date 2025-03-31
+ *
+ * Answers SET, GET, DEL, PING and CONFIG like blink_server, from an
+ * in-memory map, and INFO with the number of requests served, so the load
+ * balancer can be benchmarked and tested without real servers. Faults are
+ * injected on request:
+ * - a fixed per-reply delay plus random jitter, without blocking other clients
+ * - error replies for a fraction of requests
+ * - random stalls of the whole process, like a persistToFile dump
+ * - a fixed service time per request, capping throughput like a saturated server
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <queue>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "resp.h"
+
+/**
+ * @struct FakeBackendConfig
+ * @brief Port and fault injection settings
+ */
+struct FakeBackendConfig {
+    int port = 9001;
+    int delay_us = 0;         // Added to every reply
+    int jitter_us = 0;        // Uniform random extra delay, up to this much
+    double error_rate = 0;    // Fraction of requests answered with an error
+    int stall_every = 0;      // Stall the whole process once per this many requests on average, 0 for never
+    int stall_ms = 0;         // Length of each stall
+    size_t value_size = 16;   // Size of the value returned for keys never SET
+    int service_us = 0;       // Requests are served one after another, this long each, without using CPU
+};
+
+/**
+ * @struct FakeConnection
+ * @brief Buffers of one client connection
+ */
+struct FakeConnection {
+    std::string input;
+    std::string output;
+    std::chrono::steady_clock::time_point last_due;  // Keeps delayed replies in request order
+    bool want_write = false;
+};
+
+/**
+ * @struct DelayedReply
+ * @brief A reply held back until its due time
+ */
+struct DelayedReply {
+    std::chrono::steady_clock::time_point due;
+    int fd;
+    std::string data;
+
+    bool operator>(const DelayedReply& other) const { return due > other.due; }
+};
+
+/**
+ * @class FakeBackend
+ * @brief Single-threaded epoll RESP server with fault injection
+ */
+class FakeBackend {
+private:
+    FakeBackendConfig config;
+    int server_fd = -1;
+    int epoll_fd = -1;
+    std::unordered_map<int, FakeConnection> connections;
+    std::priority_queue<DelayedReply, std::vector<DelayedReply>, std::greater<DelayedReply>> delayed;
+    std::unordered_map<std::string, std::string> store;
+    std::string default_value;
+    uint64_t requests = 0;
+    std::chrono::steady_clock::time_point busy_until;  // When the simulated server finishes its queued requests
+    std::mt19937_64 rng;
+
+    /**
+     * @brief Computes the reply to one command
+     * @param command Command arguments
+     * @return RESP-2 encoded reply
+     */
+    std::string reply(const std::vector<std::string>& command) {
+        if (config.error_rate > 0 && std::uniform_real_distribution<double>(0, 1)(rng) < config.error_rate) {
+            return RespCodec::encodeError("injected failure");
+        }
+
+        std::string cmd = command[0];
+        std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::toupper);
+        if (cmd == "GET" && command.size() == 2) {
+            auto it = store.find(command[1]);
+            return RespCodec::encodeBulkString(it == store.end() ? default_value : it->second);
+        } else if (cmd == "SET" && command.size() == 3) {
+            store[command[1]] = command[2];
+            return RespCodec::encodeSimpleString("OK");
+        } else if (cmd == "DEL" && command.size() == 2) {
+            return RespCodec::encodeInteger(store.erase(command[1]));
+        } else if (cmd == "PING") {
+            return RespCodec::encodeSimpleString("PONG");
+        } else if (cmd == "CONFIG") {
+            return "*0\r\n";
+        } else if (cmd == "INFO") {
+            return RespCodec::encodeBulkString("requests:" + std::to_string(requests) + "\r\n");
+        }
+        return RespCodec::encodeError("Unknown command");
+    }
+
+    /**
+     * @brief Appends data to a connection's output and tries to send it
+     * @param fd Client socket
+     * @param data Bytes to send
+     */
+    void send(int fd, const std::string& data) {
+        auto it = connections.find(fd);
+        if (it == connections.end()) {
+            return;
+        }
+        FakeConnection& conn = it->second;
+        conn.output += data;
+
+        ssize_t written = write(fd, conn.output.data(), conn.output.size());
+        if (written > 0) {
+            conn.output.erase(0, written);
+        }
+        bool want_write = !conn.output.empty();
+        if (want_write != conn.want_write) {
+            epoll_event event = {};
+            event.events = want_write ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+            event.data.fd = fd;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+            conn.want_write = want_write;
+        }
+    }
+
+    /**
+     * @brief Reads from a client and answers every complete command
+     * @param fd Client socket
+     */
+    void handleRead(int fd) {
+        char buffer[16384];
+        ssize_t bytes = read(fd, buffer, sizeof(buffer));
+        if (bytes < 0 && (errno == EAGAIN || errno == EINTR)) {
+            return;
+        }
+        if (bytes <= 0) {
+            connections.erase(fd);
+            close(fd);
+            return;
+        }
+
+        FakeConnection& conn = connections[fd];
+        conn.input.append(buffer, bytes);
+        std::string immediate;
+        size_t pos = 0;
+        std::vector<std::string> command;
+
+        while (true) {
+            ParseResult result = RespCodec::decodeCommand(conn.input, pos, command);
+            if (result == ParseResult::INCOMPLETE) {
+                break;
+            }
+            if (result == ParseResult::INVALID) {
+                immediate += RespCodec::encodeError("Invalid Command");
+                pos = conn.input.size();
+                break;
+            }
+            if (command.empty()) {
+                continue;
+            }
+
+            // Random rather than every Nth request, so backends under the same load don't stall in step
+            requests++;
+            if (config.stall_every > 0 && rng() % config.stall_every == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(config.stall_ms));
+            }
+
+            std::string data = reply(command);
+            if (config.delay_us == 0 && config.jitter_us == 0 && config.service_us == 0) {
+                immediate += data;
+                continue;
+            }
+            auto now = std::chrono::steady_clock::now();
+            int delay = config.delay_us + (config.jitter_us ? static_cast<int>(rng() % (config.jitter_us + 1)) : 0);
+            auto due = std::max(now + std::chrono::microseconds(delay), conn.last_due);
+            if (config.service_us > 0) {
+                busy_until = std::max(busy_until, now) + std::chrono::microseconds(config.service_us);
+                due = std::max(due, busy_until);
+            }
+            conn.last_due = due;
+            delayed.push({due, fd, std::move(data)});
+        }
+        conn.input.erase(0, pos);
+
+        if (!immediate.empty()) {
+            send(fd, immediate);
+        }
+    }
+
+    /**
+     * @brief Sends delayed replies whose time has come
+     */
+    void releaseDue() {
+        auto now = std::chrono::steady_clock::now();
+        while (!delayed.empty() && delayed.top().due <= now) {
+            DelayedReply next = delayed.top();
+            delayed.pop();
+            send(next.fd, next.data);
+        }
+    }
+
+public:
+    /**
+     * @brief Constructor
+     * @param backend_config Port and fault injection settings
+     *
+     * Binds and listens; throws std::runtime_error on failure.
+     */
+    explicit FakeBackend(const FakeBackendConfig& backend_config)
+        : config(backend_config), default_value(backend_config.value_size, 'v'), rng(backend_config.port) {
+        server_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (server_fd < 0) {
+            throw std::runtime_error("Socket creation failed");
+        }
+        int opt = 1;
+        setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = INADDR_ANY;
+        address.sin_port = htons(config.port);
+        if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+            throw std::runtime_error("Socket binding failed");
+        }
+        if (listen(server_fd, 1024) < 0) {
+            throw std::runtime_error("Listening failed");
+        }
+
+        epoll_fd = epoll_create1(0);
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = server_fd;
+        if (epoll_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &event) < 0) {
+            throw std::runtime_error("Epoll setup failed");
+        }
+    }
+
+    /**
+     * @brief Destructor, closes every socket
+     */
+    ~FakeBackend() {
+        for (const auto& [fd, conn] : connections) {
+            (void)conn;
+            close(fd);
+        }
+        close(epoll_fd);
+        close(server_fd);
+    }
+
+    /**
+     * @brief Serves clients until the process is killed
+     */
+    void run() {
+        std::vector<epoll_event> events(256);
+        while (true) {
+            // Sleep until the next delayed reply is due, to the nanosecond
+            timespec timeout = {};
+            timespec* wait = nullptr;
+            if (!delayed.empty()) {
+                auto left = std::max(delayed.top().due - std::chrono::steady_clock::now(),
+                                     std::chrono::steady_clock::duration::zero());
+                long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+                timeout.tv_sec = ns / 1000000000;
+                timeout.tv_nsec = ns % 1000000000;
+                wait = &timeout;
+            }
+
+            int count = epoll_pwait2(epoll_fd, events.data(), events.size(), wait, nullptr);
+            if (count < 0 && errno != EINTR) {
+                std::cerr << "Epoll wait failed" << std::endl;
+            }
+
+            for (int i = 0; i < count; i++) {
+                int fd = events[i].data.fd;
+                if (fd == server_fd) {
+                    int client = accept4(server_fd, nullptr, nullptr, SOCK_NONBLOCK);
+                    if (client < 0) {
+                        continue;
+                    }
+                    int nodelay = 1;
+                    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+                    epoll_event event = {};
+                    event.events = EPOLLIN;
+                    event.data.fd = client;
+                    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client, &event);
+                    connections[client] = FakeConnection();
+                } else {
+                    if (events[i].events & EPOLLOUT) {
+                        send(fd, "");
+                    }
+                    if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                        handleRead(fd);
+                    }
+                }
+            }
+            releaseDue();
+        }
+    }
+};
+
+/**
+ * @brief Main function
+ * @param argc Number of command-line arguments
+ * @param argv Array of command-line arguments
+ * @return Exit code (0 for success, 1 for failure)
+ */
+int main(int argc, char* argv[]) {
+    FakeBackendConfig config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            arg = "";
+        }
+        if (arg == "-p") {
+            config.port = std::stoi(argv[++i]);
+        } else if (arg == "-d") {
+            config.delay_us = std::stoi(argv[++i]);
+        } else if (arg == "-j") {
+            config.jitter_us = std::stoi(argv[++i]);
+        } else if (arg == "-e") {
+            config.error_rate = std::stod(argv[++i]);
+        } else if (arg == "-s") {
+            // every:ms
+            std::string spec = argv[++i];
+            size_t colon = spec.find(':');
+            config.stall_every = std::stoi(spec.substr(0, colon));
+            config.stall_ms = (colon == std::string::npos) ? 0 : std::stoi(spec.substr(colon + 1));
+        } else if (arg == "-v") {
+            config.value_size = std::stoull(argv[++i]);
+        } else if (arg == "-S") {
+            config.service_us = std::stoi(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [-p port] [-d delay_us] [-j jitter_us] [-e error_rate]"
+                      << " [-s every:stall_ms] [-v value_size] [-S service_us]" << std::endl;
+            return 1;
+        }
+    }
+
+    try {
+        FakeBackend backend(config);
+        std::cout << "Fake backend started on port " << config.port << std::endl;
+        backend.run();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
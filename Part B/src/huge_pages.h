@@ -0,0 +1,181 @@
+/**
+ * @file huge_pages.h
+ * @brief Header file for huge-page-backed allocation of BlinkDB's large arrays
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#ifndef HUGE_PAGES_H
+#define HUGE_PAGES_H
+
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <cstddef>
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/**
+ * @enum HugePageMode
+ * @brief How large allocations are backed
+ */
+enum class HugePageMode {
+    OFF,        // Regular 4 KB pages
+    ADVISE,     // 2 MB aligned mappings advised for transparent huge pages
+    EXPLICIT    // Reserved hugetlbfs pages, falling back to ADVISE when none are free
+};
+
+/**
+ * @struct HugePageStats
+ * @brief Counters describing memory allocated through HugePages
+ */
+struct HugePageStats {
+    /**
+     * @brief Current mode
+     */
+    HugePageMode mode;
+
+    /**
+     * @brief Bytes currently mapped for large allocations
+     */
+    size_t mapped_bytes;
+
+    /**
+     * @brief 2 MB pages currently taken from the hugetlbfs reserve
+     */
+    size_t explicit_pages;
+
+    /**
+     * @brief 2 MB regions currently advised for transparent huge pages
+     */
+    size_t advised_pages;
+
+    /**
+     * @brief Explicit allocations that found no reserved pages and fell back
+     */
+    size_t explicit_fallbacks;
+
+    /**
+     * @brief Bytes of the whole process backed by transparent huge pages
+     */
+    size_t thp_bytes;
+};
+
+/**
+ * @class HugePages
+ * @brief Process-wide allocator for arrays large enough to benefit from huge pages
+ *
+ * Allocations of at least HUGE_PAGE_SIZE bytes are mapped directly, rounded
+ * to whole 2 MB pages and 2 MB aligned, and backed according to the current
+ * mode. Smaller allocations go to operator new. Which path an allocation
+ * took only depends on its size, so the mode can be changed at any time.
+ *
+ * Mappings are not pre-faulted: each page is placed on the NUMA node of the
+ * thread that first writes it, so a table built by a reactor thread is local
+ * to that thread.
+ */
+class HugePages {
+private:
+    static std::atomic<HugePageMode> current_mode;
+    static std::atomic<size_t> mapped_bytes;
+    static std::atomic<size_t> explicit_pages;
+    static std::atomic<size_t> advised_pages;
+    static std::atomic<size_t> explicit_fallbacks;
+
+    /**
+     * @brief Protects mappings
+     */
+    static std::mutex mappings_mutex;
+
+    /**
+     * @brief How each live mapping is backed, so freeing it updates the right counter
+     */
+    static std::unordered_map<void*, HugePageMode> mappings;
+
+    /**
+     * @brief Maps a 2 MB aligned region of regular pages
+     * @param bytes Size, a multiple of HUGE_PAGE_SIZE
+     * @return Start of the region
+     */
+    static void* mapAligned(size_t bytes);
+
+public:
+    /**
+     * @brief Selects how future large allocations are backed
+     * @param mode The mode
+     */
+    static void setMode(HugePageMode mode);
+
+    /**
+     * @brief Current mode
+     * @return The mode
+     */
+    static HugePageMode mode();
+
+    /**
+     * @brief Parses a mode name
+     * @param name "off", "advise" or "explicit"
+     * @param mode Set to the parsed mode
+     * @return true if the name is valid
+     */
+    static bool parseMode(const std::string& name, HugePageMode& mode);
+
+    /**
+     * @brief Name of a mode
+     * @param mode The mode
+     * @return "off", "advise" or "explicit"
+     */
+    static const char* modeName(HugePageMode mode);
+
+    /**
+     * @brief Allocates memory
+     * @param bytes Number of bytes
+     * @return The memory
+     */
+    static void* allocate(size_t bytes);
+
+    /**
+     * @brief Frees memory returned by allocate()
+     * @param ptr The memory
+     * @param bytes Number of bytes passed to allocate()
+     */
+    static void deallocate(void* ptr, size_t bytes);
+
+    /**
+     * @brief Reads the allocation counters
+     * @return Current statistics
+     */
+    static HugePageStats stats();
+};
+
+/**
+ * @struct HugePageAllocator
+ * @brief Standard allocator that places large containers on huge pages
+ * @tparam T Element type
+ */
+template <typename T>
+struct HugePageAllocator {
+    using value_type = T;
+
+    HugePageAllocator() = default;
+
+    template <typename U>
+    HugePageAllocator(const HugePageAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(HugePages::allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* ptr, size_t n) {
+        HugePages::deallocate(ptr, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const HugePageAllocator<U>&) const { return true; }
+
+    template <typename U>
+    bool operator!=(const HugePageAllocator<U>&) const { return false; }
+};
+
+#endif // HUGE_PAGES_H
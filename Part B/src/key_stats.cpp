@@ -0,0 +1,176 @@
+/**
+ * @file key_stats.cpp
+ * @brief Implementation of online hot-key and big-key detection
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#include "key_stats.h"
+#include <algorithm>
+#include <functional>
+
+/**
+ * @brief Orders a heap so that its smallest count is at the front
+ */
+static bool greaterCount(const KeyCount& a, const KeyCount& b) {
+    return a.count > b.count;
+}
+
+/**
+ * @brief Constructor
+ */
+KeyStats::KeyStats() : sketch(KEY_STATS_SKETCH_DEPTH * KEY_STATS_SKETCH_WIDTH, 0) {
+}
+
+/**
+ * @brief Adds one to a key's sketch counters
+ * @param key The key
+ * @return The key's new estimate
+ * 
+ * The rows' counter indices come from one 64-bit hash by double hashing.
+ */
+uint32_t KeyStats::addToSketch(const std::string& key) {
+    uint64_t hash = std::hash<std::string>{}(key);
+    uint32_t h1 = static_cast<uint32_t>(hash);
+    uint32_t h2 = static_cast<uint32_t>(hash >> 32) | 1;
+
+    uint32_t estimate = UINT32_MAX;
+    for (uint32_t row = 0; row < KEY_STATS_SKETCH_DEPTH; row++) {
+        uint32_t& counter = sketch[row * KEY_STATS_SKETCH_WIDTH + (h1 + row * h2) % KEY_STATS_SKETCH_WIDTH];
+        if (counter < UINT32_MAX) {
+            counter++;
+        }
+        estimate = std::min(estimate, counter);
+    }
+    return estimate;
+}
+
+/**
+ * @brief Halves every sketch counter and hot-key estimate
+ */
+void KeyStats::decay() {
+    for (uint32_t& counter : sketch) {
+        counter >>= 1;
+    }
+    // Halving keeps the heap order, no need to rebuild it
+    for (KeyCount& entry : hot) {
+        entry.count >>= 1;
+    }
+    samples_since_decay = 0;
+}
+
+/**
+ * @brief Inserts or updates a key in a min-heap limited to KEY_STATS_TOP_K entries
+ * @param heap The heap
+ * @param key The key
+ * @param count The key's count
+ * 
+ * The heap is small enough that finding a key by linear search is cheaper
+ * than maintaining an index.
+ */
+void KeyStats::offer(std::vector<KeyCount>& heap, const std::string& key, uint64_t count) {
+    auto it = std::find_if(heap.begin(), heap.end(), [&key](const KeyCount& entry) { return entry.key == key; });
+    if (it != heap.end()) {
+        it->count = count;
+        std::make_heap(heap.begin(), heap.end(), greaterCount);
+        return;
+    }
+
+    if (heap.size() < KEY_STATS_TOP_K) {
+        heap.push_back({key, count});
+        std::push_heap(heap.begin(), heap.end(), greaterCount);
+    } else if (count > heap.front().count) {
+        std::pop_heap(heap.begin(), heap.end(), greaterCount);
+        heap.back() = {key, count};
+        std::push_heap(heap.begin(), heap.end(), greaterCount);
+    }
+}
+
+/**
+ * @brief Copies a heap's entries, largest first
+ * @param heap The heap
+ * @param limit Maximum number of entries
+ * @return The entries
+ */
+std::vector<KeyCount> KeyStats::sorted(const std::vector<KeyCount>& heap, size_t limit) {
+    std::vector<KeyCount> entries(heap);
+    std::sort(entries.begin(), entries.end(), greaterCount);
+    if (entries.size() > limit) {
+        entries.resize(limit);
+    }
+    return entries;
+}
+
+/**
+ * @brief Records a read or write of a key
+ * @param key The key
+ */
+void KeyStats::recordAccess(const std::string& key) {
+    static_assert((KEY_STATS_SAMPLE_RATE & (KEY_STATS_SAMPLE_RATE - 1)) == 0, "sample rate must be a power of two");
+
+    accesses++;
+    sample_state ^= sample_state << 13;
+    sample_state ^= sample_state >> 7;
+    sample_state ^= sample_state << 17;
+    if ((sample_state & (KEY_STATS_SAMPLE_RATE - 1)) != 0) {
+        return;
+    }
+
+    uint32_t estimate = addToSketch(key);
+    offer(hot, key, static_cast<uint64_t>(estimate));
+
+    if (++samples_since_decay >= KEY_STATS_DECAY_INTERVAL) {
+        decay();
+    }
+}
+
+/**
+ * @brief Records the value size written to a key
+ * @param key The key
+ * @param bytes Size of the new value
+ * 
+ * A key in the list that is overwritten with a smaller value keeps its
+ * place with the new size, and may be pushed out later.
+ */
+void KeyStats::recordWrite(const std::string& key, size_t bytes) {
+    bool listed = std::any_of(big.begin(), big.end(), [&key](const KeyCount& entry) { return entry.key == key; });
+    if (listed || big.size() < KEY_STATS_TOP_K || bytes > big.front().count) {
+        offer(big, key, bytes);
+    }
+}
+
+/**
+ * @brief Forgets a deleted key
+ * @param key The key
+ */
+void KeyStats::recordDelete(const std::string& key) {
+    for (auto* heap : {&hot, &big}) {
+        auto it = std::find_if(heap->begin(), heap->end(), [&key](const KeyCount& entry) { return entry.key == key; });
+        if (it != heap->end()) {
+            heap->erase(it);
+            std::make_heap(heap->begin(), heap->end(), greaterCount);
+        }
+    }
+}
+
+/**
+ * @brief Most accessed keys
+ * @param limit Maximum number of keys
+ * @return Keys with their estimated recent access counts, hottest first
+ */
+std::vector<KeyCount> KeyStats::hotKeys(size_t limit) const {
+    std::vector<KeyCount> keys = sorted(hot, limit);
+    for (KeyCount& entry : keys) {
+        entry.count *= KEY_STATS_SAMPLE_RATE;
+    }
+    return keys;
+}
+
+/**
+ * @brief Keys with the largest values
+ * @param limit Maximum number of keys
+ * @return Keys with their value sizes, largest first
+ */
+std::vector<KeyCount> KeyStats::bigKeys(size_t limit) const {
+    return sorted(big, limit);
+}
@@ -0,0 +1,174 @@
+/**
+ * @file key_stats.h
+ * @brief Header file for online hot-key and big-key detection
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#ifndef KEY_STATS_H
+#define KEY_STATS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Rows of the count-min sketch
+ */
+#define KEY_STATS_SKETCH_DEPTH 4
+
+/**
+ * @brief Counters per row of the count-min sketch
+ */
+#define KEY_STATS_SKETCH_WIDTH 4096
+
+/**
+ * @brief One in this many key accesses is sampled, a power of two
+ */
+#define KEY_STATS_SAMPLE_RATE 8
+
+/**
+ * @brief Sampled accesses after which all counts are halved
+ */
+#define KEY_STATS_DECAY_INTERVAL 100000
+
+/**
+ * @brief Number of hot keys and big keys remembered
+ */
+#define KEY_STATS_TOP_K 32
+
+/**
+ * @struct KeyCount
+ * @brief A key with an access count or a size
+ */
+struct KeyCount {
+    std::string key;
+    uint64_t count;
+};
+
+/**
+ * @class KeyStats
+ * @brief Finds the most accessed keys and the largest values as they happen
+ *
+ * Hot keys: one access in KEY_STATS_SAMPLE_RATE is fed to a count-min
+ * sketch, and keys whose estimate beats the smallest of the current top K
+ * enter a min-heap of hot keys. Every KEY_STATS_DECAY_INTERVAL samples all
+ * counts are halved, so the ranking follows the recent workload rather than
+ * all of history. Estimates are scaled back up by the sample rate.
+ *
+ * Big keys: every write's value size is checked against a min-heap of the
+ * K largest values seen; deleted keys leave it.
+ *
+ * Not thread-safe; the server calls it from its event loop only.
+ */
+class KeyStats {
+private:
+    /**
+     * @brief Count-min sketch, KEY_STATS_SKETCH_DEPTH rows of KEY_STATS_SKETCH_WIDTH counters
+     */
+    std::vector<uint32_t> sketch;
+
+    /**
+     * @brief Min-heap of hot keys by estimated count
+     */
+    std::vector<KeyCount> hot;
+
+    /**
+     * @brief Min-heap of big keys by value size
+     */
+    std::vector<KeyCount> big;
+
+    /**
+     * @brief Accesses seen, sampled or not
+     */
+    uint64_t accesses = 0;
+
+    /**
+     * @brief Samples since the last decay
+     */
+    uint64_t samples_since_decay = 0;
+
+    /**
+     * @brief Xorshift state deciding which accesses are sampled
+     *
+     * Random rather than every Nth access, so a client cycling through a
+     * fixed set of keys cannot line up with the sampling period.
+     */
+    uint64_t sample_state = 0x9e3779b97f4a7c15ULL;
+
+    /**
+     * @brief Adds one to a key's sketch counters
+     * @param key The key
+     * @return The key's new estimate
+     */
+    uint32_t addToSketch(const std::string& key);
+
+    /**
+     * @brief Halves every sketch counter and hot-key estimate
+     */
+    void decay();
+
+    /**
+     * @brief Inserts or updates a key in a min-heap limited to KEY_STATS_TOP_K entries
+     * @param heap The heap
+     * @param key The key
+     * @param count The key's count
+     */
+    static void offer(std::vector<KeyCount>& heap, const std::string& key, uint64_t count);
+
+    /**
+     * @brief Copies a heap's entries, largest first
+     * @param heap The heap
+     * @param limit Maximum number of entries
+     * @return The entries
+     */
+    static std::vector<KeyCount> sorted(const std::vector<KeyCount>& heap, size_t limit);
+
+public:
+    /**
+     * @brief Constructor
+     */
+    KeyStats();
+
+    /**
+     * @brief Records a read or write of a key
+     * @param key The key
+     */
+    void recordAccess(const std::string& key);
+
+    /**
+     * @brief Records the value size written to a key
+     * @param key The key
+     * @param bytes Size of the new value
+     */
+    void recordWrite(const std::string& key, size_t bytes);
+
+    /**
+     * @brief Forgets a deleted key
+     * @param key The key
+     */
+    void recordDelete(const std::string& key);
+
+    /**
+     * @brief Most accessed keys
+     * @param limit Maximum number of keys
+     * @return Keys with their estimated recent access counts, hottest first
+     */
+    std::vector<KeyCount> hotKeys(size_t limit = KEY_STATS_TOP_K) const;
+
+    /**
+     * @brief Keys with the largest values
+     * @param limit Maximum number of keys
+     * @return Keys with their value sizes, largest first
+     */
+    std::vector<KeyCount> bigKeys(size_t limit = KEY_STATS_TOP_K) const;
+
+    /**
+     * @brief Number of accesses recorded
+     * @return Access count, sampled or not
+     */
+    uint64_t totalAccesses() const { return accesses; }
+};
+
+#endif // KEY_STATS_H
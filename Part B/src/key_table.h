@@ -0,0 +1,397 @@
+/**
+ * @file key_table.h
+ * @brief Header file for the BlinkDB key table with inline short keys
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#ifndef KEY_TABLE_H
+#define KEY_TABLE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include "huge_pages.h"
+
+#define INLINE_KEY_SIZE 24
+#define KEY_TABLE_MIN_SLOTS 16
+#define KEY_TABLE_BATCH_GROUP 16
+
+/**
+ * @struct KeyEntry
+ * @brief One key-value pair together with its LRU links
+ *
+ * Keys of up to INLINE_KEY_SIZE bytes are stored in the entry itself; longer
+ * keys spill to a separate heap allocation. The key's hash is kept so that
+ * comparisons can reject mismatches on hash and length before touching the
+ * key bytes, and so that the table can grow without rehashing keys.
+ */
+struct KeyEntry {
+    /**
+     * @brief Hash of the key
+     */
+    uint64_t hash = 0;
+
+    /**
+     * @brief Length of the key in bytes
+     */
+    uint32_t length = 0;
+
+    /**
+     * @brief Entry used more recently than this one, or KeyTable::NIL
+     */
+    uint32_t prev = 0;
+
+    /**
+     * @brief Entry used less recently than this one, or KeyTable::NIL
+     */
+    uint32_t next = 0;
+
+    /**
+     * @brief Key bytes, inline or on the heap depending on length
+     */
+    union {
+        char inline_key[INLINE_KEY_SIZE];
+        char* heap_key;
+    };
+
+    /**
+     * @brief The value
+     */
+    std::string value;
+
+    /**
+     * @brief Creates an entry holding a key
+     * @param key The key
+     * @param key_hash Hash of the key
+     * @param val The value
+     */
+    KeyEntry(std::string_view key, uint64_t key_hash, std::string val);
+
+    /**
+     * @brief Move constructor, takes over a spilled key
+     * @param other Entry to move from
+     */
+    KeyEntry(KeyEntry&& other) noexcept;
+
+    /**
+     * @brief Move assignment, takes over a spilled key
+     * @param other Entry to move from
+     * @return This entry
+     */
+    KeyEntry& operator=(KeyEntry&& other) noexcept;
+
+    KeyEntry(const KeyEntry&) = delete;
+    KeyEntry& operator=(const KeyEntry&) = delete;
+
+    /**
+     * @brief Destructor, frees a spilled key
+     */
+    ~KeyEntry();
+
+    /**
+     * @brief Checks whether the key lives outside the entry
+     * @return true for keys longer than INLINE_KEY_SIZE
+     */
+    bool spilled() const { return length > INLINE_KEY_SIZE; }
+
+    /**
+     * @brief Views the key
+     * @return The key bytes
+     */
+    std::string_view key() const {
+        return std::string_view(spilled() ? heap_key : inline_key, length);
+    }
+};
+
+/**
+ * @struct KeyTableMemory
+ * @brief Bytes used by a KeyTable, split by structure
+ */
+struct KeyTableMemory {
+    /**
+     * @brief Entry array, including freed entries and spare capacity
+     */
+    size_t entry_bytes = 0;
+
+    /**
+     * @brief Hash index: slot and tag arrays
+     */
+    size_t index_bytes = 0;
+
+    /**
+     * @brief Heap allocations of keys longer than INLINE_KEY_SIZE
+     */
+    size_t spilled_key_bytes = 0;
+
+    /**
+     * @brief Heap allocations of values too long for std::string's inline buffer
+     */
+    size_t value_heap_bytes = 0;
+
+    /**
+     * @brief Entries freed and awaiting reuse
+     */
+    size_t free_entries = 0;
+};
+
+/**
+ * @class KeyTable
+ * @brief Open-addressing hash table of key-value entries in LRU order
+ *
+ * Entries live in one dense array and are addressed by a stable index. The
+ * hash index is a power-of-two array of entry indices with linear probing,
+ * plus one tag byte per slot holding 7 bits of the hash, so most probes are
+ * settled by the tag array alone. The LRU order is a doubly linked list
+ * threaded through the entries, so a key is stored once instead of once
+ * per map and list.
+ *
+ * All three arrays come from HugePageAllocator, so at large sizes they can
+ * be backed by 2 MB pages and lookups spend fewer cycles on TLB misses.
+ */
+class KeyTable {
+public:
+    /**
+     * @brief Entry index meaning "no entry"
+     */
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+private:
+    /**
+     * @brief Tag byte per slot, 0 when the slot is empty
+     */
+    std::vector<uint8_t, HugePageAllocator<uint8_t>> tags;
+
+    /**
+     * @brief Entry index per slot
+     */
+    std::vector<uint32_t, HugePageAllocator<uint32_t>> slots;
+
+    /**
+     * @brief Entry storage, including freed entries awaiting reuse
+     */
+    std::vector<KeyEntry, HugePageAllocator<KeyEntry>> entries;
+
+    /**
+     * @brief Indices of freed entries
+     */
+    std::vector<uint32_t> free_entries;
+
+    /**
+     * @brief Number of live entries
+     */
+    size_t count = 0;
+
+    /**
+     * @brief Most recently used entry
+     */
+    uint32_t head = NIL;
+
+    /**
+     * @brief Least recently used entry
+     */
+    uint32_t tail = NIL;
+
+    /**
+     * @brief Computes the tag byte of a hash
+     * @param hash The hash
+     * @return Tag with the occupied bit set
+     */
+    static uint8_t tagOf(uint64_t hash) {
+        return static_cast<uint8_t>(0x80 | (hash >> 57));
+    }
+
+    /**
+     * @brief Hashes a key
+     * @param key The key
+     * @return 64-bit hash
+     */
+    static uint64_t hashOf(std::string_view key);
+
+    /**
+     * @brief Finds the slot holding a key
+     * @param key The key
+     * @param hash Hash of the key
+     * @return Slot index, or slots.size() if the key is not present
+     */
+    size_t findSlot(std::string_view key, uint64_t hash) const;
+    
+    /**
+     * @brief Finds the slot holding a key, resuming a probe part way
+     * @param key The key
+     * @param hash Hash of the key
+     * @param start Slot to continue probing from, within the key's probe run
+     * @return Slot index, or slots.size() if the key is not present
+     */
+    size_t findSlotFrom(std::string_view key, uint64_t hash, size_t start) const;
+
+    /**
+     * @brief Places an entry index in the first free slot of its probe run
+     * @param entry Entry index
+     */
+    void placeEntry(uint32_t entry);
+
+    /**
+     * @brief Rebuilds the hash index with a new number of slots
+     * @param size Slot count, a power of two
+     */
+    void rehash(size_t size);
+
+    /**
+     * @brief Removes an entry from the LRU list
+     * @param entry Entry index
+     */
+    void unlink(uint32_t entry);
+
+    /**
+     * @brief Inserts an entry at the most recently used end of the LRU list
+     * @param entry Entry index
+     */
+    void linkFront(uint32_t entry);
+
+public:
+    /**
+     * @brief Constructor
+     */
+    KeyTable();
+
+    /**
+     * @brief Looks up a key
+     * @param key The key
+     * @return Entry index, or NIL if the key is not present
+     */
+    uint32_t find(std::string_view key) const;
+
+    /**
+     * @brief Looks up many keys, overlapping their cache misses
+     * @param keys The keys
+     * @param n Number of keys
+     * @param out Entry index per key, NIL for keys that are not present
+     *
+     * Keys are processed in groups of KEY_TABLE_BATCH_GROUP. Each group is
+     * hashed and its home slots prefetched, then each key's first candidate
+     * entry is prefetched, and only then are keys compared, so the memory
+     * accesses of a whole group are in flight together instead of one
+     * dependent miss after another.
+     */
+    void findBatch(const std::string_view* keys, size_t n, uint32_t* out) const;
+    
+    /**
+     * @brief Prepares the table for a number of entries
+     * @param n Expected number of entries
+     */
+    void reserve(size_t n);
+    
+    /**
+     * @brief Adds a key that is not yet present as the most recently used entry
+     * @param key The key
+     * @param value The value
+     * @return Entry index
+     */
+    uint32_t insert(std::string_view key, std::string value);
+
+    /**
+     * @brief Removes an entry
+     * @param entry Entry index
+     */
+    void erase(uint32_t entry);
+
+    /**
+     * @brief Marks an entry as most recently used
+     * @param entry Entry index
+     */
+    void touch(uint32_t entry);
+
+    /**
+     * @brief Least recently used entry
+     * @return Entry index, or NIL if the table is empty
+     */
+    uint32_t leastRecent() const { return tail; }
+
+    /**
+     * @brief Key of an entry
+     * @param entry Entry index
+     * @return The key bytes
+     */
+    std::string_view key(uint32_t entry) const { return entries[entry].key(); }
+
+    /**
+     * @brief Value of an entry
+     * @param entry Entry index
+     * @return Reference to the value
+     */
+    std::string& value(uint32_t entry) { return entries[entry].value; }
+
+    /**
+     * @brief Value of an entry
+     * @param entry Entry index
+     * @return Reference to the value
+     */
+    const std::string& value(uint32_t entry) const { return entries[entry].value; }
+
+    /**
+     * @brief Number of entries
+     * @return Entry count
+     */
+    size_t size() const { return count; }
+
+    /**
+     * @brief Bytes attributable to one entry
+     * @param entry Entry index
+     * @return The entry, its share of the hash index, and its key and value heap allocations
+     */
+    size_t entryMemory(uint32_t entry) const;
+    
+    /**
+     * @brief Bytes used by the table, split by structure
+     * @return Memory breakdown, computed by walking every entry
+     */
+    KeyTableMemory memory() const;
+    
+    /**
+     * @brief Picks a pseudo-random entry
+     * @param random A random number
+     * @return Entry index, or NIL if the table is empty
+     *
+     * Takes the first occupied slot at or after a random slot, so entries
+     * that follow long empty stretches are slightly favoured. That bias is
+     * fine for sampling.
+     */
+    uint32_t randomEntry(uint64_t random) const;
+    
+    /**
+     * @brief Number of hash slots, the range of scan() cursors
+     * @return Slot count
+     */
+    size_t bucketCount() const { return slots.size(); }
+
+    /**
+     * @brief Collects the keys whose home slot is in a range
+     * @param cursor First home slot to visit
+     * @param count Approximate number of keys to return
+     * @param keys Output vector the keys are appended to
+     * @return Next home slot to visit, 0 once every slot was visited
+     *
+     * Keys are grouped by home slot rather than the slot they ended up in,
+     * so deletions that shift entries back never hide a key from a running
+     * scan. The table only grows, and growth splits home slot b into b and
+     * b + old size, so a key can at worst be returned twice.
+     */
+    size_t scan(size_t cursor, size_t count, std::vector<std::string>& keys) const;
+
+    /**
+     * @brief Calls a function for every entry, least recently used first
+     * @param fn Called with the key and value of each entry
+     *
+     * Inserting the entries again in this order reproduces the LRU order.
+     */
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (uint32_t e = tail; e != NIL; e = entries[e].prev) {
+            fn(entries[e].key(), entries[e].value);
+        }
+    }
+};
+
+#endif // KEY_TABLE_H
@@ -0,0 +1,275 @@
+/**
+ * @file latency_bench.cpp
+ * @brief Loopback request latency of blink_server with the blocking and busy-poll event loops
+ * @author Madhumita
+ * @date 2025-03-31
+ *
+ * Starts blink_server twice, first with its default blocking event loop and
+ * then in busy-poll mode pinned to a core, and times GETs from a single
+ * pinned client connection over loopback, one request in flight at a time.
+ * Requests are sent back to back and with idle gaps in between; the gaps
+ * are where a blocking loop goes to sleep and pays for the wakeup. Reports
+ * p50/p99/p999 latency and the server's CPU use in each mode.
+ *
+ * Each server runs in a fresh temporary directory, so its snapshot file
+ * doesn't touch one in the current directory.
+ *
+ * Compilation: g++ -std=c++17 -O2 latency_bench.cpp bench_util.cpp busy_poll.cpp resp.cpp -o latency_bench -lpthread
+ * Execution: ./latency_bench [-n requests] [-g gap_us,...] [-s server_cpu] [-c client_cpu] [-I idle_us]
+ *            [-j output.json]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bench_util.h"
+#include "busy_poll.h"
+#include "resp.h"
+
+#define SERVER_PORT 9001
+#define DEFAULT_REQUESTS 20000
+#define VALUE_SIZE 64
+#define WARMUP_FRACTION 0.1  // Share of each run left out of the measurements
+
+/**
+ * @struct LatencyResult
+ * @brief Measurements of one mode at one gap
+ */
+struct LatencyResult {
+    std::string mode;
+    int gap_us;
+    size_t requests;
+    double p50_us;
+    double p99_us;
+    double p999_us;
+    double mean_us;
+    double server_cpu;   // Server CPU time over wall time, 1.0 is one full core
+};
+
+/**
+ * @brief Sends one command and reads its whole reply
+ * @param fd Server connection
+ * @param request Encoded command
+ * @param input Buffer for reply bytes, emptied on return
+ * @return true if a reply arrived
+ */
+static bool roundTrip(int fd, const std::string& request, std::string& input) {
+    if (write(fd, request.data(), request.size()) != static_cast<ssize_t>(request.size())) {
+        return false;
+    }
+    char buffer[4096];
+    RespValue reply;
+    while (true) {
+        size_t pos = 0;
+        ParseResult result = RespCodec::decodeReply(input, pos, reply);
+        if (result == ParseResult::COMPLETE) {
+            input.erase(0, pos);
+            return true;
+        }
+        if (result == ParseResult::INVALID) {
+            return false;
+        }
+        ssize_t bytes = read(fd, buffer, sizeof(buffer));
+        if (bytes <= 0) {
+            return false;
+        }
+        input.append(buffer, bytes);
+    }
+}
+
+/**
+ * @brief Times GETs against a running server
+ * @param fd Server connection
+ * @param requests Number of GETs
+ * @param gap_us Idle time between a reply and the next request
+ * @param latencies Output latencies in microseconds, warmup left out
+ * @return true if every request was answered
+ */
+static bool timeRequests(int fd, size_t requests, int gap_us, std::vector<double>& latencies) {
+    std::string get;
+    RespCodec::appendCommand(get, {"GET", "bench:key"});
+    std::string input;
+    size_t warmup = static_cast<size_t>(requests * WARMUP_FRACTION);
+    latencies.clear();
+    for (size_t i = 0; i < requests; i++) {
+        if (gap_us > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(gap_us));
+        }
+        auto start = std::chrono::steady_clock::now();
+        if (!roundTrip(fd, get, input)) {
+            return false;
+        }
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        if (i >= warmup) {
+            latencies.push_back(us);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Runs one server mode at every gap
+ * @param server Absolute path of the blink_server binary
+ * @param mode Name of the mode
+ * @param args Server arguments selecting the mode
+ * @param requests GETs per gap
+ * @param gaps Idle gaps to measure, in microseconds
+ * @param results Output, one entry per gap
+ * @return true on success
+ */
+static bool runMode(const std::string& server, const std::string& mode, const std::vector<std::string>& args,
+                    size_t requests, const std::vector<int>& gaps, std::vector<LatencyResult>& results) {
+    pid_t pid = benchSpawn(server, args, "latency_bench");
+    int fd = (pid > 0) ? benchWaitForPort(SERVER_PORT) : -1;
+    std::string input;
+    std::string set;
+    RespCodec::appendCommand(set, {"SET", "bench:key", std::string(VALUE_SIZE, 'v')});
+    bool ok = fd >= 0 && roundTrip(fd, set, input);
+
+    for (size_t g = 0; ok && g < gaps.size(); g++) {
+        std::vector<double> latencies;
+        unsigned long long ticks_before = benchCpuTicks(pid);
+        auto start = std::chrono::steady_clock::now();
+        ok = timeRequests(fd, requests, gaps[g], latencies);
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double cpu = (benchCpuTicks(pid) - ticks_before) / static_cast<double>(sysconf(_SC_CLK_TCK));
+
+        double sum = 0;
+        for (double us : latencies) {
+            sum += us;
+        }
+        LatencyResult r = {mode, gaps[g], latencies.size(), 0, 0, 0,
+                           latencies.empty() ? 0 : sum / latencies.size(), wall > 0 ? cpu / wall : 0};
+        r.p50_us = benchPercentile(latencies, 0.5);
+        r.p99_us = benchPercentile(latencies, 0.99);
+        r.p999_us = benchPercentile(latencies, 0.999);
+        results.push_back(r);
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (pid > 0) {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+    if (!ok) {
+        std::cerr << "Error: " << mode << " run failed; is another server on port " << SERVER_PORT << "?" << std::endl;
+    }
+    return ok;
+}
+
+/**
+ * @brief Writes all results as JSON
+ * @param path Output file
+ * @param results The results
+ */
+static void writeJson(const std::string& path, const std::vector<LatencyResult>& results) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Error: cannot write " << path << std::endl;
+        return;
+    }
+    out << "{\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const LatencyResult& r = results[i];
+        out << (i ? "," : "") << "\n    {\"mode\": \"" << r.mode << "\", \"gap_us\": " << r.gap_us
+            << ", \"requests\": " << r.requests << ", \"p50_us\": " << r.p50_us << ", \"p99_us\": " << r.p99_us
+            << ", \"p999_us\": " << r.p999_us << ", \"mean_us\": " << r.mean_us
+            << ", \"server_cpu\": " << r.server_cpu << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+/**
+ * @brief Main function
+ * @param argc Number of command-line arguments
+ * @param argv Array of command-line arguments
+ * @return Exit code
+ */
+int main(int argc, char* argv[]) {
+    size_t requests = DEFAULT_REQUESTS;
+    std::vector<int> gaps = {0, 200};
+    int cpus = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    int server_cpu = cpus - 1;
+    int client_cpu = 0;
+    int idle_us = BUSY_POLL_DEFAULT_IDLE_US;
+    std::string json_path;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc) {
+            requests = std::stoull(argv[++i]);
+        } else if (arg == "-g" && i + 1 < argc) {
+            gaps.clear();
+            std::stringstream list(argv[++i]);
+            std::string gap;
+            while (std::getline(list, gap, ',')) {
+                gaps.push_back(std::stoi(gap));
+            }
+        } else if (arg == "-s" && i + 1 < argc) {
+            server_cpu = std::stoi(argv[++i]);
+        } else if (arg == "-c" && i + 1 < argc) {
+            client_cpu = std::stoi(argv[++i]);
+        } else if (arg == "-I" && i + 1 < argc) {
+            idle_us = std::stoi(argv[++i]);
+        } else if (arg == "-j" && i + 1 < argc) {
+            json_path = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [-n requests] [-g gap_us,...] [-s server_cpu] [-c client_cpu]"
+                      << " [-I idle_us] [-j output.json]" << std::endl;
+            return 1;
+        }
+    }
+
+    char server[PATH_MAX];
+    if (!realpath("./blink_server", server)) {
+        std::cerr << "Error: run from the directory holding blink_server" << std::endl;
+        return 1;
+    }
+    if (server_cpu == client_cpu) {
+        std::cerr << "Warning: server and client share CPU " << client_cpu
+                  << "; a spinning server then delays the client and busy polling can only lose" << std::endl;
+    }
+    CpuAffinity::pin(client_cpu);
+
+    std::vector<LatencyResult> results;
+    if (!runMode(server, "blocking", {}, requests, gaps, results) ||
+        !runMode(server, "busy-poll", {"-B", std::to_string(server_cpu), "-I", std::to_string(idle_us)},
+                 requests, gaps, results)) {
+        return 1;
+    }
+
+    std::printf("%7s  %-10s %9s %9s %9s %9s %11s\n", "gap us", "mode", "p50 us", "p99 us", "p999 us", "mean us",
+                "server CPU");
+    for (int gap : gaps) {
+        for (const LatencyResult& r : results) {
+            if (r.gap_us == gap) {
+                std::printf("%7d  %-10s %9.1f %9.1f %9.1f %9.1f %10.0f%%\n", r.gap_us, r.mode.c_str(), r.p50_us,
+                            r.p99_us, r.p999_us, r.mean_us, r.server_cpu * 100);
+            }
+        }
+    }
+
+    if (!json_path.empty()) {
+        writeJson(json_path, results);
+    }
+    return 0;
+}
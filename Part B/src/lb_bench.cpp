@@ -0,0 +1,428 @@
+/**
+ * @file lb_bench.cpp
+ * @brief Benchmark of the load balancer's overhead against fake backends
+ * @author Madhumita
+ * @date 2025-03-31
+ *
+ * Starts two fake_backend processes and a load_balancer in front of them,
+ * then drives the same GET/SET load first straight at the backends and
+ * then through the balancer, at several connection counts.
+ * Reports the throughput of both, the p50/p99/p999 latency the proxy adds,
+ * the balancer's CPU time per request, its forked connection handlers
+ * included, and how many backend requests each client request cost, which
+ * is above 1 when the balancer hedges.
+ *
+ * Compilation: g++ -std=c++17 -O2 lb_bench.cpp bench_util.cpp resp.cpp -o lb_bench
+ * Execution: ./lb_bench [-c conns,...] [-t seconds] [-r requests_per_sec] [-w write_percent] [-k keys]
+ *            [-l "load_balancer options"] [-j output.json] [-- fake_backend options]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bench_util.h"
+#include "resp.h"
+
+#define LB_PORT 9300
+#define BACKEND_PORT_1 9301
+#define BACKEND_PORT_2 9302
+#define DEFAULT_KEY_SPACE 10000
+#define DEFAULT_WRITE_PERCENT 10
+#define WARMUP_FRACTION 0.1  // Share of each run left out of the measurements
+
+/**
+ * @brief Share of requests that are SETs, in percent; the rest are GETs
+ */
+static int write_percent = DEFAULT_WRITE_PERCENT;
+
+/**
+ * @brief Number of distinct keys; 1 sends every request to the same hot key
+ */
+static uint64_t key_space = DEFAULT_KEY_SPACE;
+
+/**
+ * @struct LoadResult
+ * @brief Measurements of one load run
+ */
+struct LoadResult {
+    size_t ops = 0;
+    size_t errors = 0;
+    double ops_per_sec = 0;
+    double p50_us = 0;
+    double p99_us = 0;
+    double p999_us = 0;
+    double cpu_us_per_op = 0;            // CPU of the watched process tree, if any
+    double backend_requests_per_op = 0;  // Requests the fake backends served per client request
+};
+
+/**
+ * @struct LoadConnection
+ * @brief State of one client connection of the load generator
+ */
+struct LoadConnection {
+    int fd = -1;
+    std::string input;
+    std::chrono::steady_clock::time_point sent;   // When the outstanding request was due
+    std::chrono::steady_clock::time_point next;   // When the next request is due, in paced runs
+    bool idle = false;                            // No request outstanding
+    uint64_t counter = 0;
+};
+
+/**
+ * @brief Waits until a local port accepts connections
+ * @param port The port
+ * @return true once connected, false after five seconds
+ */
+static bool portReady(int port) {
+    int fd = benchWaitForPort(port);
+    if (fd < 0) {
+        return false;
+    }
+    close(fd);
+    return true;
+}
+
+/**
+ * @brief Requests served so far by the fake backends
+ * @param ports Ports of the backends
+ * @return Sum of their INFO request counters
+ */
+static unsigned long long backendRequests(const std::vector<int>& ports) {
+    unsigned long long total = 0;
+    for (int port : ports) {
+        int fd = benchConnect(port);
+        if (fd < 0) {
+            continue;
+        }
+        std::string request;
+        RespCodec::appendCommand(request, {"INFO"});
+        std::string input;
+        char buffer[256];
+        size_t pos = 0;
+        RespValue reply;
+        ssize_t bytes = write(fd, request.data(), request.size());
+        while (bytes > 0 && RespCodec::decodeReply(input, pos, reply) == ParseResult::INCOMPLETE) {
+            bytes = read(fd, buffer, sizeof(buffer));
+            if (bytes > 0) {
+                input.append(buffer, bytes);
+            }
+            pos = 0;
+        }
+        if (reply.type == RespValue::BULK && reply.str.rfind("requests:", 0) == 0) {
+            total += std::stoull(std::string(reply.str.substr(9)));
+        }
+        close(fd);
+    }
+    return total;
+}
+
+/**
+ * @brief Sends the next request of a connection
+ * @param conn The connection
+ * @param value Value used by SETs
+ * @param due When the request was due; latency is counted from then
+ */
+static void sendRequest(LoadConnection& conn, const std::string& value, std::chrono::steady_clock::time_point due) {
+    std::string request;
+    std::string key = "key:" + std::to_string((conn.fd * 7919 + conn.counter * 104729) % key_space);
+    if (static_cast<int>(conn.counter % 100) < write_percent) {
+        RespCodec::appendCommand(request, {"SET", key, value});
+    } else {
+        RespCodec::appendCommand(request, {"GET", key});
+    }
+    conn.counter++;
+    conn.sent = due;
+    conn.idle = false;
+    if (write(conn.fd, request.data(), request.size()) != static_cast<ssize_t>(request.size())) {
+        std::cerr << "Error: short write to connection " << conn.fd << std::endl;
+    }
+}
+
+/**
+ * @brief Drives load with at most one outstanding request per connection
+ * @param ports Ports to connect to, assigned to connections round-robin
+ * @param conns Number of connections
+ * @param seconds Length of the run, warm-up included
+ * @param rate Requests per second over all connections, 0 for closed loop
+ * @param watch Process whose CPU time to attribute per request, or -1
+ * @param backends Ports of the fake backends, whose request counters are read
+ * @return The measurements
+ *
+ * Closed loop sends each connection's next request as soon as the reply
+ * arrives. Paced runs give each connection a fixed schedule and count
+ * latency from when a request was due, so a slow reply also charges the
+ * requests it held up, and the generator leaves CPU to the processes
+ * under test.
+ */
+static LoadResult runLoad(const std::vector<int>& ports, size_t conns, double seconds, double rate, pid_t watch,
+                          const std::vector<int>& backends) {
+    LoadResult result;
+    std::string value(16, 'v');
+    std::vector<LoadConnection> connections(conns);
+    int epoll_fd = epoll_create1(0);
+
+    for (size_t i = 0; i < conns; i++) {
+        connections[i].fd = benchConnect(ports[i % ports.size()]);
+        if (connections[i].fd < 0) {
+            std::cerr << "Error: cannot connect to port " << ports[i % ports.size()] << std::endl;
+            conns = i;
+            connections.resize(i);
+            break;
+        }
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = i;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, connections[i].fd, &event);
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(rate > 0 ? conns / rate : 0));
+    for (size_t i = 0; i < conns; i++) {
+        if (rate > 0) {
+            // Spread the connections' schedules over one interval
+            connections[i].next = start + interval * i / conns;
+            connections[i].idle = true;
+        } else {
+            sendRequest(connections[i], value, start);
+        }
+    }
+
+    auto measure_from = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                    std::chrono::duration<double>(seconds * WARMUP_FRACTION));
+    auto end = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                           std::chrono::duration<double>(seconds));
+    bool measuring = false;
+    unsigned long long cpu_start = 0;
+    unsigned long long backend_start = 0;
+    std::vector<double> latencies;
+    std::vector<epoll_event> events(std::max<size_t>(conns, 1));
+    char buffer[16384];
+
+    while (conns > 0) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= end) {
+            break;
+        }
+        if (!measuring && now >= measure_from) {
+            measuring = true;
+            cpu_start = watch > 0 ? benchCpuTicks(watch, true) : 0;
+            backend_start = backendRequests(backends);
+            measure_from = now;
+        }
+
+        // Send paced requests that are due and sleep until the next one is
+        auto wake = now + std::chrono::milliseconds(100);
+        for (LoadConnection& conn : connections) {
+            if (!conn.idle) continue;
+            if (conn.next <= now) {
+                sendRequest(conn, value, conn.next);
+            } else {
+                wake = std::min(wake, conn.next);
+            }
+        }
+        long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(wake - now).count();
+        timespec timeout = {static_cast<time_t>(ns / 1000000000), static_cast<long>(ns % 1000000000)};
+        int count = epoll_pwait2(epoll_fd, events.data(), events.size(), &timeout, nullptr);
+        for (int i = 0; i < count; i++) {
+            LoadConnection& conn = connections[events[i].data.u64];
+            ssize_t bytes = read(conn.fd, buffer, sizeof(buffer));
+            if (bytes <= 0) {
+                continue;
+            }
+            conn.input.append(buffer, bytes);
+
+            size_t pos = 0;
+            RespValue reply;
+            if (RespCodec::decodeReply(conn.input, pos, reply) != ParseResult::COMPLETE) {
+                continue;
+            }
+            auto done = std::chrono::steady_clock::now();
+            if (measuring) {
+                latencies.push_back(std::chrono::duration<double, std::micro>(done - conn.sent).count());
+                if (reply.type == RespValue::ERROR) {
+                    result.errors++;
+                }
+            }
+            conn.input.erase(0, pos);
+            if (rate > 0) {
+                conn.next = conn.sent + interval;
+                conn.idle = true;
+                if (conn.next <= done) {
+                    sendRequest(conn, value, conn.next);
+                }
+            } else {
+                sendRequest(conn, value, done);
+            }
+        }
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - measure_from).count();
+    if (watch > 0 && measuring) {
+        double ticks = static_cast<double>(benchCpuTicks(watch, true) - cpu_start);
+        result.cpu_us_per_op = latencies.empty() ? 0 : ticks * 1e6 / sysconf(_SC_CLK_TCK) / latencies.size();
+    }
+    if (measuring && !latencies.empty()) {
+        // Replies still in flight at the end were sent but not counted, hence the small excess
+        double served = static_cast<double>(backendRequests(backends) - backend_start);
+        result.backend_requests_per_op = served / latencies.size();
+    }
+    for (LoadConnection& conn : connections) {
+        close(conn.fd);
+    }
+    close(epoll_fd);
+
+    result.ops = latencies.size();
+    result.ops_per_sec = measuring ? result.ops / elapsed : 0;
+    result.p50_us = benchPercentile(latencies, 0.5);
+    result.p99_us = benchPercentile(latencies, 0.99);
+    result.p999_us = benchPercentile(latencies, 0.999);
+    return result;
+}
+
+/**
+ * @brief Writes all results as JSON
+ * @param path Output file
+ * @param conn_counts Connection count of each result pair
+ * @param direct Results straight against the backends
+ * @param proxied Results through the load balancer
+ */
+static void writeJson(const std::string& path, const std::vector<size_t>& conn_counts,
+                      const std::vector<LoadResult>& direct, const std::vector<LoadResult>& proxied) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Error: cannot write " << path << std::endl;
+        return;
+    }
+    out << "{\n  \"results\": [";
+    for (size_t i = 0; i < conn_counts.size(); i++) {
+        const LoadResult& d = direct[i];
+        const LoadResult& p = proxied[i];
+        out << (i ? "," : "") << "\n    {\"connections\": " << conn_counts[i]
+            << ", \"direct_ops_per_sec\": " << d.ops_per_sec << ", \"proxied_ops_per_sec\": " << p.ops_per_sec
+            << ", \"direct_p50_us\": " << d.p50_us << ", \"direct_p99_us\": " << d.p99_us
+            << ", \"proxied_p50_us\": " << p.p50_us << ", \"proxied_p99_us\": " << p.p99_us
+            << ", \"direct_p999_us\": " << d.p999_us << ", \"proxied_p999_us\": " << p.p999_us
+            << ", \"added_p50_us\": " << p.p50_us - d.p50_us << ", \"added_p99_us\": " << p.p99_us - d.p99_us
+            << ", \"added_p999_us\": " << p.p999_us - d.p999_us
+            << ", \"proxy_cpu_us_per_request\": " << p.cpu_us_per_op
+            << ", \"backend_requests_per_request\": " << p.backend_requests_per_op
+            << ", \"direct_errors\": " << d.errors << ", \"proxied_errors\": " << p.errors << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+/**
+ * @brief Main function
+ * @param argc Number of command-line arguments
+ * @param argv Array of command-line arguments
+ * @return Exit code
+ *
+ * Everything after "--" is passed to both fake backends, so the same run
+ * can be repeated with injected latency, errors or stalls; -l passes
+ * options such as a timeout or hedging to the load balancer.
+ */
+int main(int argc, char* argv[]) {
+    std::vector<size_t> conn_counts = {1, 10, 50, 100};
+    double seconds = 5;
+    double rate = 0;
+    std::string json_path;
+    std::vector<std::string> backend_options;
+    std::vector<std::string> balancer_options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-c" && i + 1 < argc) {
+            conn_counts.clear();
+            std::stringstream list(argv[++i]);
+            std::string count;
+            while (std::getline(list, count, ',')) {
+                conn_counts.push_back(std::stoull(count));
+            }
+        } else if (arg == "-t" && i + 1 < argc) {
+            seconds = std::stod(argv[++i]);
+        } else if (arg == "-w" && i + 1 < argc) {
+            write_percent = std::stoi(argv[++i]);
+        } else if (arg == "-k" && i + 1 < argc && std::stoull(argv[i + 1]) > 0) {
+            key_space = std::stoull(argv[++i]);
+        } else if (arg == "-r" && i + 1 < argc) {
+            rate = std::stod(argv[++i]);
+        } else if (arg == "-l" && i + 1 < argc) {
+            std::istringstream options(argv[++i]);
+            std::string option;
+            while (options >> option) {
+                balancer_options.push_back(option);
+            }
+        } else if (arg == "-j" && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (arg == "--") {
+            backend_options.assign(argv + i + 1, argv + argc);
+            break;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [-c conns,...] [-t seconds] [-r requests_per_sec] [-w write_percent]"
+                      << " [-k keys] [-l \"load_balancer options\"] [-j output.json] [-- fake_backend options]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<pid_t> children;
+    for (int port : {BACKEND_PORT_1, BACKEND_PORT_2}) {
+        std::vector<std::string> args = {"-p", std::to_string(port)};
+        args.insert(args.end(), backend_options.begin(), backend_options.end());
+        children.push_back(benchSpawn("./fake_backend", args));
+    }
+    std::vector<std::string> balancer_args = {std::to_string(LB_PORT),
+                                              "127.0.0.1", std::to_string(BACKEND_PORT_1),
+                                              "127.0.0.1", std::to_string(BACKEND_PORT_2)};
+    balancer_args.insert(balancer_args.end(), balancer_options.begin(), balancer_options.end());
+    pid_t balancer = benchSpawn("./load_balancer", balancer_args);
+    children.push_back(balancer);
+
+    int status = 0;
+    if (!portReady(BACKEND_PORT_1) || !portReady(BACKEND_PORT_2) || !portReady(LB_PORT)) {
+        std::cerr << "Error: fake backends or load balancer did not start" << std::endl;
+        status = 1;
+    } else {
+        std::vector<LoadResult> direct, proxied;
+        std::vector<int> backends = {BACKEND_PORT_1, BACKEND_PORT_2};
+        std::printf("%6s %11s %11s %23s %23s %23s %12s %8s\n", "conns", "direct op/s", "proxy op/s",
+                    "direct p50/p99/p999 us", "proxy p50/p99/p999 us", "added p50/p99/p999 us", "proxy CPU", "backend");
+        for (size_t conns : conn_counts) {
+            direct.push_back(runLoad(backends, conns, seconds, rate, -1, backends));
+            proxied.push_back(runLoad({LB_PORT}, conns, seconds, rate, balancer, backends));
+            const LoadResult& d = direct.back();
+            const LoadResult& p = proxied.back();
+            std::printf("%6zu %11.0f %11.0f %7.0f/%7.0f/%7.0f %7.0f/%7.0f/%7.0f %7.0f/%7.0f/%7.0f %6.2f us/req %6.3fx\n",
+                        conns, d.ops_per_sec, p.ops_per_sec, d.p50_us, d.p99_us, d.p999_us,
+                        p.p50_us, p.p99_us, p.p999_us, p.p50_us - d.p50_us, p.p99_us - d.p99_us,
+                        p.p999_us - d.p999_us, p.cpu_us_per_op, p.backend_requests_per_op);
+            if (d.errors || p.errors) {
+                std::printf("%6s error replies: %zu direct, %zu proxied\n", "", d.errors, p.errors);
+            }
+        }
+        if (!json_path.empty()) {
+            writeJson(json_path, conn_counts, direct, proxied);
+        }
+    }
+
+    for (pid_t child : children) {
+        kill(child, SIGTERM);
+        waitpid(child, nullptr, 0);
+    }
+    return status;
+}
@@ -6,26 +6,537 @@
  * 
  * This file implements a load balancer that distributes client connections
  * between multiple BlinkDB server instances using a round-robin algorithm.
+ * Connections are proxied request by request, so slow requests can be
+ * timed out and, when the backends hold the same data, reads can be hedged
+ * to the other backend. Alternatively the backends can split the key space,
+ * with requests routed by key and reads of hot keys spread over a read copy
+ * on the other backend.
  */
  
 #include <iostream>
 #include <vector>
+#include <deque>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <functional>
 #include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
 #include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <poll.h>
 #include <fcntl.h>
+#include "resp.h"
+#include "trace.h"
+
+#define LATENCY_BUCKETS 256
+#define LATENCY_DECAY_EVERY 16384
+#define HEDGE_PERCENTILE 0.95
+#define HEDGE_MIN_SAMPLES 100
+#define HEDGE_MIN_DELAY_US 50
+#define HEDGE_REFRESH_EVERY 64
+#define HEDGE_BURST 100
+#define RING_POINTS_PER_BACKEND 64
+#define HOT_KEY_SLOTS 16
+#define HOT_KEY_MAX_LENGTH 64
+#define HOT_SKETCH_DEPTH 4
+#define HOT_SKETCH_WIDTH 4096
+#define HOT_SAMPLE_RATE 8
+#define HOT_DECAY_INTERVAL 100000
+#define HOT_MIN_SHARE 0.01
+#define HOT_MIN_COUNT 32
+#define HOT_EPOCH_BUCKETS 4096
+#define HOT_COPY_LEASE_US 1000000
+#define COPY_EPOCH_MASK ((1ULL << 48) - 1)
+#define COPY_REQUEST (1ULL << 63)
+
+/**
+ * @brief Set by SIGUSR1, asks every process to write its trace
+ */
+static volatile sig_atomic_t trace_dump_requested = 0;
+
+/**
+ * @brief SIGUSR1 handler
+ * @param signal Signal number
+ */
+static void requestTraceDump(int signal) {
+    (void)signal;
+    trace_dump_requested = 1;
+}
+
+/**
+ * @brief Writes this process's trace to lb_trace_<pid>.json
+ */
+static void dumpTrace() {
+    std::string path = "lb_trace_" + std::to_string(getpid()) + ".json";
+    if (!Tracer::dumpToFile(path)) {
+        std::cerr << "Failed to write " << path << std::endl;
+    }
+}
+
+/**
+ * @struct LatencyHistogram
+ * @brief Backend reply latencies seen by every connection process
+ *
+ * Part of SharedProxyState, so all connection processes record into and
+ * read from one distribution. Buckets are exact
+ * below 16 us and eight per power of two above. All counts are halved
+ * every LATENCY_DECAY_EVERY samples so the distribution follows the
+ * backends' recent behaviour; concurrent updates during a halving may be
+ * lost, which is fine for an estimate.
+ */
+struct LatencyHistogram {
+    std::atomic<uint32_t> buckets[LATENCY_BUCKETS];
+    std::atomic<uint64_t> recorded;
+
+    /**
+     * @brief Bucket of a latency
+     * @param us Latency in microseconds
+     * @return Bucket index
+     */
+    static size_t bucketOf(uint64_t us) {
+        if (us < 16) {
+            return us;
+        }
+        int msb = 63 - __builtin_clzll(us);
+        size_t index = 16 + (msb - 4) * 8 + ((us >> (msb - 3)) & 7);
+        return std::min<size_t>(index, LATENCY_BUCKETS - 1);
+    }
+
+    /**
+     * @brief Upper bound of a bucket
+     * @param index Bucket index
+     * @return Smallest latency in microseconds above the bucket
+     */
+    static uint64_t bucketLimit(size_t index) {
+        if (index < 16) {
+            return index + 1;
+        }
+        int msb = static_cast<int>(index - 16) / 8 + 4;
+        return (9 + (index - 16) % 8) << (msb - 3);
+    }
+
+    /**
+     * @brief Adds one latency
+     * @param us Latency in microseconds
+     */
+    void record(uint64_t us) {
+        buckets[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+        if ((recorded.fetch_add(1, std::memory_order_relaxed) + 1) % LATENCY_DECAY_EVERY == 0) {
+            for (auto& bucket : buckets) {
+                bucket.store(bucket.load(std::memory_order_relaxed) / 2, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Latency at a percentile
+     * @param p Percentile between 0 and 1
+     * @return Upper bound of the bucket holding it, or 0 with fewer than HEDGE_MIN_SAMPLES samples
+     */
+    uint64_t percentile(double p) const {
+        uint64_t total = 0;
+        for (const auto& bucket : buckets) {
+            total += bucket.load(std::memory_order_relaxed);
+        }
+        if (total < HEDGE_MIN_SAMPLES) {
+            return 0;
+        }
+        uint64_t seen = 0;
+        for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen >= p * total) {
+                return bucketLimit(i);
+            }
+        }
+        return bucketLimit(LATENCY_BUCKETS - 1);
+    }
+};
+
+/**
+ * @struct HedgeBudget
+ * @brief Token bucket limiting hedges over all connection processes
+ *
+ * Every hedgeable read earns hedge_percent hundredths of a hedge, up to
+ * HEDGE_BURST hedges, and every hedge spends one, so hedging adds at most
+ * hedge_percent percent to the read load in the long run while a stalled
+ * backend can still draw on credit earned by every connection. Lives in
+ * the same shared memory as the latency histogram.
+ */
+struct HedgeBudget {
+    std::atomic<int64_t> credit;   // In thousandths of a hedge
+
+    /**
+     * @brief Earns credit for one hedgeable read
+     * @param percent Hedges allowed per hundred reads
+     */
+    void earn(double percent) {
+        int64_t earned = static_cast<int64_t>(percent * 10);
+        int64_t current = credit.load(std::memory_order_relaxed);
+        while (current < HEDGE_BURST * 1000 &&
+               !credit.compare_exchange_weak(current, std::min<int64_t>(current + earned, HEDGE_BURST * 1000),
+                                             std::memory_order_relaxed)) {
+        }
+    }
+
+    /**
+     * @brief Takes the credit for one hedge
+     * @return true if there was enough credit
+     */
+    bool spend() {
+        int64_t current = credit.load(std::memory_order_relaxed);
+        while (current >= 1000) {
+            if (credit.compare_exchange_weak(current, current - 1000, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/**
+ * @struct HotKeySlot
+ * @brief A hot key whose reads are spread over a read copy
+ *
+ * The key is rewritten in place when the slot changes hands, so readers
+ * check hash before and after comparing it, seqlock style; hash is 0 while
+ * the slot is empty or being rewritten. copy holds the slot's generation in
+ * its top 16 bits and, below, the key's write epoch when the read copy on
+ * the other backend was made: the copy is current while that still equals
+ * the key's write epoch.
+ */
+struct HotKeySlot {
+    std::atomic<uint64_t> hash;
+    std::atomic<uint32_t> length;
+    std::atomic<uint32_t> estimate;      // Sampled reads, halved with the sketch
+    std::atomic<uint64_t> copy;
+    std::atomic<int64_t> lease_until_us;  // A read copy is being made until then
+    char key[HOT_KEY_MAX_LENGTH];
+};
+
+/**
+ * @struct HotKeyDirectory
+ * @brief Hot keys and their read copies, shared by all connection processes
+ *
+ * Detection works like the server's KeyStats: one read in HOT_SAMPLE_RATE
+ * feeds a count-min sketch, halved every HOT_DECAY_INTERVAL samples, and a
+ * key whose estimate reaches HOT_MIN_SHARE of the recent samples takes the
+ * slot of the coolest key in the table. Here the counters are atomics in
+ * shared memory, so every connection process adds to the same counts.
+ *
+ * Writes advance the write epoch of the key's bucket when sent and again
+ * when answered, so a copy made from a read that overlapped a write never
+ * counts as current. One process at a time makes a slot's copy, under a
+ * lease, so copies of different epochs don't overwrite each other.
+ *
+ * A copy stored on the other backend either becomes current or is deleted
+ * again by the process that stored it. Writes to a hot key and a key
+ * losing its slot delete the copy too. Deleting a copy advances the epoch
+ * like a write, so no reader is sent to a copy that is going away.
+ */
+struct HotKeyDirectory {
+    std::atomic<uint32_t> sketch[HOT_SKETCH_DEPTH * HOT_SKETCH_WIDTH];
+    std::atomic<uint64_t> samples;          // Since the last decay
+    std::atomic<uint64_t> write_epochs[HOT_EPOCH_BUCKETS];
+    std::atomic<bool> promoting;            // Held while a slot changes hands
+    HotKeySlot slots[HOT_KEY_SLOTS];
+
+    /**
+     * @brief Hash used for the sketch, the epochs and the slots
+     * @param key The key
+     * @return Non-zero hash
+     */
+    static uint64_t hashOf(std::string_view key) {
+        return std::hash<std::string_view>{}(key) | 1;
+    }
+
+    /**
+     * @brief Microseconds on the monotonic clock, the same in every process
+     * @return Current time
+     */
+    static int64_t nowUs() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * @brief Write epoch of a key
+     * @param hash The key's hash
+     * @return Counter advanced by every write to keys of its bucket
+     */
+    std::atomic<uint64_t>& writeEpoch(uint64_t hash) {
+        return write_epochs[(hash >> 32) % HOT_EPOCH_BUCKETS];
+    }
+
+    /**
+     * @brief Finds a key's slot
+     * @param key The key
+     * @param hash The key's hash
+     * @return Slot index, or -1 if the key isn't hot
+     */
+    int find(std::string_view key, uint64_t hash) const {
+        for (int i = 0; i < HOT_KEY_SLOTS; i++) {
+            const HotKeySlot& slot = slots[i];
+            if (slot.hash.load(std::memory_order_acquire) != hash) continue;
+            bool same = slot.length.load(std::memory_order_relaxed) == key.size() &&
+                        std::memcmp(slot.key, key.data(), key.size()) == 0;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (same && slot.hash.load(std::memory_order_relaxed) == hash) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    /**
+     * @brief Counts a sampled read and promotes the key if it has become hot
+     * @param key The key
+     * @param hash The key's hash
+     * @return The key that lost its slot to this one, whose copy must go, or empty
+     */
+    std::string recordRead(std::string_view key, uint64_t hash) {
+        uint32_t h1 = static_cast<uint32_t>(hash);
+        uint32_t h2 = static_cast<uint32_t>(hash >> 32) | 1;
+        uint32_t estimate = UINT32_MAX;
+        for (uint32_t row = 0; row < HOT_SKETCH_DEPTH; row++) {
+            auto& counter = sketch[row * HOT_SKETCH_WIDTH + (h1 + row * h2) % HOT_SKETCH_WIDTH];
+            estimate = std::min(estimate, counter.fetch_add(1, std::memory_order_relaxed) + 1);
+        }
+
+        uint64_t seen = samples.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (seen == HOT_DECAY_INTERVAL) {
+            // Concurrent increments during the halving may be lost, which is fine for an estimate
+            for (auto& counter : sketch) {
+                counter.store(counter.load(std::memory_order_relaxed) / 2, std::memory_order_relaxed);
+            }
+            for (HotKeySlot& slot : slots) {
+                slot.estimate.store(slot.estimate.load(std::memory_order_relaxed) / 2, std::memory_order_relaxed);
+            }
+            samples.fetch_sub(HOT_DECAY_INTERVAL / 2, std::memory_order_relaxed);
+        }
+        if (estimate < HOT_MIN_COUNT || estimate < HOT_MIN_SHARE * seen) {
+            return "";
+        }
+
+        int index = find(key, hash);
+        if (index >= 0) {
+            slots[index].estimate.store(estimate, std::memory_order_relaxed);
+            return "";
+        }
+        // Another process promoting a key is no reason to wait: this one is sampled again soon
+        if (key.size() > HOT_KEY_MAX_LENGTH || promoting.exchange(true, std::memory_order_acquire)) {
+            return "";
+        }
+        std::string demoted;
+        int victim = 0;
+        for (int i = 1; i < HOT_KEY_SLOTS; i++) {
+            if (slots[i].estimate.load(std::memory_order_relaxed) < slots[victim].estimate.load(std::memory_order_relaxed)) {
+                victim = i;
+            }
+        }
+        HotKeySlot& slot = slots[victim];
+        if (slot.estimate.load(std::memory_order_relaxed) < estimate && find(key, hash) < 0) {
+            // Slots only change hands under promoting, so the old key can be read as is
+            if (slot.hash.load(std::memory_order_relaxed) != 0) {
+                demoted.assign(slot.key, slot.length.load(std::memory_order_relaxed));
+            }
+            slot.hash.store(0, std::memory_order_relaxed);
+            // A new generation, so copies still being made for the old key are never marked current
+            uint64_t generation = (slot.copy.load(std::memory_order_relaxed) >> 48) + 1;
+            slot.copy.store((generation << 48) | COPY_EPOCH_MASK, std::memory_order_relaxed);
+            slot.lease_until_us.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.length.store(static_cast<uint32_t>(key.size()), std::memory_order_relaxed);
+            std::memcpy(slot.key, key.data(), key.size());
+            slot.estimate.store(estimate, std::memory_order_relaxed);
+            slot.hash.store(hash, std::memory_order_release);
+        }
+        promoting.store(false, std::memory_order_release);
+        return demoted;
+    }
+
+    /**
+     * @brief Checks whether a hot key's read copy is current
+     * @param slot The key's slot
+     * @param hash The key's hash
+     * @return true if reads may go to the copy
+     */
+    bool copyIsCurrent(int slot, uint64_t hash) {
+        uint64_t copy = slots[slot].copy.load(std::memory_order_acquire);
+        return (copy & COPY_EPOCH_MASK) == (writeEpoch(hash).load(std::memory_order_acquire) & COPY_EPOCH_MASK);
+    }
+
+    /**
+     * @brief Takes the lease for making a slot's read copy
+     * @param slot The slot
+     * @return The lease's end, which identifies it, or 0 if another process holds the lease
+     */
+    int64_t tryLease(int slot) {
+        int64_t now = nowUs();
+        int64_t until = slots[slot].lease_until_us.load(std::memory_order_relaxed);
+        int64_t lease = now + HOT_COPY_LEASE_US;
+        bool taken = until <= now && slots[slot].lease_until_us.compare_exchange_strong(
+                                         until, lease, std::memory_order_acquire);
+        return taken ? lease : 0;
+    }
+
+    /**
+     * @brief Marks a read copy current once the other backend has stored it
+     * @param slot The slot
+     * @param copy The slot's copy word when the value was read
+     * @param epoch The key's write epoch when the value was read
+     * @param hash The key's hash
+     * @param lease The lease taken for the copy
+     * @param stored Whether the other backend accepted the copy
+     * @return true if the copy is now current
+     *
+     * The copy only counts if no write to the key overlapped, the slot
+     * still holds the key and the lease has not run out in the meantime.
+     * A stored copy that doesn't count must be deleted, and keeps the lease
+     * until releaseAfterDrop(), so no other copy is made in between.
+     */
+    bool finishCopy(int slot, uint64_t copy, uint64_t epoch, uint64_t hash, int64_t lease, bool stored) {
+        HotKeySlot& target = slots[slot];
+        bool current = false;
+        if (stored && nowUs() < lease && target.lease_until_us.load(std::memory_order_relaxed) == lease &&
+            writeEpoch(hash).load(std::memory_order_acquire) == epoch) {
+            current = target.copy.compare_exchange_strong(
+                copy, (copy & ~COPY_EPOCH_MASK) | (epoch & COPY_EPOCH_MASK), std::memory_order_release);
+        }
+        if (current || !stored) {
+            target.lease_until_us.compare_exchange_strong(lease, 0, std::memory_order_release);
+        }
+        return current;
+    }
+
+    /**
+     * @brief Releases a lease once the outdated copy made under it is deleted
+     * @param slot The slot
+     * @param lease The lease taken for the copy
+     * @param hash The key's hash
+     *
+     * If the lease ran out or the slot changed hands in the meantime,
+     * another copy may have been made and just deleted, so the key's epoch
+     * is advanced to stop reads of it.
+     */
+    void releaseAfterDrop(int slot, int64_t lease, uint64_t hash) {
+        if (!slots[slot].lease_until_us.compare_exchange_strong(lease, 0, std::memory_order_release)) {
+            writeEpoch(hash).fetch_add(1, std::memory_order_acq_rel);
+        }
+    }
+};
+
+/**
+ * @struct SharedProxyState
+ * @brief State shared by all connection processes
+ *
+ * Mapped before the first fork, so every connection process sees it.
+ */
+struct SharedProxyState {
+    LatencyHistogram latencies;
+    HedgeBudget hedges;
+    HotKeyDirectory hot_keys;
+};
+
+/**
+ * @class HashRing
+ * @brief Consistent hashing of keys onto backends
+ *
+ * Each backend owns RING_POINTS_PER_BACKEND points on the ring, placed by
+ * hashing its address, and a key belongs to the backend of the first point
+ * at or after the key's hash.
+ */
+class HashRing {
+private:
+    std::vector<std::pair<uint64_t, int>> points;
+
+public:
+    /**
+     * @brief Places the backends on the ring
+     * @param backends Backend addresses as ip:port, in backend index order
+     */
+    explicit HashRing(const std::vector<std::string>& backends) {
+        for (size_t b = 0; b < backends.size(); b++) {
+            for (int i = 0; i < RING_POINTS_PER_BACKEND; i++) {
+                points.push_back({HotKeyDirectory::hashOf(backends[b] + "#" + std::to_string(i)), static_cast<int>(b)});
+            }
+        }
+        std::sort(points.begin(), points.end());
+    }
+
+    /**
+     * @brief Backend owning a key
+     * @param hash The key's hash
+     * @return Backend index
+     */
+    int owner(uint64_t hash) const {
+        auto it = std::lower_bound(points.begin(), points.end(), std::make_pair(hash, 0));
+        return (it == points.end()) ? points.front().second : it->second;
+    }
+};
+
+/**
+ * @struct ProxiedRequest
+ * @brief A client request awaiting its reply
+ */
+struct ProxiedRequest {
+    std::chrono::steady_clock::time_point sent;
+    std::string command;    // Raw bytes, kept only while a hedge is still possible
+    bool hedgeable = false;
+    bool done = false;
+    std::string reply;
+    int link = 0;           // Link the request was sent on
+    std::string copy_key;   // Hot key to make a read copy of from the reply, empty if none
+    int copy_slot = -1;
+    uint64_t copy_state = 0;
+    uint64_t copy_epoch = 0;
+    int64_t copy_lease = 0;
+    uint64_t write_hash = 0;   // Hash of the key written, 0 for reads and keyless commands
+    std::string drop_copy_key; // Key whose read copy to delete before the request, empty if none
+    int drop_copy_link = -1;   // Link of the backend holding that copy
+};
+
+/**
+ * @struct CopyJob
+ * @brief A read copy sent to the other backend, or its deletion, awaiting the acknowledgement
+ */
+struct CopyJob {
+    int slot;         // -1 for the deletion of a written or demoted key's copy
+    uint64_t state;
+    uint64_t epoch;
+    uint64_t hash;
+    int64_t lease;
+    std::string key;
+    bool drop;        // Deletion; with a slot, of an outdated copy made under lease
+};
+
+/**
+ * @struct BackendLink
+ * @brief One backend connection of a connection process
+ */
+struct BackendLink {
+    int fd = -1;
+    std::string input;
+    std::deque<uint64_t> waiting;   // Ids of requests sent on this link, in order
+};
 
 /**
  * @class LoadBalancer
  * @brief Implements a round-robin load balancer for multiple backend servers
  * 
  * This class distributes incoming client connections between multiple backend
- * servers using a round-robin algorithm. It forwards data between clients and
- * backend servers transparently.
+ * servers using a round-robin algorithm. Each connection is served by its
+ * own process, which forwards the client's commands and the backend's
+ * replies one RESP request at a time.
  */
 class LoadBalancer {
 private:
@@ -73,6 +584,51 @@ private:
      * @brief Counter for round-robin server selection
      */
     int current_server;
+    
+    /**
+     * @brief Connection processes that have not exited yet
+     */
+    std::vector<pid_t> children;
+
+    /**
+     * @brief Per-request timeout in milliseconds, 0 for none
+     */
+    int request_timeout_ms = 0;
+
+    /**
+     * @brief Extra read load allowed for hedges, in percent of reads; 0 disables hedging
+     */
+    double hedge_percent = 0;
+
+    /**
+     * @brief Reply latencies and hedge budget shared by all connection processes
+     */
+    SharedProxyState* shared = nullptr;
+
+    /**
+     * @brief Whether requests are routed by key instead of by connection
+     */
+    bool key_routing = false;
+
+    /**
+     * @brief Whether reads of hot keys are spread over read copies, with key routing only
+     */
+    bool fan_out = false;
+
+    /**
+     * @brief Owner of each key under key routing
+     */
+    HashRing ring;
+
+    /**
+     * @brief Xorshift state choosing which reads feed the hot-key sketch
+     */
+    uint64_t sample_state = 0x9e3779b97f4a7c15ULL;
+
+    /**
+     * @brief Hot reads routed so far, alternating them between owner and copy
+     */
+    uint64_t spread = 0;
 
 public:
     /**
@@ -88,7 +644,14 @@ public:
     LoadBalancer(int port, const std::string& s1_ip, int s1_port, 
                  const std::string& s2_ip, int s2_port) 
         : PORT(port), server1_ip(s1_ip), server1_port(s1_port),
-          server2_ip(s2_ip), server2_port(s2_port), current_server(0) {
+          server2_ip(s2_ip), server2_port(s2_port), current_server(0),
+          ring({s1_ip + ":" + std::to_string(s1_port), s2_ip + ":" + std::to_string(s2_port)}) {
+        void* memory = mmap(nullptr, sizeof(SharedProxyState), PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            throw std::runtime_error("Shared memory mapping failed");
+        }
+        shared = new (memory) SharedProxyState();
         setupServer();
     }
     
@@ -99,6 +662,46 @@ public:
      */
     ~LoadBalancer() {
         close(server_fd);
+        munmap(shared, sizeof(SharedProxyState));
+    }
+
+    /**
+     * @brief Sets the per-request timeout
+     * @param timeout_ms Milliseconds a request may wait for its reply, 0 for no limit
+     *
+     * A request that runs out of time is answered with an error; the
+     * backend's reply, if it comes later, is discarded.
+     */
+    void setRequestTimeout(int timeout_ms) {
+        request_timeout_ms = timeout_ms;
+    }
+
+    /**
+     * @brief Enables hedged reads
+     * @param percent Extra read load allowed for hedges, in percent of reads
+     *
+     * Only valid when both backends hold the same data: a GET or MGET with
+     * no reply after the p95 reply latency is sent to the other backend as
+     * well, and whichever reply arrives first is returned.
+     */
+    void setHedging(double percent) {
+        hedge_percent = percent;
+    }
+
+    /**
+     * @brief Routes requests by key
+     * @param spread_hot_keys Whether to spread reads of hot keys over read copies
+     *
+     * For backends that split the key space rather than hold the same data:
+     * GET, SET and DEL go to the backend owning the key on a consistent hash
+     * ring, MGET to the owner of all its keys, and other commands to the
+     * connection's own backend. With spread_hot_keys, reads of keys found
+     * to be hot alternate between the owner and a copy the balancer keeps on
+     * the other backend; writes through the balancer make copies stale.
+     */
+    void setKeyRouting(bool spread_hot_keys) {
+        key_routing = true;
+        fan_out = spread_hot_keys;
     }
     
     /**
@@ -138,26 +741,27 @@ public:
         std::cout << "Load Balancer started on port " << PORT << std::endl;
     }
     
+    /**
+     * @brief Picks the backend for a new connection
+     * @return Index of the backend, 0 or 1
+     * 
+     * Round-robin; called in the accepting process, before the fork, so the
+     * choice carries over to the next connection.
+     */
+    int nextBackend() {
+        int backend = current_server;
+        current_server = 1 - current_server;
+        return backend;
+    }
+
     /**
      * @brief Connects to a backend server
+     * @param backend Index of the backend, 0 or 1
      * @return Socket file descriptor for the backend connection, or -1 on failure
-     * 
-     * Selects a backend server using round-robin and establishes a connection to it.
      */
-    int connectToBackend() {
-        // Round-robin selection of backend server
-        std::string server_ip;
-        int server_port;
-        
-        if (current_server == 0) {
-            server_ip = server1_ip;
-            server_port = server1_port;
-            current_server = 1;
-        } else {
-            server_ip = server2_ip;
-            server_port = server2_port;
-            current_server = 0;
-        }
+    int connectToBackend(int backend) {
+        const std::string& server_ip = (backend == 0) ? server1_ip : server2_ip;
+        int server_port = (backend == 0) ? server1_port : server2_port;
         
         // Create socket for backend connection
         int backend_socket = socket(AF_INET, SOCK_STREAM, 0);
@@ -179,30 +783,138 @@ public:
         }
         
         // Connect to backend server
+        TraceSpan span("backend connect", true);
         if (connect(backend_socket, (struct sockaddr*)&backend_addr, sizeof(backend_addr)) < 0) {
             std::cerr << "Connection to backend server failed" << std::endl;
             close(backend_socket);
             return -1;
         }
         
+        // Requests are forwarded one batch at a time, so don't hold them back
+        int nodelay = 1;
+        setsockopt(backend_socket, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
         return backend_socket;
     }
     
     /**
-     * @brief Handles communication between a client and a backend server
-     * @param client_socket Socket file descriptor for the client connection
-     * 
-     * Establishes a connection to a backend server and forwards data
-     * between the client and the selected backend server.
+     * @brief Writes a whole buffer to a socket
+     * @param fd The socket
+     * @param data Bytes to write
+     * @return true if everything was written
      */
-    void handleClient(int client_socket) {
-        // Connect to a backend server
-        int backend_socket = connectToBackend();
-        if (backend_socket < 0) {
-            close(client_socket);
-            return;
+    static bool writeAll(int fd, const std::string& data) {
+        size_t written = 0;
+        while (written < data.size()) {
+            ssize_t bytes = write(fd, data.data() + written, data.size() - written);
+            if (bytes < 0 && errno == EINTR) continue;
+            if (bytes <= 0) return false;
+            written += bytes;
         }
-        
+        return true;
+    }
+
+    /**
+     * @brief Checks whether a command may be sent to either backend
+     * @param name Upper-case command name
+     * @return true for reads with no side effects
+     */
+    static bool isHedgeable(const std::string& name) {
+        return name == "GET" || name == "MGET";
+    }
+
+    /**
+     * @brief Checks whether a command ties the connection to one backend connection
+     * @param name Upper-case command name
+     * @return true for subscriptions and CLIENT commands
+     *
+     * A subscription makes the backend send unrequested messages, and CLIENT
+     * ID and CLIENT TRACKING REDIRECT name a backend connection, so such
+     * connections are forwarded byte for byte from that command on. Under
+     * key routing no single backend connection can stand for the client, so
+     * these commands are refused there instead.
+     */
+    static bool needsRawForwarding(const std::string& name) {
+        return name == "SUBSCRIBE" || name == "PSUBSCRIBE" || name == "CLIENT";
+    }
+
+    /**
+     * @brief Picks the link for a request under key routing
+     * @param name Upper-case command name
+     * @param command Command arguments
+     * @param home Index of the connection's own backend
+     * @param request The request, given the hot-key bookkeeping its reply needs
+     * @return Link to send on, 0 for the connection's own backend and 1 for the other; -1 for an MGET spanning both
+     */
+    int routeByKey(const std::string& name, const std::vector<std::string>& command, int home, ProxiedRequest& request) {
+        if (command.size() < 2) {
+            return 0;
+        }
+        if (name == "MGET") {
+            int owner = ring.owner(HotKeyDirectory::hashOf(command[1]));
+            for (size_t i = 2; i < command.size(); i++) {
+                if (ring.owner(HotKeyDirectory::hashOf(command[i])) != owner) {
+                    return -1;
+                }
+            }
+            return (owner == home) ? 0 : 1;
+        }
+        if (name != "GET" && name != "SET" && name != "DEL") {
+            return 0;
+        }
+
+        uint64_t hash = HotKeyDirectory::hashOf(command[1]);
+        int owner = (ring.owner(hash) == home) ? 0 : 1;
+        if (!fan_out) {
+            return owner;
+        }
+        HotKeyDirectory& hot = shared->hot_keys;
+        if (name != "GET") {
+            request.write_hash = hash;
+            hot.writeEpoch(hash).fetch_add(1, std::memory_order_acq_rel);
+            if (hot.find(command[1], hash) >= 0) {
+                request.drop_copy_key = command[1];
+                request.drop_copy_link = 1 - owner;
+            }
+            return owner;
+        }
+
+        sample_state ^= sample_state << 13;
+        sample_state ^= sample_state >> 7;
+        sample_state ^= sample_state << 17;
+        if ((sample_state & (HOT_SAMPLE_RATE - 1)) == 0) {
+            std::string demoted = hot.recordRead(command[1], hash);
+            if (!demoted.empty()) {
+                request.drop_copy_key = demoted;
+                request.drop_copy_link = (ring.owner(HotKeyDirectory::hashOf(demoted)) == home) ? 1 : 0;
+            }
+        }
+        int slot = hot.find(command[1], hash);
+        if (slot < 0) {
+            return owner;
+        }
+        if (hot.copyIsCurrent(slot, hash)) {
+            return (spread++ & 1) ? 1 - owner : owner;
+        }
+        // Read the state before the lease, so a copy racing a new generation can't be marked current
+        uint64_t state = hot.slots[slot].copy.load(std::memory_order_acquire);
+        uint64_t epoch = hot.writeEpoch(hash).load(std::memory_order_acquire);
+        int64_t lease = hot.tryLease(slot);
+        if (lease) {
+            request.copy_lease = lease;
+            request.copy_key = command[1];
+            request.copy_slot = slot;
+            request.copy_state = state;
+            request.copy_epoch = epoch;
+        }
+        return owner;
+    }
+
+    /**
+     * @brief Forwards bytes between a client and a backend until either closes
+     * @param client_socket Client connection
+     * @param backend_socket Backend connection
+     */
+    void forwardRaw(int client_socket, int backend_socket) {
         // Set up poll for both sockets
         std::vector<pollfd> poll_fds(2);
         poll_fds[0].fd = client_socket;
@@ -217,46 +929,421 @@ public:
         // Forward data between client and backend
         while (!client_closed && !backend_closed) {
             int poll_count = poll(poll_fds.data(), 2, -1);
+            if (trace_dump_requested) {
+                trace_dump_requested = 0;
+                dumpTrace();
+            }
             if (poll_count < 0) {
+                if (errno == EINTR) continue;
                 std::cerr << "Poll error" << std::endl;
                 break;
             }
             
             // Check for client data
             if (poll_fds[0].revents & POLLIN) {
+                TraceRequest request;
+                TraceSpan read_span("client read");
                 int bytes_read = read(client_socket, buffer, sizeof(buffer));
+                read_span.end();
                 if (bytes_read <= 0) {
                     client_closed = true;
                 } else {
                     // Forward client data to backend
+                    TraceSpan write_span("backend write");
                     write(backend_socket, buffer, bytes_read);
                 }
             }
             
             // Check for backend data
             if (poll_fds[1].revents & POLLIN) {
+                TraceRequest request;
+                TraceSpan read_span("backend read");
                 int bytes_read = read(backend_socket, buffer, sizeof(buffer));
+                read_span.end();
                 if (bytes_read <= 0) {
                     backend_closed = true;
                 } else {
                     // Forward backend data to client
+                    TraceSpan write_span("client write");
                     write(client_socket, buffer, bytes_read);
                 }
             }
         }
+    }
+
+    /**
+     * @brief Handles communication between a client and a backend server
+     * @param client_socket Socket file descriptor for the client connection
+     * @param backend Index of the backend chosen for this connection
+     * 
+     * Connects to the chosen backend and proxies the client's commands to it
+     * one RESP request at a time, keeping replies in request order. With a
+     * timeout set, a request without a reply in time is answered with an
+     * error. With hedging on, the other backend is connected too, and a GET
+     * or MGET still unanswered after the p95 latency is sent there as well,
+     * as long as the hedge budget allows; the first reply wins and the other
+     * is dropped. With key routing, both backends are connected and each
+     * request goes to the one setKeyRouting() describes; a GET that makes a
+     * hot key's read copy has its reply SET on the other backend too, and
+     * copies that stop being current are deleted there again. With
+     * tracing on, each wakeup is a request, and the trace is written to
+     * lb_trace_<pid>.json on SIGUSR1 and when the connection ends.
+     */
+    void handleClient(int client_socket, int backend) {
+        Tracer::setThreadName("proxy");
+        sample_state ^= static_cast<uint64_t>(getpid()) << 17;
+        BackendLink links[2];
+        links[0].fd = connectToBackend(backend);
+        if (links[0].fd < 0) {
+            close(client_socket);
+            return;
+        }
+        if (hedge_percent > 0 || key_routing) {
+            // Without the second backend the connection goes unhedged, or answers its keys with errors
+            links[1].fd = connectToBackend(1 - backend);
+        }
+        
+        std::deque<ProxiedRequest> inflight;
+        uint64_t first_id = 0;          // Id of inflight.front()
+        std::string client_input;
+        std::vector<std::string> command;
+        bool raw_pending = false;       // Switch to forwardRaw once inflight drains
+        bool protocol_error = false;    // Close once inflight drains; key routing can't resync unparsable input
+        bool closed = false;
+        uint64_t requests = 0;
+        uint64_t hedge_delay_us = 0;    // 0 until enough latencies are known
+        auto timeout = std::chrono::milliseconds(request_timeout_ms);
+        std::unordered_map<uint64_t, uint64_t> pending_writes;   // Request id to key hash, for writes not yet answered
+        std::unordered_map<uint64_t, CopyJob> copy_jobs;         // Keyed by COPY_REQUEST | sequence number
+        uint64_t copies_sent = 0;
+        char buffer[16384];
+        
+        // A write whose reply will never be seen might still land after any later read: end its epoch now
+        auto abandonWrites = [&]() {
+            for (const auto& [id, hash] : pending_writes) {
+                (void)id;
+                shared->hot_keys.writeEpoch(hash).fetch_add(1, std::memory_order_acq_rel);
+            }
+            pending_writes.clear();
+            // Likewise an unanswered deletion of a copy might remove a newer one later
+            for (const auto& [id, job] : copy_jobs) {
+                (void)id;
+                if (job.drop) {
+                    shared->hot_keys.writeEpoch(job.hash).fetch_add(1, std::memory_order_acq_rel);
+                }
+            }
+        };
+        
+        // Deletes a read copy on link l. The copy of a written or demoted key
+        // (slot -1) may be current, so like a write its deletion ends the
+        // key's epoch when sent and when answered. An outdated copy's slot
+        // lease is held until the deletion is answered instead.
+        auto dropCopy = [&](int l, const CopyJob& job, std::string& out) {
+            if (job.slot < 0) {
+                shared->hot_keys.writeEpoch(job.hash).fetch_add(1, std::memory_order_acq_rel);
+            }
+            uint64_t drop_id = COPY_REQUEST | copies_sent++;
+            copy_jobs[drop_id] = job;
+            copy_jobs[drop_id].drop = true;
+            RespCodec::appendCommand(out, {"DEL", job.key});
+            links[l].waiting.push_back(drop_id);
+        };
+        
+        while (!closed) {
+            if (protocol_error && inflight.empty()) {
+                break;
+            }
+            if (raw_pending && inflight.empty() && links[0].waiting.empty()) {
+                abandonWrites();
+                if (links[1].fd >= 0) {
+                    close(links[1].fd);
+                    links[1].fd = -1;
+                }
+                if (writeAll(links[0].fd, client_input)) {
+                    forwardRaw(client_socket, links[0].fd);
+                }
+                break;
+            }
+            
+            // Sleep until the earliest timeout or hedge is due
+            auto now = std::chrono::steady_clock::now();
+            auto wake = std::chrono::steady_clock::time_point::max();
+            for (const ProxiedRequest& request : inflight) {
+                if (request.done) continue;
+                if (request_timeout_ms > 0) {
+                    wake = std::min(wake, request.sent + timeout);
+                }
+                if (request.hedgeable) {
+                    wake = std::min(wake, request.sent + std::chrono::microseconds(hedge_delay_us));
+                }
+            }
+            timespec wait = {};
+            if (wake != std::chrono::steady_clock::time_point::max()) {
+                long long ns = std::max<long long>(
+                    0, std::chrono::duration_cast<std::chrono::nanoseconds>(wake - now).count());
+                wait.tv_sec = ns / 1000000000;
+                wait.tv_nsec = ns % 1000000000;
+            }
+            
+            pollfd poll_fds[3] = {{client_socket, POLLIN, 0}, {links[0].fd, POLLIN, 0}, {links[1].fd, POLLIN, 0}};
+            int poll_count = ppoll(poll_fds, 3, (wake == std::chrono::steady_clock::time_point::max()) ? nullptr : &wait,
+                                   nullptr);
+            if (trace_dump_requested) {
+                trace_dump_requested = 0;
+                dumpTrace();
+            }
+            if (poll_count < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "Poll error" << std::endl;
+                break;
+            }
+            TraceRequest trace_request;
+            std::string outgoing[2];
+            
+            // Forward every complete client command to its backend
+            if (poll_fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+                TraceSpan read_span("client read");
+                ssize_t bytes_read = read(client_socket, buffer, sizeof(buffer));
+                read_span.end();
+                if (bytes_read <= 0) {
+                    break;
+                }
+                client_input.append(buffer, bytes_read);
+                
+                size_t pos = 0;
+                while (!raw_pending && !protocol_error) {
+                    size_t start = pos;
+                    ParseResult result = RespCodec::decodeCommand(client_input, pos, command);
+                    if (result == ParseResult::INCOMPLETE) break;
+                    std::string name;
+                    if (result == ParseResult::COMPLETE) {
+                        name = command[0];
+                        std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+                    }
+                    if (key_routing && (result == ParseResult::INVALID || needsRawForwarding(name))) {
+                        ProxiedRequest refused;
+                        refused.done = true;
+                        refused.reply = RespCodec::encodeError(result == ParseResult::INVALID
+                            ? "Protocol error" : name + " is not supported with key routing");
+                        inflight.push_back(std::move(refused));
+                        if (result == ParseResult::INVALID) {
+                            protocol_error = true;
+                            pos = client_input.size();
+                        }
+                        continue;
+                    }
+                    if (result == ParseResult::INVALID || needsRawForwarding(name)) {
+                        raw_pending = true;
+                        pos = start;
+                        break;
+                    }
+                    
+                    if (requests++ % HEDGE_REFRESH_EVERY == 0 && hedge_percent > 0 && links[1].fd >= 0) {
+                        uint64_t p95 = shared->latencies.percentile(HEDGE_PERCENTILE);
+                        hedge_delay_us = p95 ? std::max<uint64_t>(p95, HEDGE_MIN_DELAY_US) : 0;
+                    }
+                    ProxiedRequest request;
+                    request.sent = std::chrono::steady_clock::now();
+                    request.hedgeable = links[1].fd >= 0 && hedge_delay_us > 0 && isHedgeable(name);
+                    if (request.hedgeable) {
+                        request.command = client_input.substr(start, pos - start);
+                        shared->hedges.earn(hedge_percent);
+                    }
+                    uint64_t id = first_id + inflight.size();
+                    request.link = key_routing ? routeByKey(name, command, backend, request) : 0;
+                    if (request.drop_copy_link >= 0 && links[request.drop_copy_link].fd >= 0) {
+                        dropCopy(request.drop_copy_link,
+                                 {-1, 0, 0, HotKeyDirectory::hashOf(request.drop_copy_key), 0, request.drop_copy_key, true},
+                                 outgoing[request.drop_copy_link]);
+                    }
+                    if (request.link < 0 || links[request.link].fd < 0) {
+                        request.done = true;
+                        request.reply = RespCodec::encodeError(request.link < 0
+                            ? "CROSSSLOT Keys in request don't hash to the same backend" : "Backend unavailable");
+                        if (request.copy_slot >= 0) {
+                            shared->hot_keys.finishCopy(request.copy_slot, request.copy_state, request.copy_epoch, 0,
+                                                        request.copy_lease, false);
+                        }
+                        if (request.write_hash) {
+                            shared->hot_keys.writeEpoch(request.write_hash).fetch_add(1, std::memory_order_acq_rel);
+                        }
+                        inflight.push_back(std::move(request));
+                        continue;
+                    }
+                    if (request.write_hash) {
+                        pending_writes[id] = request.write_hash;
+                    }
+                    links[request.link].waiting.push_back(id);
+                    outgoing[request.link].append(client_input, start, pos - start);
+                    inflight.push_back(std::move(request));
+                }
+                client_input.erase(0, pos);
+            }
+            
+            // Match backend replies to requests; the first reply to a request wins
+            for (int l = 0; l < 2 && !closed; l++) {
+                if (!(poll_fds[l + 1].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                BackendLink& link = links[l];
+                TraceSpan read_span("backend read");
+                ssize_t bytes_read = read(link.fd, buffer, sizeof(buffer));
+                read_span.end();
+                if (bytes_read <= 0) {
+                    if (l == 0 || key_routing) {
+                        closed = true;
+                        break;
+                    }
+                    // Lost the hedge backend: every request is still waiting on the chosen one
+                    close(link.fd);
+                    link = BackendLink();
+                    for (ProxiedRequest& request : inflight) {
+                        request.hedgeable = false;
+                    }
+                    continue;
+                }
+                link.input.append(buffer, bytes_read);
+                
+                size_t pos = 0;
+                RespValue reply;
+                while (!link.waiting.empty()) {
+                    size_t start = pos;
+                    ParseResult result = RespCodec::decodeReply(link.input, pos, reply);
+                    if (result == ParseResult::INCOMPLETE) break;
+                    if (result == ParseResult::INVALID) {
+                        std::cerr << "Invalid reply from backend" << std::endl;
+                        closed = true;
+                        break;
+                    }
+                    uint64_t id = link.waiting.front();
+                    link.waiting.pop_front();
+                    if (id & COPY_REQUEST) {
+                        auto job = copy_jobs.find(id);
+                        CopyJob done = job->second;
+                        copy_jobs.erase(job);
+                        if (done.drop && done.slot < 0) {
+                            shared->hot_keys.writeEpoch(done.hash).fetch_add(1, std::memory_order_acq_rel);
+                        } else if (done.drop) {
+                            shared->hot_keys.releaseAfterDrop(done.slot, done.lease, done.hash);
+                        } else {
+                            bool stored = reply.type == RespValue::SIMPLE;
+                            if (!shared->hot_keys.finishCopy(done.slot, done.state, done.epoch, done.hash, done.lease,
+                                                             stored) && stored) {
+                                // Outdated before it counted: the backend must not keep it
+                                dropCopy(l, done, outgoing[l]);
+                            }
+                        }
+                        continue;
+                    }
+                    auto write = pending_writes.find(id);
+                    if (write != pending_writes.end()) {
+                        shared->hot_keys.writeEpoch(write->second).fetch_add(1, std::memory_order_acq_rel);
+                        pending_writes.erase(write);
+                    }
+                    if (id < first_id || inflight[id - first_id].done) {
+                        continue;
+                    }
+                    ProxiedRequest& request = inflight[id - first_id];
+                    request.done = true;
+                    request.reply = link.input.substr(start, pos - start);
+                    request.command.clear();
+                    shared->latencies.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - request.sent).count());
+                    
+                    if (request.copy_slot >= 0) {
+                        uint64_t hash = HotKeyDirectory::hashOf(request.copy_key);
+                        // A missing key reads as a null bulk string, so a miss never makes a copy
+                        if (reply.type == RespValue::BULK && !reply.is_null && links[1 - l].fd >= 0) {
+                            uint64_t copy_id = COPY_REQUEST | copies_sent++;
+                            copy_jobs[copy_id] = {request.copy_slot, request.copy_state, request.copy_epoch, hash,
+                                                  request.copy_lease, request.copy_key, false};
+                            RespCodec::appendCommand(outgoing[1 - l], {"SET", request.copy_key, std::string(reply.str)});
+                            links[1 - l].waiting.push_back(copy_id);
+                        } else {
+                            shared->hot_keys.finishCopy(request.copy_slot, request.copy_state, request.copy_epoch, hash,
+                                                        request.copy_lease, false);
+                        }
+                    }
+                }
+                link.input.erase(0, pos);
+            }
+            
+            for (int l = 0; l < 2 && !closed; l++) {
+                if (!outgoing[l].empty()) {
+                    TraceSpan write_span("backend write");
+                    if (!writeAll(links[l].fd, outgoing[l])) {
+                        closed = true;
+                    }
+                }
+            }
+            if (closed) {
+                break;
+            }
+            
+            // Time out overdue requests and hedge slow reads, within the budget
+            now = std::chrono::steady_clock::now();
+            std::string hedges;
+            for (size_t i = 0; i < inflight.size(); i++) {
+                ProxiedRequest& request = inflight[i];
+                if (request.done) continue;
+                if (request_timeout_ms > 0 && now >= request.sent + timeout) {
+                    request.done = true;
+                    request.reply = RespCodec::encodeError("Request timed out");
+                    request.command.clear();
+                } else if (request.hedgeable && now >= request.sent + std::chrono::microseconds(hedge_delay_us)) {
+                    request.hedgeable = false;
+                    if (shared->hedges.spend()) {
+                        hedges += request.command;
+                        links[1].waiting.push_back(first_id + i);
+                    }
+                    request.command.clear();
+                }
+            }
+            if (!hedges.empty()) {
+                TraceSpan hedge_span("hedge");
+                if (!writeAll(links[1].fd, hedges)) {
+                    std::cerr << "Hedge to backend failed" << std::endl;
+                }
+            }
+            
+            // Send finished replies to the client, in request order
+            std::string replies;
+            while (!inflight.empty() && inflight.front().done) {
+                replies += inflight.front().reply;
+                inflight.pop_front();
+                first_id++;
+            }
+            if (!replies.empty()) {
+                TraceSpan write_span("client write");
+                if (!writeAll(client_socket, replies)) {
+                    break;
+                }
+            }
+        }
         
         // Clean up
+        abandonWrites();
         close(client_socket);
-        close(backend_socket);
+        close(links[0].fd);
+        if (links[1].fd >= 0) {
+            close(links[1].fd);
+        }
+        if (Tracer::enabled()) {
+            dumpTrace();
+        }
     }
     
     /**
      * @brief Starts the load balancer
      * 
      * Main event loop that accepts client connections and handles them
-     * by creating a new process for each connection.
+     * by creating a new process for each connection. SIGUSR1 is passed on
+     * to every live connection process so each writes its trace.
      */
     void start() {
+        Tracer::setThreadName("acceptor");
+        struct sigaction action = {};
+        action.sa_handler = requestTraceDump;
+        sigaction(SIGUSR1, &action, nullptr);
+
         std::vector<pollfd> poll_fds(MAX_CLIENTS + 1);
         poll_fds[0].fd = server_fd;
         poll_fds[0].events = POLLIN;
@@ -265,8 +1352,24 @@ public:
         while (true) {
             int poll_count = poll(poll_fds.data(), num_fds, -1);
             
+            // Reap finished connection processes
+            pid_t done;
+            while ((done = waitpid(-1, nullptr, WNOHANG)) > 0) {
+                children.erase(std::remove(children.begin(), children.end(), done), children.end());
+            }
+            
+            if (trace_dump_requested) {
+                trace_dump_requested = 0;
+                for (pid_t child : children) {
+                    kill(child, SIGUSR1);
+                }
+                dumpTrace();
+            }
+            
             if (poll_count < 0) {
-                std::cerr << "Poll error" << std::endl;
+                if (errno != EINTR) {
+                    std::cerr << "Poll error" << std::endl;
+                }
                 continue;
             }
             
@@ -283,14 +1386,20 @@ public:
                 
                 // Handle client in a new thread or process
                 // For simplicity, we'll fork a new process
+                TraceSpan fork_span("fork", true);
+                int backend = nextBackend();
                 pid_t pid = fork();
                 if (pid == 0) {
                     // Child process
+                    Tracer::afterFork();
                     close(server_fd);
-                    handleClient(client_socket);
+                    handleClient(client_socket, backend);
                     exit(0);
                 } else {
                     // Parent process
+                    if (pid > 0) {
+                        children.push_back(pid);
+                    }
                     close(client_socket);
                 }
             }
@@ -308,8 +1417,31 @@ public:
  * the specified configuration.
  */
 int main(int argc, char* argv[]) {
-    if (argc != 6) {
-        std::cerr << "Usage: " << argv[0] << " <load_balancer_port> <server1_ip> <server1_port> <server2_ip> <server2_port>" << std::endl;
+    int timeout_ms = 0;
+    double hedge_percent = 0;
+    bool key_routing = false;
+    bool fan_out = false;
+    bool valid = argc >= 6;
+    for (int i = 6; valid && i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "-T" && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            Tracer::setSampleRate(static_cast<uint32_t>(std::atoi(argv[++i])));
+        } else if (option == "-t" && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            timeout_ms = std::atoi(argv[++i]);
+        } else if (option == "-h" && i + 1 < argc && std::atof(argv[i + 1]) > 0) {
+            hedge_percent = std::atof(argv[++i]);
+        } else if (option == "-k") {
+            key_routing = true;
+        } else if (option == "-f") {
+            key_routing = fan_out = true;
+        } else {
+            valid = false;
+        }
+    }
+    // Hedging needs backends with the same data, key routing backends with different data
+    if (!valid || (key_routing && hedge_percent > 0)) {
+        std::cerr << "Usage: " << argv[0] << " <load_balancer_port> <server1_ip> <server1_port> <server2_ip> <server2_port>"
+                  << " [-T sample_every] [-t timeout_ms] [-h hedge_percent | -k | -f]" << std::endl;
         return 1;
     }
     
@@ -321,6 +1453,11 @@ int main(int argc, char* argv[]) {
     
     try {
         LoadBalancer lb(lb_port, server1_ip, server1_port, server2_ip, server2_port);
+        lb.setRequestTimeout(timeout_ms);
+        lb.setHedging(hedge_percent);
+        if (key_routing) {
+            lb.setKeyRouting(fan_out);
+        }
         lb.start();
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -329,4 +1466,3 @@ int main(int argc, char* argv[]) {
     
     return 0;
 }
-
@@ -12,14 +12,55 @@
 
 /**
  * @brief Main function
+ * @param argc Number of command-line arguments
+ * @param argv Array of command-line arguments
  * @return Exit code (0 for success, 1 for failure)
  * 
  * Creates and starts a BlinkServer instance, catching and reporting any
  * exceptions that occur during server startup.
  */
-int main() {
+int main(int argc, char* argv[]) {
+    std::vector<int> busy_cpus;
+    int idle_us = BUSY_POLL_DEFAULT_IDLE_US;
+    int max_clients = BlinkServer::DEFAULT_MAX_CLIENTS;
+    int backlog = BlinkServer::DEFAULT_BACKLOG;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        HugePageMode mode;
+        if (arg == "-H" && i + 1 < argc && HugePages::parseMode(argv[i + 1], mode)) {
+            // Must be set before the database allocates its table
+            HugePages::setMode(mode);
+            i++;
+        } else if (arg == "-T" && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            // Trace one request in every N from startup
+            Tracer::setSampleRate(static_cast<uint32_t>(std::atoi(argv[i + 1])));
+            i++;
+        } else if (arg == "-B" && i + 1 < argc && CpuAffinity::parseList(argv[i + 1], busy_cpus) && busy_cpus.size() == 1) {
+            // Busy-poll on this CPU
+            i++;
+        } else if (arg == "-I" && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            idle_us = std::atoi(argv[++i]);
+        } else if (arg == "-c" && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            max_clients = std::atoi(argv[++i]);
+        } else if (arg == "-b" && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            backlog = std::atoi(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [-H off|advise|explicit] [-T sample_every] [-B cpu [-I idle_us]]"
+                      << " [-c max_clients] [-b backlog]" << std::endl;
+            return 1;
+        }
+    }
+
+    // Before the database starts its flush thread, which inherits this affinity
+    if (!busy_cpus.empty() && !CpuAffinity::keepOff(busy_cpus)) {
+        std::cerr << "No other CPU for background threads, they may share CPU " << busy_cpus[0] << std::endl;
+    }
+
     try {
-        BlinkServer server;
+        BlinkServer server(max_clients, backlog);
+        if (!busy_cpus.empty()) {
+            server.setBusyPoll(busy_cpus[0], idle_us);
+        }
         server.start();
     } catch (const std::exception& e) {
         std::cerr << "Server startup failed: " << e.what() << std::endl;
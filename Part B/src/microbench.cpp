@@ -0,0 +1,272 @@
+/**
+ * @file microbench.cpp
+ * @brief Microbenchmarks of the storage and protocol hot paths, one component at a time
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#include "bench_harness.h"
+#include "key_table.h"
+#include "resp.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <streambuf>
+
+/**
+ * @brief Number of pipelined commands in the RESP parse buffer
+ */
+#define PARSE_BUFFER_COMMANDS 1024
+
+/**
+ * @class DiscardBuffer
+ * @brief Stream buffer that drops whatever it holds whenever it fills up
+ *
+ * Lets persistence formatting be timed through the same ostream operators
+ * BlinkDB::persistToFile uses, without any disk I/O.
+ */
+class DiscardBuffer : public std::streambuf {
+private:
+    char buffer[1 << 16];
+
+protected:
+    /**
+     * @brief Empties the buffer
+     * @param ch Character that did not fit
+     * @return The character
+     */
+    int_type overflow(int_type ch) override {
+        setp(buffer, buffer + sizeof(buffer));
+        if (ch != traits_type::eof()) {
+            sputc(static_cast<char>(ch));
+        }
+        return ch;
+    }
+
+public:
+    /**
+     * @brief Constructor
+     */
+    DiscardBuffer() { setp(buffer, buffer + sizeof(buffer)); }
+};
+
+/**
+ * @struct TableFixture
+ * @brief A key table filled with key_count keys, plus keys for every case
+ */
+struct TableFixture {
+    std::vector<std::string> keys;        // Present in the table
+    std::vector<std::string> other_keys;  // Absent from the table
+    std::vector<uint32_t> order;          // Shuffled positions into keys
+    std::string value;
+    KeyTable table;
+    std::unique_ptr<KeyTable> scratch;    // Emptied before each insert sample
+    size_t cursor = 0;
+    size_t evict_cursor = 0;
+
+    /**
+     * @brief Builds the fixture
+     * @param key_count Number of keys in the table
+     * @param value_size Bytes per value
+     */
+    TableFixture(size_t key_count, size_t value_size) : value(value_size, 'v') {
+        char key[32];
+        for (size_t i = 0; i < key_count; i++) {
+            std::snprintf(key, sizeof(key), "user:%010zu", i);
+            keys.emplace_back(key);
+            std::snprintf(key, sizeof(key), "miss:%010zu", i);
+            other_keys.emplace_back(key);
+            order.push_back(static_cast<uint32_t>(i));
+        }
+        std::shuffle(order.begin(), order.end(), std::mt19937_64(42));
+        for (const auto& k : keys) {
+            table.insert(k, value);
+        }
+    }
+
+    /**
+     * @brief Next key position in shuffled order
+     * @return Position into keys
+     */
+    uint32_t next() {
+        uint32_t i = order[cursor];
+        cursor = (cursor + 1 == order.size()) ? 0 : cursor + 1;
+        return i;
+    }
+};
+
+/**
+ * @brief Builds the key table cases for one parameter set
+ * @param f The fixture
+ * @param params Parameters to report
+ * @return The cases
+ *
+ * Eviction comes last because it replaces the table's keys as it runs.
+ */
+static std::vector<BenchCase> tableCases(TableFixture& f,
+                                         const std::vector<std::pair<std::string, size_t>>& params) {
+    std::vector<BenchCase> cases;
+
+    BenchCase hit;
+    hit.name = "table.lookup_hit";
+    hit.run = [&f](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            benchDoNotOptimize(f.table.find(f.keys[f.next()]));
+        }
+    };
+    cases.push_back(hit);
+
+    BenchCase miss;
+    miss.name = "table.lookup_miss";
+    miss.run = [&f](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            benchDoNotOptimize(f.table.find(f.other_keys[f.next()]));
+        }
+    };
+    cases.push_back(miss);
+
+    BenchCase insert;
+    insert.name = "table.insert";
+    insert.setup = [&f]() { f.scratch = std::make_unique<KeyTable>(); };
+    insert.run = [&f](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            f.scratch->insert(f.keys[i], f.value);
+        }
+    };
+    insert.max_iterations = f.keys.size();
+    cases.push_back(insert);
+
+    BenchCase touch;
+    touch.name = "table.lru_touch";
+    // Entries 0 to key_count - 1 are always live, so positions double as entry indices
+    touch.run = [&f](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            f.table.touch(f.next());
+        }
+    };
+    cases.push_back(touch);
+
+    BenchCase serialize;
+    serialize.name = "persist.serialize";
+    serialize.run = [&f](size_t n) {
+        DiscardBuffer buffer;
+        std::ostream out(&buffer);
+        for (size_t i = 0; i < n; i++) {
+            f.table.forEach([&out](std::string_view key, const std::string& value) {
+                out << key << "\t" << value << "\n";
+            });
+        }
+    };
+    serialize.ops_per_iteration = f.keys.size();
+    cases.push_back(serialize);
+
+    // Inserting the absent keys in order evicts the present ones in order,
+    // after which the roles swap, so the table stays full indefinitely
+    BenchCase evict;
+    evict.name = "table.evict";
+    evict.run = [&f](size_t n) {
+        size_t count = f.keys.size();
+        for (size_t i = 0; i < n; i++) {
+            size_t j = f.evict_cursor++ % (2 * count);
+            f.table.insert(j < count ? f.other_keys[j] : f.keys[j - count], f.value);
+            f.table.erase(f.table.leastRecent());
+        }
+    };
+    cases.push_back(evict);
+
+    for (auto& c : cases) {
+        c.params = params;
+    }
+    return cases;
+}
+
+/**
+ * @brief Builds the RESP cases for one value size
+ * @param buffer Pipelined SET commands to parse
+ * @param value Value to encode as a reply
+ * @param params Parameters to report
+ * @return The cases
+ */
+static std::vector<BenchCase> respCases(const std::string& buffer, const std::string& value,
+                                        const std::vector<std::pair<std::string, size_t>>& params) {
+    std::vector<BenchCase> cases;
+
+    BenchCase parse;
+    parse.name = "resp.parse";
+    parse.run = [&buffer](size_t n) {
+        std::vector<std::string> command;
+        size_t pos = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (pos == buffer.size()) {
+                pos = 0;
+            }
+            RespCodec::decodeCommand(buffer, pos, command);
+        }
+        benchDoNotOptimize(command.data());
+    };
+    parse.params = params;
+    cases.push_back(parse);
+
+    BenchCase encode;
+    encode.name = "resp.encode";
+    encode.run = [&value](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            std::string reply = RespCodec::encodeBulkString(value);
+            benchDoNotOptimize(reply.data());
+        }
+    };
+    encode.params = params;
+    cases.push_back(encode);
+
+    return cases;
+}
+
+/**
+ * @brief Main function
+ * @param argc Number of command-line arguments
+ * @param argv Array of command-line arguments
+ * @return Exit code
+ */
+int main(int argc, char* argv[]) {
+    try {
+        BenchHarness harness(argc, argv);
+        const size_t key_counts[] = {1000, 100000, 1000000};
+        const size_t value_sizes[] = {16, 256, 4096};
+
+        for (size_t value_size : value_sizes) {
+            std::string value(value_size, 'v');
+            std::string buffer;
+            for (int i = 0; i < PARSE_BUFFER_COMMANDS; i++) {
+                RespCodec::appendCommand(buffer, {"SET", "user:" + std::to_string(i), value});
+            }
+            harness.run(respCases(buffer, value, {{"value", value_size}}));
+        }
+
+        // Filling tables is slow, so skip it when no table case is selected
+        bool table_selected = false;
+        for (const char* name : {"table.lookup_hit", "table.lookup_miss", "table.insert",
+                                 "table.lru_touch", "persist.serialize", "table.evict"}) {
+            table_selected = table_selected || harness.selected(name);
+        }
+        for (size_t key_count : key_counts) {
+            for (size_t value_size : value_sizes) {
+                // 1M values of 4 KB would need 4 GB
+                if (!table_selected || key_count * value_size > (1ULL << 30)) {
+                    continue;
+                }
+                TableFixture fixture(key_count, value_size);
+                harness.run(tableCases(fixture, {{"keys", key_count}, {"value", value_size}}));
+            }
+        }
+
+        harness.finish();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
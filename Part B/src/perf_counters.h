@@ -0,0 +1,138 @@
+/**
+ * @file perf_counters.h
+ * @brief Header file for hardware performance counters read around benchmark phases
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <string>
+#include <cstdint>
+
+/**
+ * @enum PerfEvent
+ * @brief Events counted by PerfCounters
+ */
+enum PerfEvent {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_PAGE_FAULTS,
+    PERF_EVENT_COUNT
+};
+
+/**
+ * @struct PerfSample
+ * @brief Event counts over one measured phase
+ */
+struct PerfSample {
+    /**
+     * @brief Count per event, scaled up if the kernel multiplexed the counter
+     */
+    double counts[PERF_EVENT_COUNT] = {};
+
+    /**
+     * @brief Whether the event could be counted at all
+     */
+    bool valid[PERF_EVENT_COUNT] = {};
+
+    /**
+     * @brief Adds another phase's counts to this one
+     * @param other The other sample
+     */
+    void add(const PerfSample& other);
+
+    /**
+     * @brief Formats the counts divided by a number of operations
+     * @param ops Operations performed in the phase
+     * @return e.g. "cycles 312.4  instructions 120.1  IPC 0.38  L1d-misses 3.2 ..."
+     */
+    std::string perOp(double ops) const;
+};
+
+/**
+ * @class PerfCounters
+ * @brief Counts cycles, instructions, cache, branch and TLB misses of this process
+ *
+ * Each event is opened with perf_event_open(2) for user space only, which
+ * is allowed at the default kernel.perf_event_paranoid level of 2. Events
+ * the CPU or kernel cannot count (virtual machines often expose no PMU) are
+ * skipped; the others still work, and start()/stop() stay cheap no-ops when
+ * nothing could be opened.
+ */
+class PerfCounters {
+private:
+    /**
+     * @brief File descriptor per event, -1 if the event is unavailable
+     */
+    int fds[PERF_EVENT_COUNT];
+
+    /**
+     * @brief Raw value, enabled time and running time per event at start()
+     */
+    uint64_t started[PERF_EVENT_COUNT][3] = {};
+
+    /**
+     * @brief Why the first unavailable event could not be opened
+     */
+    std::string error;
+
+    /**
+     * @brief Reads an event's raw value, enabled time and running time
+     * @param event The event
+     * @param out Output triple
+     * @return true on success
+     */
+    bool readEvent(int event, uint64_t out[3]) const;
+
+public:
+    /**
+     * @brief Opens every event for the calling thread and threads it creates later
+     */
+    PerfCounters();
+
+    /**
+     * @brief Destructor, closes the events
+     */
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /**
+     * @brief Checks whether any event can be counted
+     * @return true if at least one event is open
+     */
+    bool available() const;
+
+    /**
+     * @brief Describes events that could not be opened
+     * @return Empty if every event is open, otherwise a short explanation
+     */
+    std::string unavailableReason() const;
+
+    /**
+     * @brief Starts a measured phase
+     */
+    void start();
+
+    /**
+     * @brief Ends a measured phase
+     * @return Counts since the last start()
+     */
+    PerfSample stop() const;
+
+    /**
+     * @brief Short name of an event
+     * @param event The event
+     * @return e.g. "LLC-misses"
+     */
+    static const char* eventName(int event);
+};
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,177 @@
+/**
+ * @file pubsub.cpp
+ * @brief Implementation of the PubSub class
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#include "pubsub.h"
+#include <algorithm>
+#include <fnmatch.h>
+
+/**
+ * @brief Adds a client to a channel or pattern table
+ * @param table The channel or pattern table
+ * @param names The client's own list of channels or patterns
+ * @param client Client id
+ * @param name Channel or pattern to add
+ */
+void PubSub::add(std::unordered_map<std::string, std::vector<uint64_t>>& table,
+                 std::vector<std::string>& names, uint64_t client, const std::string& name) {
+    if (std::find(names.begin(), names.end(), name) != names.end()) {
+        return; // Already subscribed
+    }
+    names.push_back(name);
+    table[name].push_back(client);
+}
+
+/**
+ * @brief Removes a client from a channel or pattern table
+ * @param table The channel or pattern table
+ * @param names The client's own list of channels or patterns
+ * @param client Client id
+ * @param name Channel or pattern to remove
+ */
+void PubSub::remove(std::unordered_map<std::string, std::vector<uint64_t>>& table,
+                    std::vector<std::string>& names, uint64_t client, const std::string& name) {
+    auto own = std::find(names.begin(), names.end(), name);
+    if (own == names.end()) {
+        return;
+    }
+    names.erase(own);
+    
+    auto entry = table.find(name);
+    if (entry == table.end()) {
+        return;
+    }
+    std::vector<uint64_t>& clients = entry->second;
+    auto it = std::find(clients.begin(), clients.end(), client);
+    if (it != clients.end()) {
+        // Delivery order between subscribers doesn't matter, so swap-remove
+        *it = clients.back();
+        clients.pop_back();
+    }
+    if (clients.empty()) {
+        table.erase(entry);
+    }
+}
+
+/**
+ * @brief Subscribes a client to a channel
+ * @param client Client id
+ * @param channel Channel name
+ * @return Number of channels and patterns the client is subscribed to
+ */
+size_t PubSub::subscribe(uint64_t client, const std::string& channel) {
+    add(channels, subscribers[client].channels, client, channel);
+    return subscriptionCount(client);
+}
+
+/**
+ * @brief Unsubscribes a client from a channel
+ * @param client Client id
+ * @param channel Channel name
+ * @return Number of channels and patterns the client is subscribed to
+ */
+size_t PubSub::unsubscribe(uint64_t client, const std::string& channel) {
+    auto it = subscribers.find(client);
+    if (it != subscribers.end()) {
+        remove(channels, it->second.channels, client, channel);
+    }
+    return subscriptionCount(client);
+}
+
+/**
+ * @brief Subscribes a client to a glob pattern
+ * @param client Client id
+ * @param pattern Glob pattern matched against channel names
+ * @return Number of channels and patterns the client is subscribed to
+ */
+size_t PubSub::psubscribe(uint64_t client, const std::string& pattern) {
+    add(patterns, subscribers[client].patterns, client, pattern);
+    return subscriptionCount(client);
+}
+
+/**
+ * @brief Unsubscribes a client from a glob pattern
+ * @param client Client id
+ * @param pattern Glob pattern
+ * @return Number of channels and patterns the client is subscribed to
+ */
+size_t PubSub::punsubscribe(uint64_t client, const std::string& pattern) {
+    auto it = subscribers.find(client);
+    if (it != subscribers.end()) {
+        remove(patterns, it->second.patterns, client, pattern);
+    }
+    return subscriptionCount(client);
+}
+
+/**
+ * @brief Lists the channels a client is subscribed to
+ * @param client Client id
+ * @return Channel names
+ */
+std::vector<std::string> PubSub::channelsOf(uint64_t client) const {
+    auto it = subscribers.find(client);
+    return (it == subscribers.end()) ? std::vector<std::string>() : it->second.channels;
+}
+
+/**
+ * @brief Lists the patterns a client is subscribed to
+ * @param client Client id
+ * @return Glob patterns
+ */
+std::vector<std::string> PubSub::patternsOf(uint64_t client) const {
+    auto it = subscribers.find(client);
+    return (it == subscribers.end()) ? std::vector<std::string>() : it->second.patterns;
+}
+
+/**
+ * @brief Number of channels and patterns a client is subscribed to
+ * @param client Client id
+ * @return Subscription count
+ */
+size_t PubSub::subscriptionCount(uint64_t client) const {
+    auto it = subscribers.find(client);
+    if (it == subscribers.end()) {
+        return 0;
+    }
+    return it->second.channels.size() + it->second.patterns.size();
+}
+
+/**
+ * @brief Drops every subscription of a client
+ * @param client Client id
+ */
+void PubSub::removeClient(uint64_t client) {
+    auto it = subscribers.find(client);
+    if (it == subscribers.end()) {
+        return;
+    }
+    for (const auto& channel : std::vector<std::string>(it->second.channels)) {
+        remove(channels, it->second.channels, client, channel);
+    }
+    for (const auto& pattern : std::vector<std::string>(it->second.patterns)) {
+        remove(patterns, it->second.patterns, client, pattern);
+    }
+    subscribers.erase(it);
+}
+
+/**
+ * @brief Visits the receivers of a message published to a channel
+ * @param channel Channel the message is published to
+ * @param visit Called once for the direct subscribers (with a null
+ *              pattern) and once per matching pattern
+ */
+void PubSub::forEachReceiver(const std::string& channel,
+                             const std::function<void(const std::string* pattern, const std::vector<uint64_t>& clients)>& visit) const {
+    auto it = channels.find(channel);
+    if (it != channels.end()) {
+        visit(nullptr, it->second);
+    }
+    for (const auto& [pattern, clients] : patterns) {
+        if (fnmatch(pattern.c_str(), channel.c_str(), 0) == 0) {
+            visit(&pattern, clients);
+        }
+    }
+}
@@ -0,0 +1,141 @@
+/**
+ * @file pubsub.h
+ * @brief Header file for the PubSub channel registry
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#ifndef PUBSUB_H
+#define PUBSUB_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @class PubSub
+ * @brief Keeps track of channel and pattern subscriptions per client
+ *
+ * The registry only maps channels and glob patterns to client ids. Message
+ * encoding and delivery are left to the server, which encodes each message
+ * once and hands the same buffer to every receiver.
+ */
+class PubSub {
+private:
+    /**
+     * @brief Channels and patterns one client is subscribed to
+     */
+    struct ClientSubscriptions {
+        std::vector<std::string> channels;
+        std::vector<std::string> patterns;
+    };
+    
+    /**
+     * @brief Subscribed client ids per channel
+     */
+    std::unordered_map<std::string, std::vector<uint64_t>> channels;
+    
+    /**
+     * @brief Subscribed client ids per glob pattern
+     */
+    std::unordered_map<std::string, std::vector<uint64_t>> patterns;
+    
+    /**
+     * @brief Subscriptions per client id
+     */
+    std::unordered_map<uint64_t, ClientSubscriptions> subscribers;
+    
+    /**
+     * @brief Adds a client to a channel or pattern table
+     * @param table The channel or pattern table
+     * @param names The client's own list of channels or patterns
+     * @param client Client id
+     * @param name Channel or pattern to add
+     */
+    static void add(std::unordered_map<std::string, std::vector<uint64_t>>& table,
+                    std::vector<std::string>& names, uint64_t client, const std::string& name);
+    
+    /**
+     * @brief Removes a client from a channel or pattern table
+     * @param table The channel or pattern table
+     * @param names The client's own list of channels or patterns
+     * @param client Client id
+     * @param name Channel or pattern to remove
+     */
+    static void remove(std::unordered_map<std::string, std::vector<uint64_t>>& table,
+                       std::vector<std::string>& names, uint64_t client, const std::string& name);
+
+public:
+    /**
+     * @brief Subscribes a client to a channel
+     * @param client Client id
+     * @param channel Channel name
+     * @return Number of channels and patterns the client is subscribed to
+     */
+    size_t subscribe(uint64_t client, const std::string& channel);
+    
+    /**
+     * @brief Unsubscribes a client from a channel
+     * @param client Client id
+     * @param channel Channel name
+     * @return Number of channels and patterns the client is subscribed to
+     */
+    size_t unsubscribe(uint64_t client, const std::string& channel);
+    
+    /**
+     * @brief Subscribes a client to a glob pattern
+     * @param client Client id
+     * @param pattern Glob pattern matched against channel names
+     * @return Number of channels and patterns the client is subscribed to
+     */
+    size_t psubscribe(uint64_t client, const std::string& pattern);
+    
+    /**
+     * @brief Unsubscribes a client from a glob pattern
+     * @param client Client id
+     * @param pattern Glob pattern
+     * @return Number of channels and patterns the client is subscribed to
+     */
+    size_t punsubscribe(uint64_t client, const std::string& pattern);
+    
+    /**
+     * @brief Lists the channels a client is subscribed to
+     * @param client Client id
+     * @return Channel names
+     */
+    std::vector<std::string> channelsOf(uint64_t client) const;
+    
+    /**
+     * @brief Lists the patterns a client is subscribed to
+     * @param client Client id
+     * @return Glob patterns
+     */
+    std::vector<std::string> patternsOf(uint64_t client) const;
+    
+    /**
+     * @brief Number of channels and patterns a client is subscribed to
+     * @param client Client id
+     * @return Subscription count
+     */
+    size_t subscriptionCount(uint64_t client) const;
+    
+    /**
+     * @brief Drops every subscription of a client
+     * @param client Client id
+     */
+    void removeClient(uint64_t client);
+    
+    /**
+     * @brief Visits the receivers of a message published to a channel
+     * @param channel Channel the message is published to
+     * @param visit Called once for the direct subscribers (with a null
+     *              pattern) and once per matching pattern
+     */
+    void forEachReceiver(const std::string& channel,
+                         const std::function<void(const std::string* pattern, const std::vector<uint64_t>& clients)>& visit) const;
+};
+
+#endif // PUBSUB_H
@@ -0,0 +1,240 @@
+/**
+ * @file resp.cpp
+ * @brief Implementation of the RespCodec class
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#include "resp.h"
+#include <algorithm>
+
+/**
+ * @brief Parses a decimal number in a header line
+ * @param input Buffer containing the number
+ * @param begin Offset of the first character
+ * @param end Offset one past the last character
+ * @param value Output for the parsed value
+ * @param allow_negative Whether a leading '-' is accepted
+ * @return true if the field is a valid number
+ */
+bool RespCodec::parseNumber(std::string_view input, size_t begin, size_t end, long long& value, bool allow_negative) {
+    bool negative = false;
+    if (allow_negative && begin < end && input[begin] == '-') {
+        negative = true;
+        begin++;
+    }
+    if (begin >= end || end - begin > 18) return false;
+    
+    value = 0;
+    for (size_t i = begin; i < end; i++) {
+        if (input[i] < '0' || input[i] > '9') return false;
+        value = value * 10 + (input[i] - '0');
+    }
+    if (negative) value = -value;
+    return true;
+}
+
+/**
+ * @brief Encodes a simple string in RESP-2 format
+ * @param msg The string to encode
+ * @return The RESP-2 encoded simple string
+ */
+std::string RespCodec::encodeSimpleString(const std::string& msg) {
+    return "+" + msg + "\r\n";
+}
+
+/**
+ * @brief Encodes a bulk string in RESP-2 format
+ * @param msg The string to encode
+ * @return The RESP-2 encoded bulk string, or a null bulk string if msg is empty
+ */
+std::string RespCodec::encodeBulkString(const std::string& msg) {
+    if (msg.empty()) {
+        return "$-1\r\n";  // Null bulk string
+    }
+    return "$" + std::to_string(msg.length()) + "\r\n" + msg + "\r\n";
+}
+
+/**
+ * @brief Encodes an integer in RESP-2 format
+ * @param value The integer to encode
+ * @return The RESP-2 encoded integer
+ */
+std::string RespCodec::encodeInteger(long long value) {
+    return ":" + std::to_string(value) + "\r\n";
+}
+
+/**
+ * @brief Encodes an error message in RESP-2 format
+ * @param msg The error message to encode
+ * @return The RESP-2 encoded error message
+ */
+std::string RespCodec::encodeError(const std::string& msg) {
+    return "-ERR " + msg + "\r\n";
+}
+
+/**
+ * @brief Encodes an array of bulk strings in RESP-2 format
+ * @param items The strings to encode
+ * @return The RESP-2 encoded array
+ */
+std::string RespCodec::encodeArray(const std::vector<std::string>& items) {
+    std::string response;
+    appendCommand(response, items);
+    return response;
+}
+
+/**
+ * @brief Appends a command, as an array of bulk strings, to a buffer
+ * @param out The buffer to append to
+ * @param args Command arguments
+ */
+void RespCodec::appendCommand(std::string& out, const std::vector<std::string>& args) {
+    out += "*" + std::to_string(args.size()) + "\r\n";
+    for (const auto& arg : args) {
+        out += "$" + std::to_string(arg.length()) + "\r\n";
+        out += arg;
+        out += "\r\n";
+    }
+}
+
+/**
+ * @brief Decodes one RESP-2 command from a buffer
+ * @param raw_input Buffer holding one or more (possibly partial) commands
+ * @param pos Offset to start decoding at, advanced past the command on success
+ * @param command Output vector of command arguments
+ * @return Whether a full command was decoded, more input is needed, or the input is malformed
+ * 
+ * Parses RESP-2 protocol formatted commands into a vector of strings.
+ */
+ParseResult RespCodec::decodeCommand(const std::string& raw_input, size_t& pos, std::vector<std::string>& command) {
+    size_t index = pos;
+
+    if (index >= raw_input.size()) return ParseResult::INCOMPLETE;
+    if (raw_input[index] != '*') return ParseResult::INVALID;
+
+    index++;
+
+    size_t next = raw_input.find("\r\n", index);
+
+    if (next == std::string::npos) return ParseResult::INCOMPLETE;
+
+    long long arg_count;
+    if (!parseNumber(raw_input, index, next, arg_count, false)) return ParseResult::INVALID;
+    if (arg_count > RESP_MAX_ELEMENTS) return ParseResult::INVALID;
+
+    index = next + 2;
+    command.clear();
+    // Every argument takes at least "$0\r\n\r\n", so never reserve more than the buffer can hold
+    command.reserve(std::min<size_t>(arg_count, (raw_input.size() - index) / 6));
+
+    for (long long i = 0; i < arg_count; i++) {
+        if (index >= raw_input.size()) return ParseResult::INCOMPLETE;
+        if (raw_input[index] != '$') return ParseResult::INVALID;
+
+        index++; 
+        next = raw_input.find("\r\n", index);
+        if (next == std::string::npos) return ParseResult::INCOMPLETE;
+        long long len;
+        if (!parseNumber(raw_input, index, next, len, false)) return ParseResult::INVALID;
+        if (len > RESP_MAX_BULK_LENGTH) return ParseResult::INVALID;
+        index = next + 2; 
+
+        if (index + len + 2 > raw_input.size()) return ParseResult::INCOMPLETE;
+        if (raw_input.compare(index + len, 2, "\r\n") != 0) return ParseResult::INVALID;
+        command.push_back(raw_input.substr(index, len));
+        index += len + 2;
+    }
+
+    if (command.empty()) return ParseResult::INVALID;
+
+    pos = index;
+    return ParseResult::COMPLETE;
+}
+
+/**
+ * @brief Decodes one RESP-2 reply from a buffer without copying
+ * @param input Buffer holding one or more (possibly partial) replies
+ * @param pos Offset to start decoding at, advanced past the reply on success
+ * @param value Output for the reply, with views into input
+ * @return Whether a full reply was decoded, more input is needed, or the input is malformed
+ */
+ParseResult RespCodec::decodeReply(std::string_view input, size_t& pos, RespValue& value) {
+    return decodeReply(input, pos, value, 0);
+}
+
+/**
+ * @brief Decodes one RESP-2 reply nested in arrays
+ * @param input Buffer holding one or more (possibly partial) replies
+ * @param pos Offset to start decoding at, advanced past the reply on success
+ * @param value Output for the reply, with views into input
+ * @param depth Number of arrays the reply is nested in
+ * @return Whether a full reply was decoded, more input is needed, or the input is malformed
+ */
+ParseResult RespCodec::decodeReply(std::string_view input, size_t& pos, RespValue& value, int depth) {
+    size_t index = pos;
+    if (index >= input.size()) return ParseResult::INCOMPLETE;
+
+    size_t next = input.find("\r\n", index + 1);
+    if (next == std::string_view::npos) return ParseResult::INCOMPLETE;
+
+    value = RespValue();
+    char type = input[index];
+    long long number = 0;
+
+    switch (type) {
+        case RespValue::SIMPLE:
+        case RespValue::ERROR:
+            value.type = static_cast<RespValue::Type>(type);
+            value.str = input.substr(index + 1, next - index - 1);
+            index = next + 2;
+            break;
+
+        case RespValue::INTEGER:
+            if (!parseNumber(input, index + 1, next, number, true)) return ParseResult::INVALID;
+            value.type = RespValue::INTEGER;
+            value.integer = number;
+            index = next + 2;
+            break;
+
+        case RespValue::BULK:
+            if (!parseNumber(input, index + 1, next, number, true)) return ParseResult::INVALID;
+            if (number > RESP_MAX_BULK_LENGTH) return ParseResult::INVALID;
+            value.type = RespValue::BULK;
+            index = next + 2;
+            if (number < 0) {
+                value.is_null = true;
+                break;
+            }
+            if (index + number + 2 > input.size()) return ParseResult::INCOMPLETE;
+            if (input.compare(index + number, 2, "\r\n") != 0) return ParseResult::INVALID;
+            value.str = input.substr(index, number);
+            index += number + 2;
+            break;
+
+        case RespValue::ARRAY:
+            if (!parseNumber(input, index + 1, next, number, true)) return ParseResult::INVALID;
+            value.type = RespValue::ARRAY;
+            index = next + 2;
+            if (number < 0) {
+                value.is_null = true;
+                break;
+            }
+            if (number > RESP_MAX_ELEMENTS) return ParseResult::INVALID;
+            if (number > 0 && depth >= RESP_MAX_DEPTH) return ParseResult::INVALID;
+            // Every element takes at least three bytes, so an incomplete array can't reserve more than that
+            value.elements.reserve(std::min<size_t>(number, (input.size() - index) / 3));
+            for (long long i = 0; i < number; i++) {
+                value.elements.emplace_back();
+                ParseResult result = decodeReply(input, index, value.elements.back(), depth + 1);
+                if (result != ParseResult::COMPLETE) return result;
+            }
+            break;
+
+        default:
+            return ParseResult::INVALID;
+    }
+
+    pos = index;
+    return ParseResult::COMPLETE;
+}
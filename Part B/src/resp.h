@@ -0,0 +1,181 @@
+/**
+ * @file resp.h
+ * @brief Header file for the RESP-2 encoder and decoder shared by server and client
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#ifndef RESP_H
+#define RESP_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+/**
+ * @brief Most elements accepted in one command or array reply
+ */
+#define RESP_MAX_ELEMENTS (1024 * 1024)
+
+/**
+ * @brief Deepest nesting of arrays accepted in one reply
+ */
+#define RESP_MAX_DEPTH 128
+
+/**
+ * @brief Longest bulk string accepted, in bytes
+ */
+#define RESP_MAX_BULK_LENGTH (512LL * 1024 * 1024)
+
+/**
+ * @enum ParseResult
+ * @brief Outcome of decoding one command or reply from a buffer
+ */
+enum class ParseResult {
+    COMPLETE,
+    INCOMPLETE,
+    INVALID
+};
+
+/**
+ * @struct RespValue
+ * @brief A decoded RESP-2 reply
+ *
+ * Strings are views into the buffer the reply was decoded from, so a
+ * RespValue is only valid while that buffer is unchanged.
+ */
+struct RespValue {
+    /**
+     * @brief RESP-2 type, identified by its leading byte
+     */
+    enum Type : char {
+        SIMPLE = '+',
+        ERROR = '-',
+        INTEGER = ':',
+        BULK = '$',
+        ARRAY = '*'
+    };
+    
+    /**
+     * @brief Type of the reply
+     */
+    Type type = SIMPLE;
+    
+    /**
+     * @brief Whether the reply is a null bulk string or null array
+     */
+    bool is_null = false;
+    
+    /**
+     * @brief Contents of a simple string, error or bulk string
+     */
+    std::string_view str;
+    
+    /**
+     * @brief Value of an integer reply
+     */
+    long long integer = 0;
+    
+    /**
+     * @brief Elements of an array reply
+     */
+    std::vector<RespValue> elements;
+};
+
+/**
+ * @class RespCodec
+ * @brief Encodes and decodes the RESP-2 protocol
+ */
+class RespCodec {
+private:
+    /**
+     * @brief Parses a decimal number in a header line
+     * @param input Buffer containing the number
+     * @param begin Offset of the first character
+     * @param end Offset one past the last character
+     * @param value Output for the parsed value
+     * @param allow_negative Whether a leading '-' is accepted
+     * @return true if the field is a valid number
+     */
+    static bool parseNumber(std::string_view input, size_t begin, size_t end, long long& value, bool allow_negative);
+    
+    /**
+     * @brief Decodes one RESP-2 reply nested in arrays
+     * @param input Buffer holding one or more (possibly partial) replies
+     * @param pos Offset to start decoding at, advanced past the reply on success
+     * @param value Output for the reply, with views into input
+     * @param depth Number of arrays the reply is nested in
+     * @return Whether a full reply was decoded, more input is needed, or the input is malformed
+     */
+    static ParseResult decodeReply(std::string_view input, size_t& pos, RespValue& value, int depth);
+
+public:
+    /**
+     * @brief Encodes a simple string in RESP-2 format
+     * @param msg The string to encode
+     * @return The RESP-2 encoded simple string
+     */
+    static std::string encodeSimpleString(const std::string& msg);
+    
+    /**
+     * @brief Encodes a bulk string in RESP-2 format
+     * @param msg The string to encode
+     * @return The RESP-2 encoded bulk string, or a null bulk string if msg is empty
+     */
+    static std::string encodeBulkString(const std::string& msg);
+    
+    /**
+     * @brief Encodes an integer in RESP-2 format
+     * @param value The integer to encode
+     * @return The RESP-2 encoded integer
+     */
+    static std::string encodeInteger(long long value);
+    
+    /**
+     * @brief Encodes an error message in RESP-2 format
+     * @param msg The error message to encode
+     * @return The RESP-2 encoded error message
+     */
+    static std::string encodeError(const std::string& msg);
+    
+    /**
+     * @brief Encodes an array of bulk strings in RESP-2 format
+     * @param items The strings to encode
+     * @return The RESP-2 encoded array
+     */
+    static std::string encodeArray(const std::vector<std::string>& items);
+    
+    /**
+     * @brief Appends a command, as an array of bulk strings, to a buffer
+     * @param out The buffer to append to
+     * @param args Command arguments
+     */
+    static void appendCommand(std::string& out, const std::vector<std::string>& args);
+    
+    /**
+     * @brief Decodes one RESP-2 command from a buffer
+     * @param raw_input Buffer holding one or more (possibly partial) commands
+     * @param pos Offset to start decoding at, advanced past the command on success
+     * @param command Output vector of command arguments
+     * @return Whether a full command was decoded, more input is needed, or the input is malformed
+     *
+     * Counts above RESP_MAX_ELEMENTS and lengths above RESP_MAX_BULK_LENGTH
+     * are malformed, so a peer can't make the decoder allocate without bound.
+     */
+    static ParseResult decodeCommand(const std::string& raw_input, size_t& pos, std::vector<std::string>& command);
+    
+    /**
+     * @brief Decodes one RESP-2 reply from a buffer without copying
+     * @param input Buffer holding one or more (possibly partial) replies
+     * @param pos Offset to start decoding at, advanced past the reply on success
+     * @param value Output for the reply, with views into input
+     * @return Whether a full reply was decoded, more input is needed, or the input is malformed
+     *
+     * Applies the same limits as decodeCommand, and arrays nested deeper
+     * than RESP_MAX_DEPTH are malformed, so a peer can't exhaust the stack.
+     */
+    static ParseResult decodeReply(std::string_view input, size_t& pos, RespValue& value);
+};
+
+#endif // RESP_H
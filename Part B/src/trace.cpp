@@ -0,0 +1,181 @@
+/**
+ * @file trace.cpp
+ * @brief Implementation of sampled request tracing with Chrome trace export
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#include "trace.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+std::atomic<uint32_t> Tracer::sample_every{0};
+std::atomic<uint64_t> Tracer::request_counter{0};
+std::mutex Tracer::rings_mutex;
+std::vector<std::shared_ptr<TraceRing>> Tracer::rings;
+thread_local uint64_t Tracer::current_request = 0;
+thread_local std::shared_ptr<TraceRing> Tracer::thread_ring;
+thread_local std::string Tracer::thread_name;
+
+/**
+ * @brief Ring of the calling thread
+ * @return The ring, registered on first use
+ */
+TraceRing& Tracer::threadRing() {
+    if (!thread_ring) {
+        thread_ring = std::make_shared<TraceRing>();
+        thread_ring->events.resize(TRACE_RING_EVENTS);
+        thread_ring->tid = static_cast<uint64_t>(syscall(SYS_gettid));
+        thread_ring->thread_name = thread_name;
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        rings.push_back(thread_ring);
+    }
+    return *thread_ring;
+}
+
+/**
+ * @brief Sets how many requests share one sample
+ * @param every Trace one request in this many, 0 to stop tracing
+ */
+void Tracer::setSampleRate(uint32_t every) {
+    sample_every.store(every);
+}
+
+/**
+ * @brief Current sample rate
+ * @return One in this many requests is traced, 0 when tracing is off
+ */
+uint32_t Tracer::sampleRate() {
+    return sample_every.load();
+}
+
+/**
+ * @brief Starts a request on the calling thread, sampling it or not
+ */
+void Tracer::beginRequest() {
+    uint32_t every = sample_every.load(std::memory_order_relaxed);
+    if (every == 0) {
+        return;
+    }
+    uint64_t request = request_counter.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (request % every == 0) {
+        current_request = request;
+    }
+}
+
+/**
+ * @brief Ends the calling thread's request
+ */
+void Tracer::endRequest() {
+    current_request = 0;
+}
+
+/**
+ * @brief Reads the trace clock
+ * @return Nanoseconds of the steady clock
+ */
+uint64_t Tracer::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Records a completed span in the calling thread's ring
+ * @param name Span name, a string literal
+ * @param start_ns Start time from now()
+ * @param end_ns End time from now()
+ */
+void Tracer::record(const char* name, uint64_t start_ns, uint64_t end_ns) {
+    TraceRing& ring = threadRing();
+    std::lock_guard<std::mutex> lock(ring.mutex);
+    ring.events[ring.written % TRACE_RING_EVENTS] = {name, start_ns, end_ns - start_ns, current_request};
+    ring.written++;
+}
+
+/**
+ * @brief Names the calling thread in dumps
+ * @param name Thread name, e.g. "reactor"
+ */
+void Tracer::setThreadName(const std::string& name) {
+    thread_name = name;
+    if (thread_ring) {
+        std::lock_guard<std::mutex> lock(thread_ring->mutex);
+        thread_ring->thread_name = name;
+    }
+}
+
+/**
+ * @brief Renders every ring in the Chrome trace event format
+ * @return JSON accepted by chrome://tracing and ui.perfetto.dev
+ *
+ * Spans become complete ("X") events with microsecond timestamps; nesting
+ * is implied by time, so a DB span shows inside the command that ran it.
+ */
+std::string Tracer::dumpJson() {
+    std::string json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    long pid = static_cast<long>(getpid());
+    char line[256];
+
+    std::lock_guard<std::mutex> rings_lock(rings_mutex);
+    for (const auto& ring : rings) {
+        std::lock_guard<std::mutex> lock(ring->mutex);
+        if (!ring->thread_name.empty()) {
+            std::snprintf(line, sizeof(line),
+                          "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%llu,\"args\":{\"name\":\"%s\"}}",
+                          first ? "" : ",", pid, static_cast<unsigned long long>(ring->tid),
+                          ring->thread_name.c_str());
+            json += line;
+            first = false;
+        }
+
+        uint64_t begin = ring->written > TRACE_RING_EVENTS ? ring->written - TRACE_RING_EVENTS : 0;
+        for (uint64_t i = begin; i < ring->written; i++) {
+            const TraceEvent& event = ring->events[i % TRACE_RING_EVENTS];
+            std::snprintf(line, sizeof(line),
+                          "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%ld,\"tid\":%llu,\"ts\":%.3f,\"dur\":%.3f,"
+                          "\"args\":{\"request\":%llu}}",
+                          first ? "" : ",", event.name, pid, static_cast<unsigned long long>(ring->tid),
+                          event.start_ns / 1000.0, event.duration_ns / 1000.0,
+                          static_cast<unsigned long long>(event.request));
+            json += line;
+            first = false;
+        }
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+/**
+ * @brief Writes dumpJson() to a file
+ * @param path File to write
+ * @return true on success
+ */
+bool Tracer::dumpToFile(const std::string& path) {
+    std::ofstream out(path);
+    out << dumpJson();
+    return static_cast<bool>(out);
+}
+
+/**
+ * @brief Discards all recorded spans
+ */
+void Tracer::clear() {
+    std::lock_guard<std::mutex> rings_lock(rings_mutex);
+    for (const auto& ring : rings) {
+        std::lock_guard<std::mutex> lock(ring->mutex);
+        ring->written = 0;
+    }
+}
+
+/**
+ * @brief Drops the rings a forked child inherited from its parent
+ */
+void Tracer::afterFork() {
+    std::lock_guard<std::mutex> rings_lock(rings_mutex);
+    rings.clear();
+    thread_ring.reset();
+}
@@ -0,0 +1,241 @@
+/**
+ * @file trace.h
+ * @brief Header file for sampled request tracing with Chrome trace export
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+#define TRACE_RING_EVENTS 65536
+#define TRACE_DEFAULT_SAMPLE_EVERY 100
+
+/**
+ * @struct TraceEvent
+ * @brief One completed span
+ */
+struct TraceEvent {
+    /**
+     * @brief Span name, a string literal
+     */
+    const char* name;
+
+    /**
+     * @brief Start time in nanoseconds of the steady clock
+     */
+    uint64_t start_ns;
+
+    /**
+     * @brief Duration in nanoseconds
+     */
+    uint64_t duration_ns;
+
+    /**
+     * @brief Sampled request the span belongs to, 0 for background work
+     */
+    uint64_t request;
+};
+
+/**
+ * @struct TraceRing
+ * @brief Fixed-size buffer of the most recent spans of one thread
+ *
+ * Only its thread writes to a ring, so the mutex is uncontended except
+ * while a dump copies the ring out.
+ */
+struct TraceRing {
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+    uint64_t written = 0;       // Spans ever recorded; the ring keeps the last TRACE_RING_EVENTS
+    uint64_t tid = 0;
+    std::string thread_name;
+};
+
+/**
+ * @class Tracer
+ * @brief Process-wide span recorder
+ *
+ * Tracing is off until a sample rate is set. Then one in every N requests
+ * is sampled: beginRequest() marks the calling thread, and every TraceSpan
+ * opened on that thread until endRequest() is recorded, including spans
+ * deep inside BlinkDB. Unsampled requests pay one thread-local check per
+ * span. Background spans, such as persistence flushes, are recorded
+ * whenever tracing is on.
+ *
+ * Spans go to a ring per thread, created on the thread's first span and
+ * kept after it exits, so a dump shows the recent past of every thread.
+ */
+class Tracer {
+private:
+    static std::atomic<uint32_t> sample_every;
+    static std::atomic<uint64_t> request_counter;
+    static std::mutex rings_mutex;
+    static std::vector<std::shared_ptr<TraceRing>> rings;
+
+    /**
+     * @brief Sampled request of the calling thread, 0 if none
+     */
+    static thread_local uint64_t current_request;
+
+    /**
+     * @brief Ring of the calling thread, null until its first span
+     */
+    static thread_local std::shared_ptr<TraceRing> thread_ring;
+
+    /**
+     * @brief Name given to the calling thread, applied to its ring
+     */
+    static thread_local std::string thread_name;
+
+    /**
+     * @brief Ring of the calling thread
+     * @return The ring, registered on first use
+     */
+    static TraceRing& threadRing();
+
+public:
+    /**
+     * @brief Sets how many requests share one sample
+     * @param every Trace one request in this many, 0 to stop tracing
+     */
+    static void setSampleRate(uint32_t every);
+
+    /**
+     * @brief Current sample rate
+     * @return One in this many requests is traced, 0 when tracing is off
+     */
+    static uint32_t sampleRate();
+
+    /**
+     * @brief Checks whether tracing is on
+     * @return true if a sample rate is set
+     */
+    static bool enabled() { return sample_every.load(std::memory_order_relaxed) != 0; }
+
+    /**
+     * @brief Checks whether the calling thread is inside a sampled request
+     * @return true if spans opened now are recorded
+     */
+    static bool active() { return current_request != 0; }
+
+    /**
+     * @brief Starts a request on the calling thread, sampling it or not
+     */
+    static void beginRequest();
+
+    /**
+     * @brief Ends the calling thread's request
+     */
+    static void endRequest();
+
+    /**
+     * @brief Reads the trace clock
+     * @return Nanoseconds of the steady clock
+     */
+    static uint64_t now();
+
+    /**
+     * @brief Records a completed span in the calling thread's ring
+     * @param name Span name, a string literal
+     * @param start_ns Start time from now()
+     * @param end_ns End time from now()
+     */
+    static void record(const char* name, uint64_t start_ns, uint64_t end_ns);
+
+    /**
+     * @brief Names the calling thread in dumps
+     * @param name Thread name, e.g. "reactor"
+     *
+     * Cheap enough for any thread; no ring is allocated until a span is recorded.
+     */
+    static void setThreadName(const std::string& name);
+
+    /**
+     * @brief Renders every ring in the Chrome trace event format
+     * @return JSON accepted by chrome://tracing and ui.perfetto.dev
+     */
+    static std::string dumpJson();
+
+    /**
+     * @brief Writes dumpJson() to a file
+     * @param path File to write
+     * @return true on success
+     */
+    static bool dumpToFile(const std::string& path);
+
+    /**
+     * @brief Discards all recorded spans
+     */
+    static void clear();
+
+    /**
+     * @brief Drops the rings a forked child inherited from its parent
+     *
+     * Call in the child right after fork(), while it has a single thread.
+     */
+    static void afterFork();
+};
+
+/**
+ * @class TraceRequest
+ * @brief Scope of one request, sampled or not
+ */
+class TraceRequest {
+public:
+    TraceRequest() { Tracer::beginRequest(); }
+    ~TraceRequest() { Tracer::endRequest(); }
+    TraceRequest(const TraceRequest&) = delete;
+    TraceRequest& operator=(const TraceRequest&) = delete;
+};
+
+/**
+ * @class TraceSpan
+ * @brief Times a scope and records it on destruction or end()
+ */
+class TraceSpan {
+private:
+    const char* name;
+    uint64_t start_ns = 0;
+    bool on;
+
+public:
+    /**
+     * @brief Opens a span
+     * @param span_name Span name, a string literal
+     * @param background Record whenever tracing is on, not only in sampled requests
+     */
+    explicit TraceSpan(const char* span_name, bool background = false)
+        : name(span_name), on(Tracer::active() || (background && Tracer::enabled())) {
+        if (on) {
+            start_ns = Tracer::now();
+        }
+    }
+
+    /**
+     * @brief Closes the span if end() was not called
+     */
+    ~TraceSpan() { end(); }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    /**
+     * @brief Closes the span early
+     */
+    void end() {
+        if (on) {
+            Tracer::record(name, start_ns, Tracer::now());
+            on = false;
+        }
+    }
+};
+
+#endif // TRACE_H
@@ -0,0 +1,259 @@
+/**
+ * @file tracking_table.cpp
+ * @brief Implementation of the TrackingTable class
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#include "tracking_table.h"
+#include <algorithm>
+#include <functional>
+
+/**
+ * @brief Hashes a key for the table
+ * @param key The key to hash
+ * @return 64-bit hash of the key
+ */
+uint64_t TrackingTable::hashKey(const std::string& key) {
+    // Never 0, which marks a free slot; remapping only that value keeps the
+    // low bits, which pick the home slot, evenly spread
+    uint64_t hash = std::hash<std::string>{}(key);
+    return hash ? hash : 1;
+}
+
+/**
+ * @brief Finds an entry
+ * @param hash Key hash
+ * @param client Client id
+ * @return Slot index, or slots.size() if absent
+ */
+size_t TrackingTable::find(uint64_t hash, uint64_t client) const {
+    size_t mask = slots.size() - 1;
+    for (size_t i = hash & mask; slots[i].hash != 0; i = (i + 1) & mask) {
+        if (slots[i].hash == hash && slots[i].client == client) {
+            return i;
+        }
+    }
+    return slots.size();
+}
+
+/**
+ * @brief Adds an entry to the slots, growing them if needed
+ * @param slot The entry
+ */
+void TrackingTable::insert(const Slot& slot) {
+    if ((used + 1) * 4 > slots.size() * 3) {
+        std::vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        used = 0;
+        for (const Slot& entry : old) {
+            if (entry.hash != 0) {
+                insert(entry);
+            }
+        }
+    }
+    
+    size_t mask = slots.size() - 1;
+    size_t i = slot.hash & mask;
+    while (slots[i].hash != 0) {
+        i = (i + 1) & mask;
+    }
+    slots[i] = slot;
+    used++;
+}
+
+/**
+ * @brief Frees a slot, shifting later entries of its probe run back
+ * @param index Slot index
+ */
+void TrackingTable::eraseAt(size_t index) {
+    size_t mask = slots.size() - 1;
+    size_t hole = index;
+    for (size_t i = (index + 1) & mask; slots[i].hash != 0; i = (i + 1) & mask) {
+        // An entry may fill the hole only if its home slot isn't between the hole and it
+        size_t home = slots[i].hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            slots[hole] = slots[i];
+            hole = i;
+        }
+    }
+    slots[hole] = Slot();
+    used--;
+}
+
+/**
+ * @brief Checks whether an order record still describes a stored entry
+ * @param record The record
+ * @return Slot index of the entry, or slots.size() if it was removed
+ */
+size_t TrackingTable::live(const Record& record) const {
+    size_t index = find(record.hash, record.client);
+    return (index < slots.size() && slots[index].seq == record.seq) ? index : slots.size();
+}
+
+/**
+ * @brief Turns tracking on for a client, replacing earlier options
+ * @param client Client id
+ * @param redirect Id of the client that receives the invalidations
+ * @param bcast Whether to use broadcast mode
+ * @param client_prefixes Key prefixes to broadcast, empty for all keys
+ */
+void TrackingTable::enable(uint64_t client, uint64_t redirect, bool bcast, const std::vector<std::string>& client_prefixes) {
+    disable(client);
+    
+    ClientTracking& tracking = clients[client];
+    tracking.redirect = redirect;
+    tracking.bcast = bcast;
+    if (bcast) {
+        tracking.prefixes = client_prefixes.empty() ? std::vector<std::string>{""} : client_prefixes;
+        for (const auto& prefix : tracking.prefixes) {
+            prefixes.emplace_back(prefix, client);
+        }
+    }
+}
+
+/**
+ * @brief Turns tracking off for a client and forgets its state
+ * @param client Client id
+ * 
+ * Key entries that still name the client are purged lazily, when the key
+ * is next invalidated.
+ */
+void TrackingTable::disable(uint64_t client) {
+    if (clients.erase(client) == 0) {
+        return;
+    }
+    prefixes.erase(std::remove_if(prefixes.begin(), prefixes.end(),
+                                  [client](const auto& entry) { return entry.second == client; }),
+                   prefixes.end());
+    pending.erase(client);
+}
+
+/**
+ * @brief Checks whether tracking is on for a client
+ * @param client Client id
+ * @return true if the client is tracking
+ */
+bool TrackingTable::isTracking(uint64_t client) const {
+    return clients.find(client) != clients.end();
+}
+
+/**
+ * @brief Client that receives a tracking client's invalidations
+ * @param client Client id
+ * @return Id of the redirect client, 0 if the client isn't tracking
+ */
+uint64_t TrackingTable::redirectOf(uint64_t client) const {
+    auto it = clients.find(client);
+    return (it == clients.end()) ? 0 : it->second.redirect;
+}
+
+/**
+ * @brief Records that a client has read a key
+ * @param client Client id
+ * @param key The key that was read
+ * 
+ * A full table first drops its oldest entry.
+ */
+void TrackingTable::recordRead(uint64_t client, const std::string& key) {
+    auto it = clients.find(client);
+    if (it == clients.end() || it->second.bcast) {
+        return;
+    }
+    
+    uint64_t hash = hashKey(key);
+    if (find(hash, client) < slots.size()) {
+        return;
+    }
+    
+    while (used >= TRACKING_TABLE_MAX_ENTRIES) {
+        Record oldest = order.front();
+        order.pop_front();
+        size_t index = live(oldest);
+        if (index < slots.size()) {
+            // The key isn't stored, so its client loses its whole cache
+            eraseAt(index);
+            if (isTracking(oldest.client)) {
+                pending[oldest.client].flush_all = true;
+            }
+        }
+    }
+    
+    // Drop records of invalidated entries so order stays near the table size
+    while (!order.empty() && live(order.front()) == slots.size()) {
+        order.pop_front();
+    }
+    if (order.size() > 2 * used + TRACKING_TABLE_INITIAL_SLOTS) {
+        order.erase(std::remove_if(order.begin(), order.end(),
+                                   [this](const Record& record) { return live(record) == slots.size(); }),
+                    order.end());
+    }
+    
+    Slot slot;
+    slot.hash = hash;
+    slot.client = client;
+    slot.seq = next_seq++;
+    insert(slot);
+    order.push_back({hash, client, slot.seq});
+}
+
+/**
+ * @brief Queues invalidations for every client interested in a key
+ * @param key The key that changed
+ */
+void TrackingTable::invalidate(const std::string& key) {
+    uint64_t hash = hashKey(key);
+    size_t mask = slots.size() - 1;
+    std::vector<uint64_t> readers;
+    for (size_t i = hash & mask; slots[i].hash != 0; i = (i + 1) & mask) {
+        if (slots[i].hash == hash) {
+            readers.push_back(slots[i].client);
+        }
+    }
+    for (uint64_t client : readers) {
+        eraseAt(find(hash, client));
+        if (isTracking(client)) {
+            pending[client].keys.push_back(key);
+        }
+    }
+    
+    for (const auto& [prefix, client] : prefixes) {
+        if (key.compare(0, prefix.size(), prefix) == 0) {
+            pending[client].keys.push_back(key);
+        }
+    }
+}
+
+/**
+ * @brief Checks whether there are invalidations waiting to be sent
+ * @return true if takePending() would return entries
+ */
+bool TrackingTable::hasPending() const {
+    return !pending.empty();
+}
+
+/**
+ * @brief Returns and clears the queued invalidations
+ * @return Map of client id to the invalidations for that client
+ */
+std::unordered_map<uint64_t, PendingInvalidation> TrackingTable::takePending() {
+    std::unordered_map<uint64_t, PendingInvalidation> result;
+    result.swap(pending);
+    return result;
+}
+
+/**
+ * @brief Number of (key, client) entries currently tracked
+ * @return Table size
+ */
+size_t TrackingTable::size() const {
+    return used;
+}
+
+/**
+ * @brief Memory held by the entries and their insertion order
+ * @return Bytes
+ */
+size_t TrackingTable::memoryBytes() const {
+    return slots.capacity() * sizeof(Slot) + order.size() * sizeof(Record);
+}
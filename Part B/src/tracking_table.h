@@ -0,0 +1,232 @@
+/**
+ * @file tracking_table.h
+ * @brief Header file for the TrackingTable used by client-side caching
+ * @author Madhumita
+ * @date 2025-03-31
+ */
+
+#ifndef TRACKING_TABLE_H
+#define TRACKING_TABLE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Maximum number of (key, client) entries remembered by the tracking table
+ */
+#define TRACKING_TABLE_MAX_ENTRIES 1000000
+
+/**
+ * @brief Initial slot count of the tracking table, a power of two
+ */
+#define TRACKING_TABLE_INITIAL_SLOTS 1024
+
+/**
+ * @brief Pub/sub channel on which invalidation messages are delivered
+ */
+#define INVALIDATE_CHANNEL "__redis__:invalidate"
+
+/**
+ * @struct PendingInvalidation
+ * @brief Invalidation messages queued for one client
+ */
+struct PendingInvalidation {
+    /**
+     * @brief Keys the client must drop from its cache
+     */
+    std::vector<std::string> keys;
+    
+    /**
+     * @brief Whether the client must drop its whole cache
+     */
+    bool flush_all = false;
+};
+
+/**
+ * @class TrackingTable
+ * @brief Remembers which clients cache which keys and collects invalidations
+ *
+ * In default mode a client is remembered for every key it reads and is told
+ * once when that key changes; it has to read the key again to be tracked
+ * again. In broadcast mode a client is told about every change to keys that
+ * match one of its prefixes, whether it read them or not.
+ *
+ * To stay compact the table stores 64-bit key hashes and client ids only,
+ * one flat open-addressing slot per (key, client) pair, so remembering a
+ * read allocates nothing once the table has grown. A hash collision just
+ * causes a spurious invalidation. Entries are also queued in the order
+ * they were added; when TRACKING_TABLE_MAX_ENTRIES is reached, the oldest
+ * entry is dropped and its client is told to flush its whole cache, since
+ * the key itself is not stored.
+ */
+class TrackingTable {
+private:
+    /**
+     * @brief One (key, client) entry; hash 0 marks a free slot
+     */
+    struct Slot {
+        uint64_t hash = 0;
+        uint64_t client = 0;
+        uint64_t seq = 0;     // Matches the entry's record in order
+    };
+    
+    /**
+     * @brief An entry as queued in insertion order
+     */
+    struct Record {
+        uint64_t hash;
+        uint64_t client;
+        uint64_t seq;
+    };
+    
+    /**
+     * @brief Open-addressing table of entries, linear probing, size a power of two
+     */
+    std::vector<Slot> slots = std::vector<Slot>(TRACKING_TABLE_INITIAL_SLOTS);
+    
+    /**
+     * @brief Number of slots in use
+     */
+    size_t used = 0;
+    
+    /**
+     * @brief Entries oldest first; records of entries already removed are skipped
+     */
+    std::deque<Record> order;
+    
+    /**
+     * @brief Sequence number of the next entry
+     */
+    uint64_t next_seq = 1;
+
+    /**
+     * @brief Tracking options of one client
+     */
+    struct ClientTracking {
+        uint64_t redirect = 0;
+        bool bcast = false;
+        std::vector<std::string> prefixes;
+    };
+    
+    /**
+     * @brief Tracking options per client id
+     */
+    std::unordered_map<uint64_t, ClientTracking> clients;
+    
+    /**
+     * @brief Broadcast prefixes and the client registered for each
+     */
+    std::vector<std::pair<std::string, uint64_t>> prefixes;
+    
+    /**
+     * @brief Invalidations collected since the last call to takePending()
+     */
+    std::unordered_map<uint64_t, PendingInvalidation> pending;
+    
+    /**
+     * @brief Hashes a key for the table
+     * @param key The key to hash
+     * @return 64-bit hash of the key, never 0
+     */
+    static uint64_t hashKey(const std::string& key);
+    
+    /**
+     * @brief Finds an entry
+     * @param hash Key hash
+     * @param client Client id
+     * @return Slot index, or slots.size() if absent
+     */
+    size_t find(uint64_t hash, uint64_t client) const;
+    
+    /**
+     * @brief Adds an entry to the slots, growing them if needed
+     * @param slot The entry
+     */
+    void insert(const Slot& slot);
+    
+    /**
+     * @brief Frees a slot, shifting later entries of its probe run back
+     * @param index Slot index
+     */
+    void eraseAt(size_t index);
+    
+    /**
+     * @brief Checks whether an order record still describes a stored entry
+     * @param record The record
+     * @return Slot index of the entry, or slots.size() if it was removed
+     */
+    size_t live(const Record& record) const;
+
+public:
+    /**
+     * @brief Turns tracking on for a client, replacing earlier options
+     * @param client Client id
+     * @param redirect Id of the client that receives the invalidations
+     * @param bcast Whether to use broadcast mode
+     * @param client_prefixes Key prefixes to broadcast, empty for all keys
+     */
+    void enable(uint64_t client, uint64_t redirect, bool bcast, const std::vector<std::string>& client_prefixes);
+    
+    /**
+     * @brief Turns tracking off for a client and forgets its state
+     * @param client Client id
+     */
+    void disable(uint64_t client);
+    
+    /**
+     * @brief Checks whether tracking is on for a client
+     * @param client Client id
+     * @return true if the client is tracking
+     */
+    bool isTracking(uint64_t client) const;
+    
+    /**
+     * @brief Client that receives a tracking client's invalidations
+     * @param client Client id
+     * @return Id of the redirect client, 0 if the client isn't tracking
+     */
+    uint64_t redirectOf(uint64_t client) const;
+    
+    /**
+     * @brief Records that a client has read a key
+     * @param client Client id
+     * @param key The key that was read
+     */
+    void recordRead(uint64_t client, const std::string& key);
+    
+    /**
+     * @brief Queues invalidations for every client interested in a key
+     * @param key The key that changed
+     */
+    void invalidate(const std::string& key);
+    
+    /**
+     * @brief Checks whether there are invalidations waiting to be sent
+     * @return true if takePending() would return entries
+     */
+    bool hasPending() const;
+    
+    /**
+     * @brief Returns and clears the queued invalidations
+     * @return Map of client id to the invalidations for that client
+     */
+    std::unordered_map<uint64_t, PendingInvalidation> takePending();
+    
+    /**
+     * @brief Number of (key, client) entries currently tracked
+     * @return Table size
+     */
+    size_t size() const;
+    
+    /**
+     * @brief Memory held by the entries and their insertion order
+     * @return Bytes
+     */
+    size_t memoryBytes() const;
+};
+
+#endif // TRACKING_TABLE_H